@@ -30,14 +30,31 @@
 /* Pointer to the global data structure for SPL */
 DECLARE_GLOBAL_DATA_PTR;
 
-/* The sunxi internal brom will try to loader external bootloader
- * from mmc0, nand flash, mmc2.
- * Unfortunately we can't check how SPL was loaded so assume
- * it's always the first SD/MMC controller
+/*
+ * The sunxi internal brom will try to load the external bootloader
+ * from mmc0, nand flash, mmc2, and tells us which one it used. Without
+ * a boot header (FEL), assume the medium the SPL was built for.
  */
 u32 spl_boot_device(void)
 {
+	switch (sunxi_get_boot_source()) {
+#ifdef CONFIG_SPL_MMC_SUPPORT
+	case SUNXI_BOOTED_FROM_MMC0:
+		return BOOT_DEVICE_MMC1;
+	case SUNXI_BOOTED_FROM_MMC2:
+		return BOOT_DEVICE_MMC2;
+#endif
+#ifdef CONFIG_SPL_NAND_SUPPORT
+	case SUNXI_BOOTED_FROM_NAND:
+		return BOOT_DEVICE_NAND;
+#endif
+	}
+
+#ifdef CONFIG_SPL_NAND_SUPPORT
+	return BOOT_DEVICE_NAND;
+#else
 	return BOOT_DEVICE_MMC1;
+#endif
 }
 
 /* No confirmation data available in SPL yet. Hardcode bootmode */
@@ -47,6 +64,14 @@ u32 spl_boot_mode(void)
 }
 #endif
 
+int sunxi_get_boot_source(void)
+{
+	if (memcmp((void *)(SUNXI_SRAM_A1_BASE + 4), "eGON.BT0", 8))
+		return SUNXI_BOOTED_FROM_FEL;
+
+	return readb(SUNXI_SRAM_A1_BASE + SUNXI_BOOT_MEDIA_OFFSET);
+}
+
 int gpio_init(void)
 {
 #if CONFIG_CONS_INDEX == 1 && defined(CONFIG_UART0_PORT_F)
@@ -0,0 +1,68 @@
+/*
+ * Dedicated DMA channel helpers for the Allwinner sun4i, sun5i and
+ * sun7i SoCs. Only polled transfers between SDRAM and a peripheral FIFO
+ * are supported, which is all the drivers need.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <asm/io.h>
+#include <asm/errno.h>
+#include <asm/arch/clock.h>
+#include <asm/arch/cpu.h>
+#include <asm/arch/dma.h>
+
+void sunxi_dma_init(void)
+{
+	struct sunxi_ccm_reg *const ccm =
+		(struct sunxi_ccm_reg *)SUNXI_CCM_BASE;
+	struct sunxi_dma_reg *const dma =
+		(struct sunxi_dma_reg *)SUNXI_DMA_BASE;
+
+	setbits_le32(&ccm->ahb_gate0, 1 << AHB_GATE_OFFSET_DMA);
+
+	/* we poll for completion */
+	writel(0, &dma->irq_en);
+}
+
+void sunxi_ddma_start(int ch, u32 cfg, u32 para, u32 src, u32 dst, u32 len)
+{
+	struct sunxi_dma_reg *const dma =
+		(struct sunxi_dma_reg *)SUNXI_DMA_BASE;
+	struct sunxi_ddma_reg *ddma = &dma->ddma[ch];
+
+	writel(src, &ddma->src_addr);
+	writel(dst, &ddma->dst_addr);
+	writel(len, &ddma->bcnt);
+	writel(para, &ddma->para);
+	writel(cfg | SUNXI_DMA_CFG_LOADING, &ddma->cfg);
+}
+
+int sunxi_ddma_wait(int ch, unsigned long timeout_ms)
+{
+	struct sunxi_dma_reg *const dma =
+		(struct sunxi_dma_reg *)SUNXI_DMA_BASE;
+	struct sunxi_ddma_reg *ddma = &dma->ddma[ch];
+	unsigned long start = get_timer(0);
+
+	while (readl(&ddma->cfg) & (SUNXI_DMA_CFG_LOADING |
+				    SUNXI_DMA_CFG_BUSY)) {
+		if (get_timer(start) > timeout_ms) {
+			debug("ddma%d: timeout, %u bytes left\n", ch,
+			      readl(&ddma->bcnt));
+			sunxi_ddma_stop(ch);
+			return -ETIMEDOUT;
+		}
+	}
+
+	return 0;
+}
+
+void sunxi_ddma_stop(int ch)
+{
+	struct sunxi_dma_reg *const dma =
+		(struct sunxi_dma_reg *)SUNXI_DMA_BASE;
+
+	writel(0, &dma->ddma[ch].cfg);
+}
@@ -24,6 +24,7 @@
 #include <common.h>
 #include <asm/io.h>
 #include <asm/arch/clock.h>
+#include <asm/arch/cpu.h>
 #include <asm/arch/dram.h>
 #include <asm/arch/timer.h>
 #include <asm/arch/sys_proto.h>
@@ -436,6 +437,74 @@ fail:
 	return dramc_scan_readpipe();
 }
 
+/* A FEL loaded SPL has no boot header to keep the result in */
+#if defined(CONFIG_SUNXI_DRAM_TRAIN_CACHE) && !defined(CONFIG_SPL_FEL)
+static struct dram_train_cache *const train_cache =
+	(struct dram_train_cache *)(SUNXI_SRAM_A1_BASE +
+				    DRAM_TRAIN_CACHE_OFFSET);
+
+/*
+ * Hash the DRAM parameters (except tpr3, which carries the result) and the
+ * SoC serial number, so a card moved to another board scans again.
+ */
+static u32 dramc_train_key(struct dram_para *para)
+{
+	const u32 *word = (const u32 *)para;
+	u32 key = 0x811c9dc5;
+	int i;
+
+	for (i = 0; i < sizeof(*para) / sizeof(u32); i++) {
+		if (&word[i] != &para->tpr3)
+			key = (key ^ word[i]) * 0x01000193;
+	}
+	for (i = 0; i < 4; i++)
+		key = (key ^ readl(SUNXI_SID_BASE + 4 * i)) * 0x01000193;
+
+	return key;
+}
+
+static int dramc_train_cache_get(struct dram_para *para, u32 *tpr3)
+{
+	u32 key;
+
+	if (!(para->tpr3 & (0x1 << 31)) ||
+	    sunxi_get_boot_source() == SUNXI_BOOTED_FROM_FEL)
+		return 0;
+
+	key = dramc_train_key(para);
+	if (train_cache->key != key ||
+	    train_cache->check != (key ^ train_cache->tpr3 ^
+				   DRAM_TRAIN_CACHE_MAGIC))
+		return 0;
+
+	*tpr3 = train_cache->tpr3;
+	return 1;
+}
+
+/* Written back to the card by U-Boot with CONFIG_SUNXI_DRAM_TRAIN_SAVE */
+static void dramc_train_cache_put(struct dram_para *para, u32 tpr3)
+{
+	u32 key;
+
+	if (sunxi_get_boot_source() == SUNXI_BOOTED_FROM_FEL)
+		return;
+
+	key = dramc_train_key(para);
+	train_cache->key = key;
+	train_cache->tpr3 = tpr3;
+	train_cache->check = key ^ tpr3 ^ DRAM_TRAIN_CACHE_MAGIC;
+}
+#else
+static inline int dramc_train_cache_get(struct dram_para *para, u32 *tpr3)
+{
+	return 0;
+}
+
+static inline void dramc_train_cache_put(struct dram_para *para, u32 tpr3)
+{
+}
+#endif
+
 static void dramc_clock_output_en(u32 on)
 {
 #if defined(CONFIG_SUN5I) || defined(CONFIG_SUN7I)
@@ -479,12 +548,19 @@ unsigned long dramc_init(struct dram_para *para)
 	struct sunxi_dram_reg *dram = (struct sunxi_dram_reg *)SUNXI_DRAMC_BASE;
 	u32 reg_val;
 	u32 density;
+	u32 tpr3;
+	int cached;
 	int ret_val;
 
 	/* check input dram parameter structure */
 	if (!para)
 		return 0;
 
+	/* reuse the DLL phases of an earlier scan on this board */
+	cached = dramc_train_cache_get(para, &tpr3);
+	if (!cached)
+		tpr3 = para->tpr3;
+
 	/* setup DRAM relative clock */
 	mctl_setup_dram_clock(para->clock);
 
@@ -508,7 +584,7 @@ unsigned long dramc_init(struct dram_para *para)
 #endif
 
 	mctl_itm_disable();
-	mctl_enable_dll0(para->tpr3);
+	mctl_enable_dll0(tpr3);
 
 	/* configure external DRAM */
 	reg_val = 0x0;
@@ -572,7 +648,7 @@ unsigned long dramc_init(struct dram_para *para)
 
 	await_completion(&dram->ccr, DRAM_CCR_INIT);
 
-	mctl_enable_dllx(para->tpr3);
+	mctl_enable_dllx(tpr3);
 
 #ifdef CONFIG_SUN4I
 	/* set odt impedance divide ratio */
@@ -669,9 +745,13 @@ unsigned long dramc_init(struct dram_para *para)
 
 	/* scan read pipe value */
 	mctl_itm_enable();
-	if (para->tpr3 & (0x1 << 31)) {
+	if (cached && dramc_scan_readpipe() == 0) {
+		/* the cached phases still pass, no need to scan again */
+		para->tpr3 = tpr3;
+		ret_val = 0;
+	} else if (para->tpr3 & (0x1 << 31)) {
 		ret_val = dramc_scan_dll_para();
-		if (ret_val == 0)
+		if (ret_val == 0) {
 			para->tpr3 =
 				(((readl(&dram->dllcr[0]) >> 6) & 0x3f) << 16) |
 				(((readl(&dram->dllcr[1]) >> 14) & 0xf) << 0) |
@@ -679,6 +759,8 @@ unsigned long dramc_init(struct dram_para *para)
 				(((readl(&dram->dllcr[3]) >> 14) & 0xf) << 8) |
 				(((readl(&dram->dllcr[4]) >> 14) & 0xf) << 12
 				);
+			dramc_train_cache_put(para, para->tpr3);
+		}
 	} else {
 		ret_val = dramc_scan_readpipe();
 	}
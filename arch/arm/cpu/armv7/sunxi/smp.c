@@ -6,9 +6,16 @@
  */
 
 #include <common.h>
+#include <malloc.h>
 #include <asm/io.h>
+#include <asm/armv7.h>
+#include <asm/errno.h>
+#include <asm/system.h>
 #include <asm/arch/smp.h>
 #include <asm/arch/cpucfg.h>
+#include <u-boot/crc.h>
+
+DECLARE_GLOBAL_DATA_PTR;
 
 /* Right now we assume only a single secondary as in sun7i */
 #if defined(CONFIG_SUN7I)
@@ -17,30 +24,320 @@
 #error unsupported SoC
 #endif
 
+/* States of the job CPU1 took last, only written by CPU1 */
+#define SECONDARY_JOB_CLAIMED	1	/* seen it, checking it was not withdrawn */
+#define SECONDARY_JOB_REFUSED	2	/* CPU0 withdrew it first */
+#define SECONDARY_JOB_RUNNING	3
+#define SECONDARY_JOB_DONE	4
+
+/* How long CPU1 gets to take a job before CPU0 runs it itself */
+#define SECONDARY_JOB_ACCEPT_MS	100
+
+/*
+ * Mailbox shared with CPU1, which only touches it with its caches off.
+ * CPU0 only writes the job and CPU1 only writes the reply. Each fills
+ * whole cache lines, so CPU0 can flush its half and invalidate the other
+ * without losing what CPU1 wrote. Kept in .data like the stack below, as
+ * the pre-relocation copy is what CPU1 polls until the first job moves
+ * it over.
+ *
+ * Jobs are numbered. CPU0 posts one by bumping job.seq; CPU1 claims it by
+ * writing reply.seq, and then looks at job.cancel. If CPU1 is too slow,
+ * CPU0 withdraws the job by writing its number to job.cancel, and then
+ * looks at reply.seq. Memory is not shareable, so there is no exclusive
+ * load/store between the CPUs to decide this; but as each side writes
+ * before it reads, with a barrier between, at least one of them sees the
+ * other's write. So either CPU0 sees no claim and CPU1 will refuse the
+ * job, or CPU0 sees the claim and waits for CPU1 to say whether it runs.
+ *
+ * Each side writes, then does dsb and sev. The other side reads the
+ * mailbox before every wfe, so no wake up is lost, however the events of
+ * several writes get merged.
+ */
+struct secondary_job {
+	int (*fn)(void *arg);
+	void *arg;
+	gd_t *gd;
+	u32 ttb;		/* page table to run with, 0 for caches off */
+	u32 seq;		/* number of the job posted last */
+	u32 cancel;		/* number of a job CPU0 withdrew */
+} __aligned(ARCH_DMA_MINALIGN);
+
+struct secondary_reply {
+	u32 state;
+	u32 seq;		/* number of the job the state is for */
+	int ret;
+} __aligned(ARCH_DMA_MINALIGN);
+
+static struct secondary_job job __attribute__((section(".data")));
+static struct secondary_reply reply __attribute__((section(".data")));
+static int secondary_moved;
+
+/* Enough for the pen; jobs run on a stack from malloc */
+static u32 secondary_stack[32] __aligned(8) __attribute__((section(".data")));
+void *secondary_sp = &secondary_stack[ARRAY_SIZE(secondary_stack)];
+
+static void secondary_caches_on(u32 ttb)
+{
+	u32 reg;
+
+	/*
+	 * The Cortex-A7 wants the SMP bit set before its caches are
+	 * turned on. It does not make them coherent with CPU0's: U-Boot
+	 * maps memory non-shareable, hence the flushing around each job.
+	 */
+	asm volatile("mrc p15, 0, %0, c1, c0, 1" : "=r" (reg));
+	asm volatile("mcr p15, 0, %0, c1, c0, 1" : : "r" (reg | (1 << 6)));
+
+	/*
+	 * L1 is clean: invalidated by the reset or flushed after the
+	 * previous job. The L2 is shared with CPU0 and must be left alone.
+	 */
+	asm volatile("mcr p15, 0, %0, c8, c7, 0" : : "r" (0));
+	invalidate_icache_all();
+
+	asm volatile("mcr p15, 0, %0, c2, c0, 0" : : "r" (ttb) : "memory");
+	asm volatile("mcr p15, 0, %0, c3, c0, 0" : : "r" (~0));
+	CP15DSB;
+	CP15ISB;
+
+	set_cr(get_cr() | CR_M | CR_C | CR_I);
+}
+
+static void secondary_caches_off(void)
+{
+	set_cr(get_cr() & ~CR_C);
+	flush_dcache_all();
+	set_cr(get_cr() & ~(CR_M | CR_I));
+
+	asm volatile("mcr p15, 0, %0, c8, c7, 0" : : "r" (0));
+	invalidate_icache_all();
+}
+
+static void secondary_reply_state(u32 state)
+{
+	writel(state, &reply.state);
+	CP15DSB;
+	__asm__ __volatile__("sev" ::: "memory");
+}
+
+static void secondary_run_job(u32 seq)
+{
+	int (*fn)(void *arg);
+	void *arg;
+	u32 ttb;
+	int ret;
+
+	/* Claim it, then make sure CPU0 did not withdraw it meanwhile */
+	writel(SECONDARY_JOB_CLAIMED, &reply.state);
+	writel(seq, &reply.seq);
+	CP15DSB;
+	if (readl(&job.cancel) == seq) {
+		secondary_reply_state(SECONDARY_JOB_REFUSED);
+		return;
+	}
+
+	fn = job.fn;
+	arg = job.arg;
+	ttb = job.ttb;
+	/* Let the job use helpers that read the global data */
+	gd = job.gd;
+
+	secondary_reply_state(SECONDARY_JOB_RUNNING);
+
+	if (ttb)
+		secondary_caches_on(ttb);
+	ret = fn(arg);
+	if (ttb)
+		secondary_caches_off();
+
+	reply.ret = ret;
+	CP15DSB;
+	secondary_reply_state(SECONDARY_JOB_DONE);
+}
+
+/*
+ * Wait for a job, or for someone to point the boot address elsewhere:
+ * the relocated image when it moves us, or the kernel.
+ */
 static void secondary_pen(void)
 {
 	struct sunxi_cpucfg *cpucfg = (struct sunxi_cpucfg *)SUNXI_CPUCFG_BASE;
+	unsigned long boot_addr;
+	u32 seq;
 
 	while (1) {
-		__asm__ __volatile__("wfe" ::: "memory");
+		seq = readl(&job.seq);
+		if (seq != readl(&reply.seq)) {
+			secondary_run_job(seq);
+			continue;
+		}
 
-		unsigned long boot_addr = readl(&cpucfg->boot_addr);
+		boot_addr = readl(&cpucfg->boot_addr);
+		if (boot_addr != (unsigned long)secondary_init)
+			break;
 
-		__asm__ __volatile__(
-			"mov	r14, %0	\n"
-			"bx	r14	\n"
-			: : "r" (boot_addr)
-		);
-	};
-}
+		__asm__ __volatile__("wfe" ::: "memory");
+	}
 
-u32 secondary_stack[32*(NUM_CORES-1)];
+	__asm__ __volatile__(
+		"mov	r14, %0	\n"
+		"bx	r14	\n"
+		: : "r" (boot_addr)
+	);
+}
 
 void secondary_start(void)
 {
 	secondary_pen();
 }
 
+/*
+ * CPU1 was parked by the pre-relocation image. Give it a real stack and
+ * send it through secondary_init again so it polls our mailbox.
+ */
+static int secondary_move(void)
+{
+	struct sunxi_cpucfg *cpucfg = (struct sunxi_cpucfg *)SUNXI_CPUCFG_BASE;
+	void *stack;
+
+	stack = memalign(8, SECONDARY_JOB_STACK_SIZE);
+	if (!stack)
+		return -ENOMEM;
+
+	secondary_sp = stack + SECONDARY_JOB_STACK_SIZE;
+	flush_dcache_all();
+
+	writel((u32)secondary_init, &cpucfg->boot_addr);
+	CP15DSB;
+	__asm__ __volatile__("sev" ::: "memory");
+
+	secondary_moved = 1;
+
+	return 0;
+}
+
+static void secondary_reply_read(void)
+{
+	invalidate_dcache_range((ulong)&reply, (ulong)(&reply + 1));
+}
+
+int secondary_job_start(int (*fn)(void *arg), void *arg)
+{
+	ulong start;
+	u32 state;
+	int ret;
+
+	if (!secondary_moved) {
+		ret = secondary_move();
+		if (ret)
+			return ret;
+	}
+
+	secondary_reply_read();
+	state = readl(&reply.state);
+	if (readl(&reply.seq) == job.seq &&
+	    (state == SECONDARY_JOB_CLAIMED || state == SECONDARY_JOB_RUNNING))
+		return -EBUSY;
+
+	job.fn = fn;
+	job.arg = arg;
+	job.gd = (gd_t *)gd;
+	job.ttb = dcache_status() ? gd->arch.tlb_addr : 0;
+	job.seq++;
+
+	/* CPU1 comes in with clean caches, hand it everything we wrote */
+	flush_dcache_all();
+	__asm__ __volatile__("sev" ::: "memory");
+
+	/* Poll rather than wfe: a CPU1 that never answers sends no event */
+	start = get_timer(0);
+	while (get_timer(start) < SECONDARY_JOB_ACCEPT_MS) {
+		secondary_reply_read();
+		if (readl(&reply.seq) == job.seq)
+			return 0;
+	}
+
+	/* Withdraw the job, unless CPU1 claims it at the same time */
+	job.cancel = job.seq;
+	flush_dcache_range((ulong)&job, (ulong)(&job + 1));
+	CP15DSB;
+	secondary_reply_read();
+	if (readl(&reply.seq) != job.seq)
+		return -ETIMEDOUT;
+
+	/* It did: CPU1 runs the job or saw it withdrawn, wait to know which */
+	do {
+		secondary_reply_read();
+		state = readl(&reply.state);
+	} while (state == SECONDARY_JOB_CLAIMED);
+
+	return state == SECONDARY_JOB_REFUSED ? -ETIMEDOUT : 0;
+}
+
+int secondary_job_wait(void)
+{
+	u32 state;
+
+	if (!secondary_moved)
+		return -EINVAL;
+
+	while (1) {
+		secondary_reply_read();
+		state = readl(&reply.state);
+		if (readl(&reply.seq) != job.seq ||
+		    state == SECONDARY_JOB_REFUSED)
+			return -EINVAL;
+		if (state == SECONDARY_JOB_DONE)
+			break;
+
+		__asm__ __volatile__("wfe" ::: "memory");
+	}
+
+	return reply.ret;
+}
+
+/* Second half of a buffer for crc32, with the result CPU1 writes back */
+struct secondary_crc32 {
+	const unsigned char *buf;
+	uint len;
+	uint32_t crc;
+} __aligned(ARCH_DMA_MINALIGN);
+
+static struct secondary_crc32 crc_half;
+
+static int secondary_crc32_job(void *arg)
+{
+	struct secondary_crc32 *half = arg;
+
+	half->crc = crc32(0, half->buf, half->len);
+
+	return 0;
+}
+
+uint32_t secondary_crc32_wd(uint32_t crc, const unsigned char *buf,
+			    uint len, uint chunk_sz)
+{
+	uint first = len / 2;
+
+	if (len < SECONDARY_CRC32_MIN)
+		return crc32_wd(crc, buf, len, chunk_sz);
+
+	crc_half.buf = buf + first;
+	crc_half.len = len - first;
+	if (secondary_job_start(secondary_crc32_job, &crc_half))
+		return crc32_wd(crc, buf, len, chunk_sz);
+
+	crc = crc32_wd(crc, buf, first, chunk_sz);
+
+	if (secondary_job_wait())
+		return crc32_wd(crc, buf + first, len - first, chunk_sz);
+
+	invalidate_dcache_range((ulong)&crc_half, (ulong)(&crc_half + 1));
+
+	return crc32_combine(crc, crc_half.crc, len - first);
+}
+
 /* Power on secondaries */
 void startup_secondaries(void)
 {
@@ -0,0 +1,74 @@
+/*
+ * DMA controller register definitions for the Allwinner sun4i, sun5i
+ * and sun7i SoCs.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef _SUNXI_DMA_H
+#define _SUNXI_DMA_H
+
+#include <linux/types.h>
+
+/* normal DMA channel */
+struct sunxi_ndma_reg {
+	u32 cfg;		/* 0x00 configuration */
+	u32 src_addr;		/* 0x04 source address */
+	u32 dst_addr;		/* 0x08 destination address */
+	u32 bcnt;		/* 0x0c byte count */
+	u32 res0[4];
+};
+
+/* dedicated DMA channel */
+struct sunxi_ddma_reg {
+	u32 cfg;		/* 0x00 configuration */
+	u32 src_addr;		/* 0x04 source address */
+	u32 dst_addr;		/* 0x08 destination address */
+	u32 bcnt;		/* 0x0c byte count */
+	u32 res0[2];
+	u32 para;		/* 0x18 parameter */
+	u32 res1;
+};
+
+struct sunxi_dma_reg {
+	u32 irq_en;		/* 0x000 interrupt enable */
+	u32 irq_pend;		/* 0x004 interrupt pending */
+	u32 res0[62];
+	struct sunxi_ndma_reg ndma[8];	/* 0x100 normal DMA channels */
+	u32 res1[64];
+	struct sunxi_ddma_reg ddma[8];	/* 0x300 dedicated DMA channels */
+};
+
+#define SUNXI_DMA_CFG_LOADING		(0x1 << 31)
+#define SUNXI_DMA_CFG_BUSY		(0x1 << 30)
+#define SUNXI_DMA_CFG_DST_WIDTH_32	(0x2 << 25)
+#define SUNXI_DMA_CFG_DST_BURST(n)	((n) << 23)	/* 0: 1, 1: 4, 2: 8 */
+#define SUNXI_DMA_CFG_DST_ADDR_IO	(0x1 << 21)
+#define SUNXI_DMA_CFG_DST_DRQ(n)	((n) << 16)
+#define SUNXI_DMA_CFG_SRC_WIDTH_32	(0x2 << 9)
+#define SUNXI_DMA_CFG_SRC_BURST(n)	((n) << 7)	/* 0: 1, 1: 4, 2: 8 */
+#define SUNXI_DMA_CFG_SRC_ADDR_IO	(0x1 << 5)
+#define SUNXI_DMA_CFG_SRC_DRQ(n)	((n) << 0)
+
+/* dedicated DMA request types */
+#define SUNXI_DDMA_DRQ_SRAM		0x00
+#define SUNXI_DDMA_DRQ_SDRAM		0x01
+#define SUNXI_DDMA_DRQ_NAND		0x03
+#define SUNXI_DDMA_DRQ_EMAC		0x05
+
+#define SUNXI_DDMA_PARA_SRC_WAIT(n)	((n) << 0)
+#define SUNXI_DDMA_PARA_SRC_BLK(n)	((n) << 8)
+#define SUNXI_DDMA_PARA_DST_WAIT(n)	((n) << 16)
+#define SUNXI_DDMA_PARA_DST_BLK(n)	((n) << 24)
+
+/* dedicated DMA channel assignment */
+#define SUNXI_DDMA_CH_EMAC_RX		0
+#define SUNXI_DDMA_CH_EMAC_TX		1
+#define SUNXI_DDMA_CH_NAND		2
+
+void sunxi_dma_init(void);
+void sunxi_ddma_start(int ch, u32 cfg, u32 para, u32 src, u32 dst, u32 len);
+int sunxi_ddma_wait(int ch, unsigned long timeout_ms);
+void sunxi_ddma_stop(int ch);
+
+#endif /* _SUNXI_DMA_H */
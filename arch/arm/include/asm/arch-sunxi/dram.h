@@ -173,6 +173,20 @@ struct dram_para {
 
 #define DRAM_CSEL_MAGIC 0x16237495
 
+/*
+ * Result of the DLL phase scan (tpr3 bit 31), kept in the spare bytes of
+ * the eGON boot header so the BROM loads it into SRAM along with the SPL.
+ * key identifies the board, DRAM parameters and SoC the scan ran on.
+ */
+struct dram_train_cache {
+	u32 key;
+	u32 tpr3;
+	u32 check;		/* key ^ tpr3 ^ DRAM_TRAIN_CACHE_MAGIC */
+};
+
+#define DRAM_TRAIN_CACHE_OFFSET 0x14	/* from the start of the header */
+#define DRAM_TRAIN_CACHE_MAGIC 0x4452544e
+
 unsigned long sunxi_dram_init(void);
 unsigned long dramc_init(struct dram_para *para);
 
@@ -55,6 +55,7 @@ struct sunxi_mmc {
 					 SUNXI_MMC_GCTRL_FIFO_RESET|\
 					 SUNXI_MMC_GCTRL_DMA_RESET)
 #define SUNXI_MMC_GCTRL_DMA_ENABLE	(0x1 << 5)
+#define SUNXI_MMC_GCTRL_DDR_MODE	(0x1 << 10)
 #define SUNXI_MMC_GCTRL_ACCESS_BY_AHB   (0x1 << 31)
 
 #define SUNXI_MMC_CMD_RESP_EXPIRE	(0x1 << 6)
@@ -118,5 +119,36 @@ struct sunxi_mmc {
 #define SUNXI_MMC_IDIE_TXIRQ		(0x1 << 0)
 #define SUNXI_MMC_IDIE_RXIRQ		(0x1 << 1)
 
+#define SUNXI_MMC_IDST_TXIRQ		(0x1 << 0)
+#define SUNXI_MMC_IDST_RXIRQ		(0x1 << 1)
+#define SUNXI_MMC_IDST_FATAL_BUS_ERROR	(0x1 << 2)
+#define SUNXI_MMC_IDST_DES_INVALID	(0x1 << 4)
+#define SUNXI_MMC_IDST_CARD_ERROR_SUM	(0x1 << 5)
+#define SUNXI_MMC_IDST_ERROR		(SUNXI_MMC_IDST_FATAL_BUS_ERROR |\
+					 SUNXI_MMC_IDST_DES_INVALID |\
+					 SUNXI_MMC_IDST_CARD_ERROR_SUM)
+
+/* burst size 8, RX watermark 7, TX watermark 8 */
+#define SUNXI_MMC_FTRGLEVEL_DMA		0x20070008
+
+/* internal DMA controller descriptor */
+struct sunxi_mmc_des {
+	u32 config;		/* control and status */
+	u32 buf_size;		/* buffer size in bytes */
+	u32 buf_addr;		/* buffer address */
+	u32 next_desc;		/* next descriptor address */
+};
+
+#define SUNXI_MMC_DES_DIC		(0x1 << 1)  /* no irq on completion */
+#define SUNXI_MMC_DES_LAST		(0x1 << 2)
+#define SUNXI_MMC_DES_FIRST		(0x1 << 3)
+#define SUNXI_MMC_DES_CHAIN		(0x1 << 4)
+#define SUNXI_MMC_DES_END_OF_RING	(0x1 << 5)
+#define SUNXI_MMC_DES_CARD_ERROR	(0x1 << 30)
+#define SUNXI_MMC_DES_OWN		(0x1 << 31)
+
+/* sun4i only has 13 bits of buffer size, so stick to 8 KiB everywhere */
+#define SUNXI_MMC_DES_MAX_LEN		0x2000
+
 int sunxi_mmc_init(int sdc_no);
 #endif /* _SUNXI_MMC_H */
@@ -0,0 +1,124 @@
+/*
+ * NAND flash controller register definitions for the Allwinner A10,
+ * A13 and A20 SoCs.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef _SUNXI_NAND_H
+#define _SUNXI_NAND_H
+
+#include <linux/types.h>
+
+struct sunxi_nfc {
+	u32 ctl;		/* 0x000 configure and control */
+	u32 st;			/* 0x004 status information */
+	u32 intr;		/* 0x008 interrupt control */
+	u32 timing_ctl;		/* 0x00c timing control */
+	u32 timing_cfg;		/* 0x010 timing configure */
+	u32 addr_low;		/* 0x014 low word address */
+	u32 addr_high;		/* 0x018 high word address */
+	u32 sector_num;		/* 0x01c number of data sectors */
+	u32 cnt;		/* 0x020 data counter */
+	u32 cmd;		/* 0x024 command and command type */
+	u32 rcmd_set;		/* 0x028 read command set */
+	u32 wcmd_set;		/* 0x02c write command set */
+	u32 io_data;		/* 0x030 IO data */
+	u32 ecc_ctl;		/* 0x034 ECC configure and control */
+	u32 ecc_st;		/* 0x038 ECC status */
+	u32 debug;		/* 0x03c debug */
+	u32 ecc_err_cnt[4];	/* 0x040 corrected bits, one byte per step */
+	u32 user_data[16];	/* 0x050 user data field, one word per step */
+	u32 res0[4];
+	u32 spare_area;		/* 0x0a0 spare area column */
+	u32 pat_id;		/* 0x0a4 pattern id */
+	u32 res1[214];
+	u8 ram0[1024];		/* 0x400 internal data RAM */
+	u8 ram1[1024];		/* 0x800 internal data RAM */
+};
+
+#define SUNXI_NFC_RAM_SIZE		1024
+
+/* ctl */
+#define SUNXI_NFC_CTL_EN		(0x1 << 0)
+#define SUNXI_NFC_CTL_RESET		(0x1 << 1)
+#define SUNXI_NFC_CTL_BUS_WIDTH_16	(0x1 << 2)
+#define SUNXI_NFC_CTL_RB_SEL(x)		((x) << 3)
+#define SUNXI_NFC_CTL_RB_SEL_MASK	(0x1 << 3)
+#define SUNXI_NFC_CTL_CE_CTL		(0x1 << 6)
+#define SUNXI_NFC_CTL_PAGE_SHIFT(x)	(((x) < 10 ? 0 : (x) - 10) << 8)
+#define SUNXI_NFC_CTL_PAGE_SHIFT_MASK	(0xf << 8)
+#define SUNXI_NFC_CTL_RAM_METHOD	(0x1 << 14)	/* DMA access */
+#define SUNXI_NFC_CTL_CE_SEL(x)		((x) << 24)
+#define SUNXI_NFC_CTL_CE_SEL_MASK	(0x7 << 24)
+
+/* st */
+#define SUNXI_NFC_ST_RB_B2R		(0x1 << 0)
+#define SUNXI_NFC_ST_CMD_INT_FLAG	(0x1 << 1)
+#define SUNXI_NFC_ST_DMA_INT_FLAG	(0x1 << 2)
+#define SUNXI_NFC_ST_CMD_FIFO_STATUS	(0x1 << 3)
+#define SUNXI_NFC_ST_STA		(0x1 << 4)
+#define SUNXI_NFC_ST_RB_STATE(x)	(0x1 << ((x) + 8))
+
+/* cmd */
+#define SUNXI_NFC_CMD_ADR_NUM(x)	(((x) - 1) << 16)
+#define SUNXI_NFC_CMD_SEND_ADR		(0x1 << 19)
+#define SUNXI_NFC_CMD_ACCESS_DIR	(0x1 << 20)	/* write */
+#define SUNXI_NFC_CMD_DATA_TRANS	(0x1 << 21)
+#define SUNXI_NFC_CMD_SEND_CMD1		(0x1 << 22)
+#define SUNXI_NFC_CMD_WAIT_FLAG		(0x1 << 23)
+#define SUNXI_NFC_CMD_SEND_CMD2		(0x1 << 24)
+#define SUNXI_NFC_CMD_SEQ		(0x1 << 25)
+#define SUNXI_NFC_CMD_DATA_SWAP_METHOD	(0x1 << 26)
+#define SUNXI_NFC_CMD_NORMAL_OP		(0x0 << 30)
+#define SUNXI_NFC_CMD_ECC_OP		(0x1 << 30)
+#define SUNXI_NFC_CMD_PAGE_OP		(0x2 << 30)
+
+/* rcmd_set: page read, random data output and its confirm command */
+#define SUNXI_NFC_RCMD(read, rndout, rndstart) \
+	((read) | ((rndout) << 8) | ((rndstart) << 16))
+/* wcmd_set: page program and random data input command */
+#define SUNXI_NFC_WCMD(prog, rndin)	((prog) | ((rndin) << 8))
+
+/* ecc_ctl */
+#define SUNXI_NFC_ECC_EN		(0x1 << 0)
+#define SUNXI_NFC_ECC_PIPELINE		(0x1 << 3)
+#define SUNXI_NFC_ECC_EXCEPTION		(0x1 << 4)
+#define SUNXI_NFC_ECC_BLOCK_512		(0x1 << 5)
+#define SUNXI_NFC_ECC_RANDOM_EN		(0x1 << 9)
+#define SUNXI_NFC_ECC_RANDOM_DIRECTION	(0x1 << 10)
+#define SUNXI_NFC_ECC_MODE(x)		((x) << 12)
+#define SUNXI_NFC_ECC_MODE_MASK		(0xf << 12)
+#define SUNXI_NFC_ECC_RANDOM_SEED(x)	((x) << 16)
+#define SUNXI_NFC_ECC_RANDOM_SEED_MASK	(0x7fff << 16)
+
+/* ecc_st */
+#define SUNXI_NFC_ECC_ERR(x)		(0x1 << (x))
+#define SUNXI_NFC_ECC_PAT_FOUND(x)	(0x1 << ((x) + 16))
+#define SUNXI_NFC_ECC_ERR_CNT(regs, x) \
+	((readl(&(regs)->ecc_err_cnt[(x) / 4]) >> (((x) % 4) * 8)) & 0xff)
+
+/* The BCH engine works on 1 KiB steps, 4 bytes of user data each */
+#define SUNXI_NAND_ECC_STEP		1024
+#define SUNXI_NAND_USER_DATA_LEN	4
+#define SUNXI_NAND_MAX_STEPS		16
+
+/* The randomizer seed of a page repeats every this many pages at most */
+#define SUNXI_NAND_RND_MAX_PAGES	128
+
+/* ECC bytes the engine stores per step for a given strength */
+static inline int sunxi_nand_ecc_bytes(int strength)
+{
+	/* 14 bits per correctable bit, always an even number of bytes */
+	return ALIGN(DIV_ROUND_UP(strength * 14, 8), 2);
+}
+
+/* sunxi_nand_common.c, shared by the driver and the SPL loader */
+int sunxi_nand_ecc_strength(int mode);
+int sunxi_nand_ecc_mode(int page_size, int oob_size);
+u16 sunxi_nand_rnd_step(u16 state, int count);
+u16 sunxi_nand_rnd_seed(int page, int pages_per_block);
+
+void sunxi_nand_board_init(void);
+
+#endif /* _SUNXI_NAND_H */
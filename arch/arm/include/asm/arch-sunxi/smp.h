@@ -14,6 +14,29 @@
 
 void startup_secondaries(void);
 
+/*
+ * Run fn(arg) on CPU1 while CPU0 carries on, one job at a time. CPU1
+ * uses the same page table, but as U-Boot maps memory non-shareable its
+ * caches are not kept coherent with CPU0's: leave the buffers the job
+ * works on alone until secondary_job_wait() returns. Jobs must not use
+ * the console, malloc or drivers. secondary_job_start() fails if CPU1
+ * does not take the job, which it then never runs; secondary_job_wait()
+ * blocks and returns what fn returned.
+ */
+#define SECONDARY_JOB_STACK_SIZE	(16 << 10)
+
+int secondary_job_start(int (*fn)(void *arg), void *arg);
+int secondary_job_wait(void);
+
+/*
+ * crc32_wd() with CPU1 taking the second half of buffers of at least
+ * SECONDARY_CRC32_MIN bytes. Used by the crc32 command and hash_block().
+ */
+#define SECONDARY_CRC32_MIN		(64 << 10)
+
+uint32_t secondary_crc32_wd(uint32_t crc, const unsigned char *buf,
+			    uint len, uint chunk_sz);
+
 /* Assembly entry point */
 extern void secondary_init(void);
 
@@ -13,4 +13,17 @@
 
 void sdelay(unsigned long);
 
+/*
+ * The medium the boot ROM loaded the SPL from. The boot ROM writes it
+ * into the eGON boot header, which stays at the start of SRAM A1.
+ */
+#define SUNXI_BOOT_MEDIA_OFFSET	0x28	/* from the start of the header */
+#define SUNXI_BOOTED_FROM_FEL	-1	/* no header: loaded over USB */
+#define SUNXI_BOOTED_FROM_MMC0	0
+#define SUNXI_BOOTED_FROM_NAND	1
+#define SUNXI_BOOTED_FROM_MMC2	2
+#define SUNXI_BOOTED_FROM_SPI	3
+
+int sunxi_get_boot_source(void);
+
 #endif
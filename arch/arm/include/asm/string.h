@@ -31,6 +31,16 @@ extern void * memchr(const void *, int, __kernel_size_t);
 #endif
 extern void * memset(void *, int, __kernel_size_t);
 
+/* Both versions, built side by side for CONFIG_CMD_MEMBENCH */
+#ifdef CONFIG_USE_ARCH_MEMCPY_NEON
+extern void *memcpy_arm(void *, const void *, __kernel_size_t);
+extern void *memcpy_neon(void *, const void *, __kernel_size_t);
+#endif
+#ifdef CONFIG_USE_ARCH_MEMSET_NEON
+extern void *memset_arm(void *, int, __kernel_size_t);
+extern void *memset_neon(void *, int, __kernel_size_t);
+#endif
+
 #if 0
 extern void __memzero(void *ptr, __kernel_size_t n);
 
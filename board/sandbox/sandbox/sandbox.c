@@ -6,6 +6,7 @@
 #include <common.h>
 #include <cros_ec.h>
 #include <dm.h>
+#include <netdev.h>
 #include <os.h>
 #include <asm/u-boot-sandbox.h>
 
@@ -53,6 +54,13 @@ int board_early_init_f(void)
 }
 #endif
 
+#ifdef CONFIG_SANDBOX_ETH_TAP
+int board_eth_init(bd_t *bis)
+{
+	return sandbox_tap_initialize(bis);
+}
+#endif
+
 int arch_early_init_r(void)
 {
 #ifdef CONFIG_CROS_EC
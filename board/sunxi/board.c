@@ -26,7 +26,10 @@
 #include <asm/arch/dram.h>
 #include <asm/arch/gpio.h>
 #include <asm/arch/mmc.h>
+#include <asm/arch/nand.h>
+#include <asm/arch/sys_proto.h>
 #include <asm/io.h>
+#include <mmc.h>
 #include <net.h>
 
 DECLARE_GLOBAL_DATA_PTR;
@@ -95,7 +98,12 @@ static void mmc_pinmux_setup(int sdc)
 
 	case 2:
 		/* CMD-PC6, CLK-PC7, D0-PC8, D1-PC9, D2-PC10, D3-PC11 */
+#ifdef CONFIG_MMC_SUNXI_SLOT2_8BIT
+		/* D4-PC12, D5-PC13, D6-PC14, D7-PC15 */
+		for (pin = SUNXI_GPC(6); pin <= SUNXI_GPC(15); pin++) {
+#else
 		for (pin = SUNXI_GPC(6); pin <= SUNXI_GPC(11); pin++) {
+#endif
 			sunxi_gpio_set_cfgpin(pin, SUNXI_GPC6_SDC2);
 			sunxi_gpio_set_pull(pin, SUNXI_GPIO_PULL_UP);
 			sunxi_gpio_set_drv(pin, 2);
@@ -130,6 +138,23 @@ int board_mmc_init(bd_t *bis)
 }
 #endif
 
+#ifdef CONFIG_NAND_SUNXI
+void sunxi_nand_board_init(void)
+{
+	struct sunxi_ccm_reg *const ccm =
+		(struct sunxi_ccm_reg *)SUNXI_CCM_BASE;
+	unsigned int pin;
+
+	/* WE, ALE, CLE, CE0/1, RE, RB0/1, D0-D7, WP, CE2/3 */
+	for (pin = SUNXI_GPC(0); pin <= SUNXI_GPC(19); pin++)
+		sunxi_gpio_set_cfgpin(pin, SUNXI_GPC0_NAND);
+
+	setbits_le32(&ccm->ahb_gate0, CLK_GATE_OPEN << AHB_GATE_OFFSET_NAND);
+	writel(CCM_NAND_CTRL_ENABLE | (NAND_CLK_SRC_OSC24 << 24) |
+	       (NAND_CLK_DIV_N << 16) | NAND_CLK_DIV_M, &ccm->nand_sclk_cfg);
+}
+#endif
+
 void i2c_init_board(void)
 {
 	sunxi_gpio_set_cfgpin(SUNXI_GPB(0), SUNXI_GPB0_TWI0);
@@ -213,9 +238,60 @@ void spl_display_print(void)
 }
 #endif
 
+#if defined(CONFIG_SUNXI_DRAM_TRAIN_SAVE) && defined(CONFIG_MMC) && \
+    !defined(CONFIG_SPL_BUILD) && !defined(CONFIG_SPL_FEL)
+#define SUNXI_SPL_MMC_SECTOR	16	/* the BROM loads the SPL from 8 KiB */
+
+/*
+ * After a full DLL scan the SPL leaves its result in the spare bytes of
+ * the boot header in SRAM. Store it in the SPL image on the card we were
+ * booted from, adjusting the header checksum which covers those bytes.
+ * Nothing is written unless the boot ROM loaded us from the card that is
+ * mmc 0 and the result differs from what the card already holds.
+ */
+static void sunxi_dram_train_save(void)
+{
+	struct dram_train_cache *sram = (struct dram_train_cache *)
+			(SUNXI_SRAM_A1_BASE + DRAM_TRAIN_CACHE_OFFSET);
+	ALLOC_CACHE_ALIGN_BUFFER(u32, blk, 512 / sizeof(u32));
+	struct dram_train_cache *disk = (struct dram_train_cache *)
+			((char *)blk + DRAM_TRAIN_CACHE_OFFSET);
+	struct mmc *mmc;
+
+	if (CONFIG_MMC_SUNXI_SLOT != 0 ||
+	    sunxi_get_boot_source() != SUNXI_BOOTED_FROM_MMC0)
+		return;
+
+	if (sram->check != (sram->key ^ sram->tpr3 ^ DRAM_TRAIN_CACHE_MAGIC))
+		return;
+
+	mmc = find_mmc_device(0);
+	if (!mmc || mmc_init(mmc) ||
+	    mmc->block_dev.block_read(0, SUNXI_SPL_MMC_SECTOR, 1, blk) != 1)
+		return;
+
+	/* same jump, magic, checksum and length: the image we run from */
+	if (memcmp(blk, (void *)SUNXI_SRAM_A1_BASE, DRAM_TRAIN_CACHE_OFFSET) ||
+	    !memcmp(disk, sram, sizeof(*sram)))
+		return;
+
+	blk[3] += sram->key + sram->tpr3 + sram->check;
+	blk[3] -= disk->key + disk->tpr3 + disk->check;
+	memcpy(disk, sram, sizeof(*sram));
+
+	if (mmc->block_dev.block_write(0, SUNXI_SPL_MMC_SECTOR, 1, blk) == 1)
+		printf("DRAM:  training results saved\n");
+}
+#endif
+
 #ifdef CONFIG_MISC_INIT_R
 int misc_init_r(void)
 {
+#if defined(CONFIG_SUNXI_DRAM_TRAIN_SAVE) && defined(CONFIG_MMC) && \
+    !defined(CONFIG_SPL_BUILD) && !defined(CONFIG_SPL_FEL)
+	sunxi_dram_train_save();
+#endif
+
 	if (!getenv("ethaddr")) {
 		uint32_t reg_val = readl(SUNXI_SID_BASE);
 
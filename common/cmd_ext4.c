@@ -37,6 +37,7 @@
 #include <linux/stat.h>
 #include <malloc.h>
 #include <fs.h>
+#include <asm/io.h>
 
 #if defined(CONFIG_CMD_USB) && defined(CONFIG_USB_STORAGE)
 #include <usb.h>
@@ -92,7 +93,8 @@ int do_ext4_write(cmd_tbl_t *cmdtp, int flag, int argc,
 	}
 
 	/* start write */
-	if (ext4fs_write(filename, (unsigned char *)ram_address, file_size)) {
+	if (ext4fs_write(filename, map_sysmem(ram_address, file_size),
+			 file_size)) {
 		printf("** Error ext4fs_write() **\n");
 		goto fail;
 	}
@@ -113,6 +115,29 @@ U_BOOT_CMD(ext4write, 6, 1, do_ext4_write,
 
 #endif
 
+#ifdef CONFIG_EXT4_META_CACHE
+int do_ext4_cache(cmd_tbl_t *cmdtp, int flag, int argc, char *const argv[])
+{
+	if (argc == 1) {
+		ext4fs_cache_info();
+		return 0;
+	}
+	if (argc == 2 && !strcmp(argv[1], "drop")) {
+		ext4fs_cache_drop();
+		return 0;
+	}
+
+	return cmd_usage(cmdtp);
+}
+
+U_BOOT_CMD(ext4cache, 2, 0, do_ext4_cache,
+	   "ext4 metadata cache",
+	   "\n"
+	   "    - show what is cached, and hits and misses\n"
+	   "ext4cache drop\n"
+	   "    - empty the cache");
+#endif
+
 U_BOOT_CMD(ext4ls, 4, 1, do_ext4_ls,
 	   "list files in a directory (default /)",
 	   "<interface> <dev[:part]> [directory]\n"
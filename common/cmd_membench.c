@@ -0,0 +1,155 @@
+/*
+ * Compare memcpy/memset throughput against plain C loops
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <div64.h>
+
+/* Byte and word loops as in lib/string.c, which arch versions replace */
+static void *copy_byte(void *dest, const void *src, size_t count)
+{
+	char *d = dest;
+	const char *s = src;
+
+	while (count--)
+		*d++ = *s++;
+
+	return dest;
+}
+
+static void *copy_word(void *dest, const void *src, size_t count)
+{
+	unsigned long *dl = dest;
+	const unsigned long *sl = src;
+	char *d;
+	const char *s;
+
+	if ((((ulong)dest | (ulong)src) & (sizeof(*dl) - 1)) == 0) {
+		while (count >= sizeof(*dl)) {
+			*dl++ = *sl++;
+			count -= sizeof(*dl);
+		}
+	}
+
+	d = (char *)dl;
+	s = (const char *)sl;
+	while (count--)
+		*d++ = *s++;
+
+	return dest;
+}
+
+static void *fill_byte(void *s, int c, size_t count)
+{
+	char *d = s;
+
+	while (count--)
+		*d++ = c;
+
+	return s;
+}
+
+static void *fill_word(void *s, int c, size_t count)
+{
+	unsigned long *sl = s;
+	unsigned long cl = 0;
+	char *d;
+	int i;
+
+	if (((ulong)s & (sizeof(*sl) - 1)) == 0) {
+		for (i = 0; i < sizeof(*sl); i++)
+			cl = (cl << 8) | (c & 0xff);
+		while (count >= sizeof(*sl)) {
+			*sl++ = cl;
+			count -= sizeof(*sl);
+		}
+	}
+
+	d = (char *)sl;
+	while (count--)
+		*d++ = c;
+
+	return s;
+}
+
+static struct {
+	const char *name;
+	void *(*copy)(void *dest, const void *src, size_t count);
+	void *(*fill)(void *s, int c, size_t count);
+} membench_variants[] = {
+	{ "byte",	copy_byte,	fill_byte },
+	{ "word",	copy_word,	fill_word },
+#if defined(CONFIG_USE_ARCH_MEMCPY_NEON) && \
+    defined(CONFIG_USE_ARCH_MEMSET_NEON)
+	/* arch/arm/lib builds the plain ARM versions alongside for us */
+	{ "arm",	memcpy_arm,	memset_arm },
+	{ "neon",	memcpy_neon,	memset_neon },
+#else
+	/* whatever this build links, e.g. CONFIG_USE_ARCH_MEMCPY */
+	{ "string",	memcpy,		memset },
+#endif
+};
+
+/* Print size * loops bytes over msec as MiB/s */
+static void membench_report(const char *op, const char *name, ulong size,
+			    ulong loops, ulong msec)
+{
+	u64 rate = (u64)size * loops * 1000;
+
+	if (!msec)
+		msec = 1;
+	do_div(rate, msec);
+
+	printf("%s %-8s %6lu MiB/s\n", op, name, (ulong)(rate >> 20));
+}
+
+static int do_membench(cmd_tbl_t *cmdtp, int flag, int argc,
+		       char * const argv[])
+{
+	void *dest, *src;
+	ulong size, loops, start, i, j;
+
+	if (argc < 4)
+		return CMD_RET_USAGE;
+
+	dest = (void *)simple_strtoul(argv[1], NULL, 16);
+	src = (void *)simple_strtoul(argv[2], NULL, 16);
+	size = simple_strtoul(argv[3], NULL, 16);
+	loops = argc > 4 ? simple_strtoul(argv[4], NULL, 10) : 1;
+	if (!size || !loops)
+		return CMD_RET_USAGE;
+
+	for (i = 0; i < ARRAY_SIZE(membench_variants); i++) {
+		start = get_timer(0);
+		for (j = 0; j < loops; j++)
+			membench_variants[i].copy(dest, src, size);
+		membench_report("copy", membench_variants[i].name, size,
+				loops, get_timer(start));
+		if (ctrlc())
+			return CMD_RET_FAILURE;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(membench_variants); i++) {
+		start = get_timer(0);
+		for (j = 0; j < loops; j++)
+			membench_variants[i].fill(dest, 0x55, size);
+		membench_report("fill", membench_variants[i].name, size,
+				loops, get_timer(start));
+		if (ctrlc())
+			return CMD_RET_FAILURE;
+	}
+
+	return CMD_RET_SUCCESS;
+}
+
+U_BOOT_CMD(
+	membench,	5,	0,	do_membench,
+	"measure memory copy and fill throughput",
+	"dest src size [loops]\n"
+	"    - copy size bytes from src to dest and fill dest, loops times,\n"
+	"      with byte and word C loops and with memcpy/memset, or with\n"
+	"      both the ARM and the NEON versions where NEON is selected"
+);
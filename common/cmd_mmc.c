@@ -96,7 +96,8 @@ static void print_mmcinfo(struct mmc *mmc)
 	puts("Capacity: ");
 	print_size(mmc->capacity, "\n");
 
-	printf("Bus Width: %d-bit\n", mmc->bus_width);
+	printf("Bus Width: %d-bit%s\n", mmc->bus_width,
+	       mmc->ddr_mode ? " DDR" : "");
 }
 
 static int do_mmcinfo(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
@@ -10,6 +10,7 @@
  */
 #include <common.h>
 #include <command.h>
+#include <div64.h>
 #include <net.h>
 
 static int netboot_common(enum proto_t, cmd_tbl_t *, int, char * const []);
@@ -113,6 +114,20 @@ U_BOOT_CMD(
 );
 #endif
 
+#if defined(CONFIG_CMD_WGET)
+static int do_wget(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
+{
+	return netboot_common(WGET, cmdtp, argc, argv);
+}
+
+U_BOOT_CMD(
+	wget,	3,	1,	do_wget,
+	"boot image via network using HTTP",
+	"[loadAddress] [[hostIPaddr:]path]\n"
+	"    - the server port is taken from 'httpport' (default 80)"
+);
+#endif
+
 static void netboot_update_env(void)
 {
 	char tmp[22];
@@ -445,3 +460,71 @@ U_BOOT_CMD(
 );
 
 #endif  /* CONFIG_CMD_LINK_LOCAL */
+
+#if defined(CONFIG_CMD_NET_BENCH)
+static const char *const net_proto_names[] = {
+	[BOOTP]		= "BOOTP",
+	[RARP]		= "RARP",
+	[ARP]		= "ARP",
+	[TFTPGET]	= "TFTP",
+	[DHCP]		= "DHCP",
+	[PING]		= "PING",
+	[DNS]		= "DNS",
+	[NFS]		= "NFS",
+	[CDP]		= "CDP",
+	[NETCONS]	= "NETCONS",
+	[SNTP]		= "SNTP",
+	[TFTPSRV]	= "TFTPSRV",
+	[TFTPPUT]	= "TFTPPUT",
+	[LINKLOCAL]	= "LINKLOCAL",
+	[WGET]		= "WGET",
+};
+
+static void net_bench_report(ulong msecs)
+{
+	struct net_proto_stats *p;
+	u64 rate;
+	int i;
+
+	for (i = 0; i < net_stats.nprotos; i++) {
+		p = &net_stats.protos[i];
+		rate = (u64)p->bytes * 1000;
+		do_div(rate, p->msecs ? p->msecs : 1);
+		printf("%-9s %lu run(s), %lu bytes in %lu ms, %lu KiB/s, "
+		       "%lu retransmits\n", net_proto_names[p->proto],
+		       p->runs, p->bytes, p->msecs, (ulong)(rate >> 10),
+		       p->retransmits);
+	}
+
+	printf("rx: %lu frames, %lu dropped, %lu ms in NetReceive (%lu%%)\n",
+	       net_stats.rx_frames, net_stats.rx_drops,
+	       net_stats.rx_us / 1000,
+	       msecs ? net_stats.rx_us / 10 / msecs : 0);
+	printf("tx: %lu frames\n", net_stats.tx_frames);
+}
+
+static int do_net(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
+{
+	ulong start;
+	int repeatable, ret;
+
+	if (argc < 3 || strcmp(argv[1], "bench"))
+		return CMD_RET_USAGE;
+
+	memset(&net_stats, 0, sizeof(net_stats));
+	start = get_timer(0);
+	ret = cmd_process(flag, argc - 2, argv + 2, &repeatable, NULL);
+	net_bench_report(get_timer(start));
+
+	return ret ? CMD_RET_FAILURE : CMD_RET_SUCCESS;
+}
+
+U_BOOT_CMD(
+	net,	CONFIG_SYS_MAXARGS,	0,	do_net,
+	"network stack measurements",
+	"bench command [args...]\n"
+	"    - run a network command, e.g. tftpboot, and report goodput and\n"
+	"      retransmits per protocol, dropped frames and the time spent\n"
+	"      in NetReceive()"
+);
+#endif	/* CONFIG_CMD_NET_BENCH */
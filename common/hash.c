@@ -19,6 +19,25 @@
 #include <asm/io.h>
 #include <asm/errno.h>
 
+#ifdef CONFIG_SYS_SECONDARY_ON
+#include <asm/arch/smp.h>
+
+/* Let the second core take half of large buffers */
+#define hash_crc32_wd	secondary_crc32_wd
+
+static void hash_crc32_wd_buf(const unsigned char *input, unsigned int ilen,
+			      unsigned char *output, unsigned int chunk_sz)
+{
+	uint32_t crc;
+
+	crc = htonl(hash_crc32_wd(0, input, ilen, chunk_sz));
+	memcpy(output, &crc, sizeof(crc));
+}
+#else
+#define hash_crc32_wd		crc32_wd
+#define hash_crc32_wd_buf	crc32_wd_buf
+#endif
+
 /*
  * These are the hash algorithms we support. Chips which support accelerated
  * crypto could perhaps add named version of these algorithms here. Note that
@@ -68,7 +87,7 @@ static struct hash_algo hash_algo[] = {
 	{
 		"crc32",
 		4,
-		crc32_wd_buf,
+		hash_crc32_wd_buf,
 		CHUNKSZ_CRC32,
 	},
 };
@@ -320,7 +339,7 @@ int hash_command(const char *algo_name, int flags, cmd_tbl_t *cmdtp, int flag,
 		ulong crc;
 		ulong *ptr;
 
-		crc = crc32_wd(0, (const uchar *)addr, len, CHUNKSZ_CRC32);
+		crc = hash_crc32_wd(0, (const uchar *)addr, len, CHUNKSZ_CRC32);
 
 		printf("CRC32 for %08lx ... %08lx ==> %08lx\n",
 				addr, addr + len - 1, crc);
@@ -53,9 +53,183 @@ end:
 	return (err == 0);
 }
 
+#ifdef CONFIG_SPL_MMC_OS_VERIFY
+/*
+ * Read blkcnt blocks from sector to dst in chunks of cfg->b_max blocks,
+ * and go on with the CRC in *crc over the len bytes at dst + skip while
+ * the following chunk is still being transferred.
+ */
+static int mmc_read_crc(struct mmc *mmc, lbaint_t sector, lbaint_t blkcnt,
+			uchar *dst, ulong skip, ulong len, u32 *crc)
+{
+	lbaint_t done, cur;
+	ulong pos = skip, end;
+	int err;
+
+	for (done = 0; done < blkcnt; done += cur) {
+		cur = min(blkcnt - done, (lbaint_t)mmc->cfg->b_max);
+		err = mmc_bread_start(mmc, sector + done, cur,
+				      dst + done * mmc->read_bl_len);
+		if (err)
+			return err;
+
+		end = min(done * mmc->read_bl_len, skip + len);
+		if (end > pos) {
+			*crc = crc32(*crc, dst + pos, end - pos);
+			pos = end;
+		}
+
+		err = mmc_bread_wait(mmc);
+		if (err)
+			return err;
+	}
+
+	*crc = crc32(*crc, dst + pos, skip + len - pos);
+
+	return 0;
+}
+
+/*
+ * Check the CRC of a uImage header. A copy goes to hdr, as header may be
+ * overwritten by the image data.
+ */
+static int mmc_check_header(struct image_header *header,
+			    struct image_header *hdr, const char *what)
+{
+	u32 hcrc;
+
+	memcpy(hdr, header, sizeof(*hdr));
+	hdr->ih_hcrc = 0;
+	hcrc = crc32(0, (const uchar *)hdr, sizeof(*hdr));
+	hdr->ih_hcrc = header->ih_hcrc;
+	if (hcrc != image_get_hcrc(header)) {
+		printf("spl: bad %s header CRC\n", what);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Read the uImage header at sector to header and check its magic and CRC */
+static int mmc_read_header(struct mmc *mmc, unsigned long sector,
+			   struct image_header *header,
+			   struct image_header *hdr, const char *what)
+{
+	if (mmc->block_dev.block_read(0, sector, 1, header) != 1)
+		return -1;
+
+	if (image_get_magic(header) != IH_MAGIC) {
+		printf("spl: %s is not an uImage\n", what);
+		return -1;
+	}
+
+	return mmc_check_header(header, hdr, what);
+}
+
+/* Load the kernel uImage and check both its header and data CRC */
+static int mmc_load_image_raw_verify(struct mmc *mmc, unsigned long sector)
+{
+	struct image_header *header, hdr;
+	u32 image_size_sectors, dcrc;
+
+	header = (struct image_header *)(CONFIG_SYS_TEXT_BASE -
+						sizeof(struct image_header));
+
+	if (mmc_read_header(mmc, sector, header, &hdr, "kernel"))
+		return -1;
+
+	spl_parse_image_header(header);
+
+	image_size_sectors = (spl_image.size + mmc->read_bl_len - 1) /
+				mmc->read_bl_len;
+
+	/* Straight to the load address, header included as above */
+	dcrc = 0;
+	if (mmc_read_crc(mmc, sector, image_size_sectors,
+			 (uchar *)spl_image.load_addr, sizeof(hdr),
+			 image_get_data_size(&hdr), &dcrc)) {
+		puts("spl: mmc blk read err\n");
+		return -1;
+	}
+
+	if (dcrc != image_get_dcrc(&hdr)) {
+		puts("spl: bad kernel data CRC\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * The args area holds the device tree or ATAGS as 'spl export' leaves
+ * them, which are loaded as they are, or the same wrapped in a uImage
+ * (mkimage -T flat_dt -C none) to have them checked like the kernel.
+ * The payload of a uImage goes straight to CONFIG_SYS_SPL_ARGS_ADDR:
+ * what shares the first block with the header is copied from there, the
+ * rest is read to its place, and only as far as the image needs.
+ */
+static int mmc_load_args(struct mmc *mmc)
+{
+	ALLOC_CACHE_ALIGN_BUFFER(uchar, first, MMC_MAX_BLOCK_LEN);
+	struct image_header *header = (struct image_header *)first;
+	struct image_header hdr;
+	uchar *args = (uchar *)CONFIG_SYS_SPL_ARGS_ADDR;
+	unsigned long sector = CONFIG_SYS_MMCSD_RAW_MODE_ARGS_SECTOR;
+	lbaint_t blkcnt;
+	ulong size, head;
+	u32 dcrc;
+
+	if (mmc->block_dev.block_read(0, sector, 1, first) != 1)
+		return -1;
+
+	if (image_get_magic(header) != IH_MAGIC) {
+		blkcnt = CONFIG_SYS_MMCSD_RAW_MODE_ARGS_SECTORS;
+		if (mmc->block_dev.block_read(0, sector, blkcnt, args) !=
+		    blkcnt)
+			return -1;
+		return 0;
+	}
+
+	if (mmc_check_header(header, &hdr, "args"))
+		return -1;
+
+	size = image_get_data_size(&hdr);
+	blkcnt = (sizeof(hdr) + size + mmc->read_bl_len - 1) /
+			mmc->read_bl_len;
+	if (blkcnt > CONFIG_SYS_MMCSD_RAW_MODE_ARGS_SECTORS) {
+		puts("spl: args larger than their area\n");
+		return -1;
+	}
+
+	head = min(size, mmc->read_bl_len - sizeof(hdr));
+	memcpy(args, first + sizeof(hdr), head);
+	dcrc = crc32(0, args, head);
+	if (blkcnt > 1 &&
+	    mmc_read_crc(mmc, sector + 1, blkcnt - 1, args + head, 0,
+			 size - head, &dcrc))
+		return -1;
+
+	if (dcrc != image_get_dcrc(&hdr)) {
+		puts("spl: bad args data CRC\n");
+		return -1;
+	}
+
+	return 0;
+}
+#endif
+
 #ifdef CONFIG_SPL_OS_BOOT
 static int mmc_load_image_raw_os(struct mmc *mmc)
 {
+#ifdef CONFIG_SPL_MMC_OS_VERIFY
+	if (mmc_load_args(mmc)) {
+		puts("mmc args load error\n");
+		return -1;
+	}
+
+	return mmc_load_image_raw_verify(mmc,
+					 CONFIG_SYS_MMCSD_RAW_MODE_KERNEL_SECTOR);
+#else
 	if (!mmc->block_dev.block_read(0,
 				       CONFIG_SYS_MMCSD_RAW_MODE_ARGS_SECTOR,
 				       CONFIG_SYS_MMCSD_RAW_MODE_ARGS_SECTORS,
@@ -67,6 +241,7 @@ static int mmc_load_image_raw_os(struct mmc *mmc)
 	}
 
 	return mmc_load_image_raw(mmc, CONFIG_SYS_MMCSD_RAW_MODE_KERNEL_SECTOR);
+#endif
 }
 #endif
 
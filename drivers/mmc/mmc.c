@@ -48,10 +48,70 @@ int __board_mmc_getcd(struct mmc *mmc) {
 int board_mmc_getcd(struct mmc *mmc)__attribute__((weak,
 	alias("__board_mmc_getcd")));
 
+#ifdef CONFIG_MMC_ASYNC_READ
+int mmc_bread_wait(struct mmc *mmc)
+{
+	struct mmc_cmd cmd;
+	int err;
+
+	if (!mmc->rd_pending)
+		return 0;
+	mmc->rd_pending = 0;
+
+	err = mmc->cfg->ops->wait_cmd(mmc, &mmc->rd_cmd, &mmc->rd_data);
+	if (!err && mmc->rd_data.blocks > 1) {
+		cmd.cmdidx = MMC_CMD_STOP_TRANSMISSION;
+		cmd.cmdarg = 0;
+		cmd.resp_type = MMC_RSP_R1b;
+		err = mmc_send_cmd(mmc, &cmd, NULL);
+	}
+
+	return err;
+}
+#endif
+
+#ifdef CONFIG_SYS_MMC_READAHEAD
+static int mmc_ra_wait(struct mmc *mmc)
+{
+	int err;
+
+	err = mmc_bread_wait(mmc);
+	if (err)
+		mmc->ra_blocks = 0;
+
+	return err;
+}
+
+/*
+ * Every command goes through here, so this is where an outstanding
+ * read-ahead gets completed before the bus is reused, and where the
+ * window is dropped when the card contents or addressing may change.
+ */
+static void mmc_ra_sync(struct mmc *mmc, struct mmc_cmd *cmd,
+			struct mmc_data *data)
+{
+	mmc_ra_wait(mmc);
+
+	if ((data && (data->flags & MMC_DATA_WRITE)) ||
+	    cmd->cmdidx == MMC_CMD_GO_IDLE_STATE ||
+	    cmd->cmdidx == MMC_CMD_SWITCH ||
+	    cmd->cmdidx == MMC_CMD_ERASE) {
+		mmc->ra_blocks = 0;
+		mmc->ra_next = 0;
+	}
+}
+#endif
+
 int mmc_send_cmd(struct mmc *mmc, struct mmc_cmd *cmd, struct mmc_data *data)
 {
 	int ret;
 
+#ifdef CONFIG_SYS_MMC_READAHEAD
+	mmc_ra_sync(mmc, cmd, data);
+#elif defined(CONFIG_MMC_ASYNC_READ)
+	mmc_bread_wait(mmc);
+#endif
+
 #ifdef CONFIG_MMC_TRACE
 	int i;
 	u8 *ptr;
@@ -158,6 +218,10 @@ int mmc_set_blocklen(struct mmc *mmc, int len)
 {
 	struct mmc_cmd cmd;
 
+	/* The block length is fixed at 512 bytes in DDR mode */
+	if (mmc->ddr_mode)
+		return 0;
+
 	cmd.cmdidx = MMC_CMD_SET_BLOCKLEN;
 	cmd.resp_type = MMC_RSP_R1;
 	cmd.cmdarg = len;
@@ -184,28 +248,35 @@ struct mmc *find_mmc_device(int dev_num)
 	return NULL;
 }
 
-static int mmc_read_blocks(struct mmc *mmc, void *dst, lbaint_t start,
-			   lbaint_t blkcnt)
+static void mmc_prepare_read(struct mmc *mmc, struct mmc_cmd *cmd,
+			     struct mmc_data *data, void *dst,
+			     lbaint_t start, lbaint_t blkcnt)
 {
-	struct mmc_cmd cmd;
-	struct mmc_data data;
-
 	if (blkcnt > 1)
-		cmd.cmdidx = MMC_CMD_READ_MULTIPLE_BLOCK;
+		cmd->cmdidx = MMC_CMD_READ_MULTIPLE_BLOCK;
 	else
-		cmd.cmdidx = MMC_CMD_READ_SINGLE_BLOCK;
+		cmd->cmdidx = MMC_CMD_READ_SINGLE_BLOCK;
 
 	if (mmc->high_capacity)
-		cmd.cmdarg = start;
+		cmd->cmdarg = start;
 	else
-		cmd.cmdarg = start * mmc->read_bl_len;
+		cmd->cmdarg = start * mmc->read_bl_len;
 
-	cmd.resp_type = MMC_RSP_R1;
+	cmd->resp_type = MMC_RSP_R1;
 
-	data.dest = dst;
-	data.blocks = blkcnt;
-	data.blocksize = mmc->read_bl_len;
-	data.flags = MMC_DATA_READ;
+	data->dest = dst;
+	data->blocks = blkcnt;
+	data->blocksize = mmc->read_bl_len;
+	data->flags = MMC_DATA_READ;
+}
+
+static int mmc_read_blocks(struct mmc *mmc, void *dst, lbaint_t start,
+			   lbaint_t blkcnt)
+{
+	struct mmc_cmd cmd;
+	struct mmc_data data;
+
+	mmc_prepare_read(mmc, &cmd, &data, dst, start, blkcnt);
 
 	if (mmc_send_cmd(mmc, &cmd, &data))
 		return 0;
@@ -225,9 +296,116 @@ static int mmc_read_blocks(struct mmc *mmc, void *dst, lbaint_t start,
 	return blkcnt;
 }
 
+#ifdef CONFIG_SYS_MMC_READAHEAD
+/*
+ * Sequential read-ahead. When a read continues where the previous one
+ * ended, the following CONFIG_SYS_MMC_READAHEAD blocks are started in the
+ * background into ra_buf, so they stream in while the caller processes
+ * what it just got. Filesystems reading a file piecewise then get most
+ * of their requests served without a command round trip.
+ */
+static lbaint_t mmc_ra_read(struct mmc *mmc, lbaint_t start, lbaint_t blkcnt,
+			    void *dst)
+{
+	lbaint_t cur;
+
+	if (start < mmc->ra_start ||
+	    start >= mmc->ra_start + mmc->ra_blocks)
+		return 0;
+
+	if (mmc_ra_wait(mmc))
+		return 0;
+
+	cur = min(blkcnt, mmc->ra_start + mmc->ra_blocks - start);
+	memcpy(dst, mmc->ra_buf + (start - mmc->ra_start) * mmc->read_bl_len,
+	       cur * mmc->read_bl_len);
+
+	return cur;
+}
+
+static void mmc_ra_start(struct mmc *mmc, lbaint_t start)
+{
+	lbaint_t blkcnt = CONFIG_SYS_MMC_READAHEAD;
+
+	/* still some window left, or nothing left to read ahead */
+	if (start < mmc->ra_start + mmc->ra_blocks ||
+	    start >= mmc->block_dev.lba)
+		return;
+
+	if (!mmc->ra_buf) {
+		mmc->ra_buf = memalign(ARCH_DMA_MINALIGN,
+				       CONFIG_SYS_MMC_READAHEAD *
+				       MMC_MAX_BLOCK_LEN);
+		if (!mmc->ra_buf)
+			return;
+	}
+
+	if (blkcnt > mmc->block_dev.lba - start)
+		blkcnt = mmc->block_dev.lba - start;
+	if (blkcnt > mmc->cfg->b_max)
+		blkcnt = mmc->cfg->b_max;
+
+	mmc_prepare_read(mmc, &mmc->rd_cmd, &mmc->rd_data, mmc->ra_buf,
+			 start, blkcnt);
+
+	mmc->ra_start = start;
+	mmc->ra_blocks = 0;
+	if (mmc->cfg->ops->start_cmd(mmc, &mmc->rd_cmd, &mmc->rd_data))
+		return;
+
+	mmc->ra_blocks = blkcnt;
+	mmc->rd_pending = 1;
+}
+#endif
+
+#ifdef CONFIG_MMC_ASYNC_READ
+int mmc_bread_start(struct mmc *mmc, lbaint_t start, lbaint_t blkcnt,
+		    void *dst)
+{
+	int err;
+
+	if (!blkcnt || blkcnt > mmc->cfg->b_max ||
+	    start + blkcnt > mmc->block_dev.lba)
+		return -1;
+
+	/*
+	 * Finish the read in flight first: mmc_set_blocklen() sends no
+	 * command in DDR mode, so nothing else would wait for it.
+	 */
+#ifdef CONFIG_SYS_MMC_READAHEAD
+	err = mmc_ra_wait(mmc);
+#else
+	err = mmc_bread_wait(mmc);
+#endif
+	if (err)
+		return err;
+
+	err = mmc_set_blocklen(mmc, mmc->read_bl_len);
+	if (err)
+		return err;
+
+	if (!mmc->cfg->ops->start_cmd)
+		return mmc_read_blocks(mmc, dst, start, blkcnt) == blkcnt ?
+			0 : -1;
+
+	mmc_prepare_read(mmc, &mmc->rd_cmd, &mmc->rd_data, dst, start,
+			 blkcnt);
+	err = mmc->cfg->ops->start_cmd(mmc, &mmc->rd_cmd, &mmc->rd_data);
+	if (err)
+		return err;
+
+	mmc->rd_pending = 1;
+
+	return 0;
+}
+#endif
+
 static ulong mmc_bread(int dev_num, lbaint_t start, lbaint_t blkcnt, void *dst)
 {
 	lbaint_t cur, blocks_todo = blkcnt;
+#ifdef CONFIG_SYS_MMC_READAHEAD
+	int sequential;
+#endif
 
 	if (blkcnt == 0)
 		return 0;
@@ -244,6 +422,18 @@ static ulong mmc_bread(int dev_num, lbaint_t start, lbaint_t blkcnt, void *dst)
 		return 0;
 	}
 
+#ifdef CONFIG_SYS_MMC_READAHEAD
+	sequential = mmc->ra_next && start == mmc->ra_next;
+	mmc->ra_next = start + blkcnt;
+
+	cur = mmc_ra_read(mmc, start, blkcnt, dst);
+	blocks_todo -= cur;
+	start += cur;
+	dst += cur * mmc->read_bl_len;
+	if (!blocks_todo)
+		goto done;
+#endif
+
 	if (mmc_set_blocklen(mmc, mmc->read_bl_len))
 		return 0;
 
@@ -257,6 +447,12 @@ static ulong mmc_bread(int dev_num, lbaint_t start, lbaint_t blkcnt, void *dst)
 		dst += cur * mmc->read_bl_len;
 	} while (blocks_todo > 0);
 
+#ifdef CONFIG_SYS_MMC_READAHEAD
+done:
+	if (sequential && mmc->cfg->ops->start_cmd)
+		mmc_ra_start(mmc, start);
+#endif
+
 	return blkcnt;
 }
 
@@ -514,10 +710,13 @@ static int mmc_change_freq(struct mmc *mmc)
 		return 0;
 
 	/* High Speed is set, there are two types: 52MHz and 26MHz */
-	if (cardtype & MMC_HS_52MHZ)
+	if (cardtype & MMC_HS_52MHZ) {
+		if (cardtype & EXT_CSD_CARD_TYPE_DDR_1_8V)
+			mmc->card_caps |= MMC_MODE_DDR_52MHz;
 		mmc->card_caps |= MMC_MODE_HS_52MHz | MMC_MODE_HS;
-	else
+	} else {
 		mmc->card_caps |= MMC_MODE_HS;
+	}
 
 	return 0;
 }
@@ -1054,6 +1253,8 @@ static int mmc_startup(struct mmc *mmc)
 
 		/* An array of possible bus widths in order of preference */
 		static unsigned ext_csd_bits[] = {
+			EXT_CSD_DDR_BUS_WIDTH_8,
+			EXT_CSD_DDR_BUS_WIDTH_4,
 			EXT_CSD_BUS_WIDTH_8,
 			EXT_CSD_BUS_WIDTH_4,
 			EXT_CSD_BUS_WIDTH_1,
@@ -1063,22 +1264,32 @@ static int mmc_startup(struct mmc *mmc)
 		static unsigned ext_to_hostcaps[] = {
 			[EXT_CSD_BUS_WIDTH_4] = MMC_MODE_4BIT,
 			[EXT_CSD_BUS_WIDTH_8] = MMC_MODE_8BIT,
+			[EXT_CSD_DDR_BUS_WIDTH_4] =
+				MMC_MODE_DDR_52MHz | MMC_MODE_4BIT,
+			[EXT_CSD_DDR_BUS_WIDTH_8] =
+				MMC_MODE_DDR_52MHz | MMC_MODE_8BIT,
 		};
 
 		/* An array to map chosen bus width to an integer */
 		static unsigned widths[] = {
-			8, 4, 1,
+			8, 4, 8, 4, 1,
 		};
 
 		for (idx=0; idx < ARRAY_SIZE(ext_csd_bits); idx++) {
 			unsigned int extw = ext_csd_bits[idx];
+			unsigned int caps = ext_to_hostcaps[extw];
 
 			/*
 			 * Check to make sure the controller supports
 			 * this bus width, if it's more than 1
 			 */
 			if (extw != EXT_CSD_BUS_WIDTH_1 &&
-					!(mmc->cfg->host_caps & ext_to_hostcaps[extw]))
+					(mmc->cfg->host_caps & caps) != caps)
+				continue;
+
+			/* DDR additionally needs a card that can do it */
+			if ((caps & MMC_MODE_DDR_52MHz) &&
+			    !(mmc->card_caps & MMC_MODE_DDR_52MHz))
 				continue;
 
 			err = mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL,
@@ -1087,6 +1298,7 @@ static int mmc_startup(struct mmc *mmc)
 			if (err)
 				continue;
 
+			mmc->ddr_mode = (caps & MMC_MODE_DDR_52MHz) ? 1 : 0;
 			mmc_set_bus_width(mmc, widths[idx]);
 
 			err = mmc_send_ext_csd(mmc, test_csd);
@@ -1101,7 +1313,7 @@ static int mmc_startup(struct mmc *mmc)
 				 && memcmp(&ext_csd[EXT_CSD_SEC_CNT], \
 					&test_csd[EXT_CSD_SEC_CNT], 4) == 0) {
 
-				mmc->card_caps |= ext_to_hostcaps[extw];
+				mmc->card_caps |= caps;
 				break;
 			}
 		}
@@ -1248,12 +1460,20 @@ int mmc_start_init(struct mmc *mmc)
 	if (mmc->has_init)
 		return 0;
 
+#ifdef CONFIG_SYS_MMC_READAHEAD
+	/* the host is about to be reset, finish with the old card */
+	mmc_ra_wait(mmc);
+	mmc->ra_blocks = 0;
+	mmc->ra_next = 0;
+#endif
+
 	/* made sure it's not NULL earlier */
 	err = mmc->cfg->ops->init(mmc);
 
 	if (err)
 		return err;
 
+	mmc->ddr_mode = 0;
 	mmc_set_bus_width(mmc, 1);
 	mmc_set_clock(mmc, 1);
 
@@ -16,6 +16,12 @@
 #include <asm/arch/cpu.h>
 #include <asm/arch/mmc.h>
 
+#ifdef CONFIG_MMC_SUNXI_DMA
+/* 128 descriptors of 8 KiB allow 1 MiB per transfer */
+#define SUNXI_MMC_DES_NUM	128
+#define SUNXI_MMC_DMA_BLK_MAX	(SUNXI_MMC_DES_NUM * SUNXI_MMC_DES_MAX_LEN / 512)
+#endif
+
 struct sunxi_mmc_host {
 	unsigned mmc_no;
 	uint32_t *mclkreg;
@@ -24,6 +30,11 @@ struct sunxi_mmc_host {
 	unsigned mod_clk;
 	struct sunxi_mmc *reg;
 	struct mmc_config cfg;
+	int use_dma;		/* current transfer is done by the IDMAC */
+#ifdef CONFIG_MMC_SUNXI_DMA
+	struct sunxi_mmc_des des[SUNXI_MMC_DES_NUM]
+		__aligned(ARCH_DMA_MINALIGN);
+#endif
 };
 
 /* support 4 mmc hosts */
@@ -67,10 +78,59 @@ static int mmc_resource_init(int sdc_no)
 	return 0;
 }
 
+static int mmc_set_mod_clk(struct sunxi_mmc_host *mmchost, unsigned int hz)
+{
+	unsigned int pll, pll_hz, div, n, oclk_dly, sclk_dly;
+
+	if (hz <= 24000000) {
+		pll = CCM_MMC_CTRL_OSCM24;
+		pll_hz = 24000000;
+	} else {
+		pll = CCM_MMC_CTRL_PLL6;
+		pll_hz = clock_get_pll6();
+	}
+
+	/* never go above the requested rate, so round the divider up */
+	div = DIV_ROUND_UP(pll_hz, hz);
+	n = 0;
+	while (div > 16) {
+		n++;
+		div = (div + 1) / 2;
+	}
+	if (n > 3) {
+		printf("mmc %u error cannot set clock to %u\n",
+		       mmchost->mmc_no, hz);
+		return -1;
+	}
+
+	/* output and sample clock delays for the various bus speeds */
+	if (hz <= 400000) {
+		oclk_dly = 0;
+		sclk_dly = 7;
+	} else if (hz <= 25000000) {
+		oclk_dly = 0;
+		sclk_dly = 5;
+	} else if (hz <= 50000000) {
+		oclk_dly = 3;
+		sclk_dly = 5;
+	} else {
+		oclk_dly = 2;
+		sclk_dly = 4;
+	}
+
+	writel(CCM_MMC_CTRL_ENABLE | pll | CCM_MMC_CTRL_SCLK_DLY(sclk_dly) |
+	       CCM_MMC_CTRL_N(n) | CCM_MMC_CTRL_OCLK_DLY(oclk_dly) |
+	       CCM_MMC_CTRL_M(div), mmchost->mclkreg);
+	mmchost->mod_clk = pll_hz / (1 << n) / div;
+
+	debug("mmc %u set mod-clk req %u parent %u n %u m %u rate %u\n",
+	      mmchost->mmc_no, hz, pll_hz, 1 << n, div, mmchost->mod_clk);
+
+	return 0;
+}
+
 static int mmc_clk_io_on(int sdc_no)
 {
-	unsigned int pll_clk;
-	unsigned int divider;
 	struct sunxi_mmc_host *mmchost = &mmc_host[sdc_no];
 	struct sunxi_ccm_reg *ccm = (struct sunxi_ccm_reg *)SUNXI_CCM_BASE;
 
@@ -84,15 +144,8 @@ static int mmc_clk_io_on(int sdc_no)
 	setbits_le32(&ccm->ahb_reset0_cfg, 1 << AHB_RESET_OFFSET_MMC(sdc_no));
 #endif
 
-	/* config mod clock */
-	pll_clk = clock_get_pll6();
-	/* should be close to 100 MHz but no more, so round up */
-	divider = ((pll_clk + 99999999) / 100000000) - 1;
-	writel(CCM_MMC_CTRL_ENABLE | CCM_MMC_CTRL_PLL6 | divider,
-	       mmchost->mclkreg);
-	mmchost->mod_clk = pll_clk / (divider + 1);
-
-	return 0;
+	/* config mod clock, set_ios adjusts it to the bus speed later */
+	return mmc_set_mod_clk(mmchost, 24000000);
 }
 
 static int mmc_update_clk(struct mmc *mmc)
@@ -117,10 +170,12 @@ static int mmc_update_clk(struct mmc *mmc)
 	return 0;
 }
 
-static int mmc_config_clock(struct mmc *mmc, unsigned div)
+static int mmc_config_clock(struct mmc *mmc)
 {
 	struct sunxi_mmc_host *mmchost = mmc->priv;
 	unsigned rval = readl(&mmchost->reg->clkcr);
+	unsigned int hz = mmc->clock;
+	unsigned div = 0;
 
 	/* Disable Clock */
 	rval &= ~SUNXI_MMC_CLK_ENABLE;
@@ -128,6 +183,19 @@ static int mmc_config_clock(struct mmc *mmc, unsigned div)
 	if (mmc_update_clk(mmc))
 		return -1;
 
+	/*
+	 * In 8 bit DDR mode the controller needs its module clock at twice
+	 * the card clock, with the internal divider halving it again.
+	 */
+	if (mmc->ddr_mode && mmc->bus_width == 8) {
+		hz *= 2;
+		div = 1;
+	}
+
+	/* Set mod_clk to the new rate, the card clock is derived from it */
+	if (mmc_set_mod_clk(mmchost, hz))
+		return -1;
+
 	/* Change Divider Factor */
 	rval &= ~SUNXI_MMC_CLK_DIVIDER_MASK;
 	rval |= div;
@@ -147,15 +215,13 @@ static int mmc_config_clock(struct mmc *mmc, unsigned div)
 static void mmc_set_ios(struct mmc *mmc)
 {
 	struct sunxi_mmc_host *mmchost = mmc->priv;
-	unsigned int clkdiv = 0;
 
-	debug("set ios: bus_width: %x, clock: %d, mod_clk: %d\n",
-	      mmc->bus_width, mmc->clock, mmchost->mod_clk);
+	debug("set ios: bus_width: %x, clock: %d, ddr: %d\n",
+	      mmc->bus_width, mmc->clock, mmc->ddr_mode);
 
 	/* Change clock first */
-	clkdiv = (mmchost->mod_clk + (mmc->clock >> 1)) / mmc->clock / 2;
 	if (mmc->clock) {
-		if (mmc_config_clock(mmc, clkdiv)) {
+		if (mmc_config_clock(mmc)) {
 			mmchost->fatal_err = 1;
 			return;
 		}
@@ -168,6 +234,12 @@ static void mmc_set_ios(struct mmc *mmc)
 		writel(0x1, &mmchost->reg->width);
 	else
 		writel(0x0, &mmchost->reg->width);
+
+	/* Sample data on both clock edges once the card is switched to DDR */
+	if (mmc->ddr_mode)
+		setbits_le32(&mmchost->reg->gctrl, SUNXI_MMC_GCTRL_DDR_MODE);
+	else
+		clrbits_le32(&mmchost->reg->gctrl, SUNXI_MMC_GCTRL_DDR_MODE);
 }
 
 static int mmc_core_init(struct mmc *mmc)
@@ -190,6 +262,7 @@ static int mmc_trans_data_by_cpu(struct mmc *mmc, struct mmc_data *data)
 	unsigned i;
 	unsigned byte_cnt = data->blocksize * data->blocks;
 	unsigned timeout_msecs = 2000;
+	unsigned long start = get_timer(0);
 	unsigned *buff = (unsigned int *)(reading ? data->dest : data->src);
 
 	/* Always read / write data through the CPU */
@@ -197,9 +270,8 @@ static int mmc_trans_data_by_cpu(struct mmc *mmc, struct mmc_data *data)
 
 	for (i = 0; i < (byte_cnt >> 2); i++) {
 		while (readl(&mmchost->reg->status) & status_bit) {
-			if (!timeout_msecs--)
+			if (get_timer(start) > timeout_msecs)
 				return -1;
-			udelay(1000);
 		}
 
 		if (reading)
@@ -211,34 +283,161 @@ static int mmc_trans_data_by_cpu(struct mmc *mmc, struct mmc_data *data)
 	return 0;
 }
 
+#ifdef CONFIG_MMC_SUNXI_DMA
+static int mmc_can_use_dma(struct mmc_data *data)
+{
+	unsigned long buff = (unsigned long)data->dest;
+	unsigned byte_cnt = data->blocksize * data->blocks;
+
+	/*
+	 * The buffer has to be cache line aligned, otherwise the cache
+	 * maintenance below would clobber data sharing its first or last
+	 * cache line. Such transfers go through the FIFO instead.
+	 */
+	if ((buff | byte_cnt) & (ARCH_DMA_MINALIGN - 1))
+		return 0;
+
+	return byte_cnt <= SUNXI_MMC_DES_NUM * SUNXI_MMC_DES_MAX_LEN;
+}
+
+static void mmc_trans_data_by_dma(struct mmc *mmc, struct mmc_data *data)
+{
+	struct sunxi_mmc_host *mmchost = mmc->priv;
+	struct sunxi_mmc_des *des = mmchost->des;
+	unsigned long buff = (unsigned long)data->dest;
+	unsigned byte_cnt = data->blocksize * data->blocks;
+	unsigned offset;
+	int i = 0;
+
+	for (offset = 0; offset < byte_cnt; offset += SUNXI_MMC_DES_MAX_LEN) {
+		des[i].config = SUNXI_MMC_DES_OWN | SUNXI_MMC_DES_CHAIN |
+				SUNXI_MMC_DES_DIC;
+		des[i].buf_size = min(byte_cnt - offset,
+				      (unsigned)SUNXI_MMC_DES_MAX_LEN);
+		des[i].buf_addr = buff + offset;
+		des[i].next_desc = (u32)&des[i + 1];
+		i++;
+	}
+	i--;
+
+	des[0].config |= SUNXI_MMC_DES_FIRST;
+	des[i].config &= ~SUNXI_MMC_DES_DIC;
+	des[i].config |= SUNXI_MMC_DES_LAST | SUNXI_MMC_DES_END_OF_RING;
+	des[i].next_desc = 0;
+	flush_dcache_range((unsigned long)des,
+			   ALIGN((unsigned long)&des[i + 1], ARCH_DMA_MINALIGN));
+
+	if (data->flags & MMC_DATA_READ)
+		invalidate_dcache_range(buff, buff + byte_cnt);
+	else
+		flush_dcache_range(buff, buff + byte_cnt);
+
+	/* Hand the FIFO over to the internal DMA controller */
+	clrbits_le32(&mmchost->reg->gctrl, SUNXI_MMC_GCTRL_ACCESS_BY_AHB);
+	setbits_le32(&mmchost->reg->gctrl, SUNXI_MMC_GCTRL_DMA_ENABLE |
+					   SUNXI_MMC_GCTRL_DMA_RESET);
+	writel(SUNXI_MMC_IDMAC_RESET, &mmchost->reg->dmac);
+	writel(0xffffffff, &mmchost->reg->idst);
+	writel(SUNXI_MMC_FTRGLEVEL_DMA, &mmchost->reg->ftrglevel);
+	writel((u32)des, &mmchost->reg->dlba);
+	writel(SUNXI_MMC_IDMAC_FIXBURST | SUNXI_MMC_IDMAC_ENABLE,
+	       &mmchost->reg->dmac);
+}
+
+static int mmc_dma_wait(struct mmc *mmc, struct mmc_data *data)
+{
+	struct sunxi_mmc_host *mmchost = mmc->priv;
+	const uint32_t done_bit = (data->flags & MMC_DATA_READ) ?
+				  SUNXI_MMC_IDST_RXIRQ : SUNXI_MMC_IDST_TXIRQ;
+	unsigned long buff = (unsigned long)data->dest;
+	unsigned byte_cnt = data->blocksize * data->blocks;
+	unsigned timeout_msecs = 2000;
+	unsigned long start = get_timer(0);
+	unsigned int status;
+
+	/* Data over only means the FIFO is drained, wait for the DMA too */
+	do {
+		status = readl(&mmchost->reg->idst);
+		if (get_timer(start) > timeout_msecs ||
+		    (status & SUNXI_MMC_IDST_ERROR)) {
+			debug("dma timeout %x\n", status);
+			return TIMEOUT;
+		}
+	} while (!(status & done_bit));
+
+	/* Drop any lines speculatively fetched while the DMA was running */
+	if (data->flags & MMC_DATA_READ)
+		invalidate_dcache_range(buff, buff + byte_cnt);
+
+	return 0;
+}
+
+static void mmc_dma_stop(struct mmc *mmc)
+{
+	struct sunxi_mmc_host *mmchost = mmc->priv;
+
+	writel(0, &mmchost->reg->dmac);
+	writel(0xffffffff, &mmchost->reg->idst);
+	clrbits_le32(&mmchost->reg->gctrl, SUNXI_MMC_GCTRL_DMA_ENABLE);
+	setbits_le32(&mmchost->reg->gctrl, SUNXI_MMC_GCTRL_DMA_RESET);
+}
+#endif
+
+/*
+ * Busy-poll without sleeping in between, the command turnaround is in
+ * the order of microseconds and a fixed delay here would dominate it.
+ */
 static int mmc_rint_wait(struct mmc *mmc, unsigned int timeout_msecs,
 			 unsigned int done_bit, const char *what)
 {
 	struct sunxi_mmc_host *mmchost = mmc->priv;
+	unsigned long start = get_timer(0);
 	unsigned int status;
 
 	do {
 		status = readl(&mmchost->reg->rint);
-		if (!timeout_msecs-- ||
+		if (get_timer(start) > timeout_msecs ||
 		    (status & SUNXI_MMC_RINT_INTERRUPT_ERROR_BIT)) {
 			debug("%s timeout %x\n", what,
 			      status & SUNXI_MMC_RINT_INTERRUPT_ERROR_BIT);
 			return TIMEOUT;
 		}
-		udelay(1000);
 	} while (!(status & done_bit));
 
 	return 0;
 }
 
-static int mmc_send_cmd(struct mmc *mmc, struct mmc_cmd *cmd,
-			struct mmc_data *data)
+static int mmc_finish_cmd(struct mmc *mmc, int error)
+{
+	struct sunxi_mmc_host *mmchost = mmc->priv;
+
+#ifdef CONFIG_MMC_SUNXI_DMA
+	if (mmchost->use_dma)
+		mmc_dma_stop(mmc);
+#endif
+	mmchost->use_dma = 0;
+	if (error < 0) {
+		writel(mmc->ddr_mode ? SUNXI_MMC_GCTRL_RESET |
+		       SUNXI_MMC_GCTRL_DDR_MODE : SUNXI_MMC_GCTRL_RESET,
+		       &mmchost->reg->gctrl);
+		mmc_update_clk(mmc);
+	}
+	writel(0xffffffff, &mmchost->reg->rint);
+	writel(readl(&mmchost->reg->gctrl) | SUNXI_MMC_GCTRL_FIFO_RESET,
+	       &mmchost->reg->gctrl);
+
+	return error;
+}
+
+/*
+ * Issue a command. With DMA this returns as soon as the transfer has
+ * been kicked off, mmc_wait_cmd() then collects the result.
+ */
+static int mmc_start_cmd(struct mmc *mmc, struct mmc_cmd *cmd,
+			 struct mmc_data *data)
 {
 	struct sunxi_mmc_host *mmchost = mmc->priv;
 	unsigned int cmdval = SUNXI_MMC_CMD_START;
-	unsigned int timeout_msecs;
-	int error = 0;
-	unsigned int status = 0;
 	unsigned int bytecnt = 0;
 
 	if (mmchost->fatal_err)
@@ -258,10 +457,8 @@ static int mmc_send_cmd(struct mmc *mmc, struct mmc_cmd *cmd,
 		cmdval |= SUNXI_MMC_CMD_CHK_RESPONSE_CRC;
 
 	if (data) {
-		if ((u32) data->dest & 0x3) {
-			error = -1;
-			goto out;
-		}
+		if ((u32) data->dest & 0x3)
+			return mmc_finish_cmd(mmc, -1);
 
 		cmdval |= SUNXI_MMC_CMD_DATA_EXPIRE|SUNXI_MMC_CMD_WAIT_PRE_OVER;
 		if (data->flags & MMC_DATA_WRITE)
@@ -289,22 +486,42 @@ static int mmc_send_cmd(struct mmc *mmc, struct mmc_cmd *cmd,
 
 		bytecnt = data->blocksize * data->blocks;
 		debug("trans data %d bytes\n", bytecnt);
+#ifdef CONFIG_MMC_SUNXI_DMA
+		mmchost->use_dma = mmc_can_use_dma(data);
+		if (mmchost->use_dma)
+			mmc_trans_data_by_dma(mmc, data);
+#endif
 		writel(cmdval | cmd->cmdidx, &mmchost->reg->cmd);
-		ret = mmc_trans_data_by_cpu(mmc, data);
-		if (ret) {
-			error = readl(&mmchost->reg->rint) & \
-				SUNXI_MMC_RINT_INTERRUPT_ERROR_BIT;
-			error = TIMEOUT;
-			goto out;
-		}
+		if (!mmchost->use_dma)
+			ret = mmc_trans_data_by_cpu(mmc, data);
+		if (ret)
+			return mmc_finish_cmd(mmc, TIMEOUT);
 	}
 
+	return 0;
+}
+
+static int mmc_wait_cmd(struct mmc *mmc, struct mmc_cmd *cmd,
+			struct mmc_data *data)
+{
+	struct sunxi_mmc_host *mmchost = mmc->priv;
+	unsigned int timeout_msecs;
+	unsigned long start;
+	int error = 0;
+	unsigned int status = 0;
+
+	if (cmd->cmdidx == 12)
+		return 0;
+
 	error = mmc_rint_wait(mmc, 0xfffff, SUNXI_MMC_RINT_COMMAND_DONE, "cmd");
 	if (error)
 		goto out;
 
 	if (data) {
 		timeout_msecs = 120;
+		/* with DMA the whole transfer happens while we wait here */
+		if (mmchost->use_dma)
+			timeout_msecs += (data->blocksize * data->blocks) >> 10;
 		debug("cacl timeout %x msec\n", timeout_msecs);
 		error = mmc_rint_wait(mmc, timeout_msecs,
 				      data->blocks > 1 ?
@@ -313,18 +530,25 @@ static int mmc_send_cmd(struct mmc *mmc, struct mmc_cmd *cmd,
 				      "data");
 		if (error)
 			goto out;
+#ifdef CONFIG_MMC_SUNXI_DMA
+		if (mmchost->use_dma) {
+			error = mmc_dma_wait(mmc, data);
+			if (error)
+				goto out;
+		}
+#endif
 	}
 
 	if (cmd->resp_type & MMC_RSP_BUSY) {
 		timeout_msecs = 2000;
+		start = get_timer(0);
 		do {
 			status = readl(&mmchost->reg->status);
-			if (!timeout_msecs--) {
+			if (get_timer(start) > timeout_msecs) {
 				debug("busy timeout\n");
 				error = TIMEOUT;
 				goto out;
 			}
-			udelay(1000);
 		} while (status & SUNXI_MMC_STATUS_CARD_DATA_BUSY);
 	}
 
@@ -341,19 +565,25 @@ static int mmc_send_cmd(struct mmc *mmc, struct mmc_cmd *cmd,
 		debug("mmc resp 0x%08x\n", cmd->response[0]);
 	}
 out:
-	if (error < 0) {
-		writel(SUNXI_MMC_GCTRL_RESET, &mmchost->reg->gctrl);
-		mmc_update_clk(mmc);
-	}
-	writel(0xffffffff, &mmchost->reg->rint);
-	writel(readl(&mmchost->reg->gctrl) | SUNXI_MMC_GCTRL_FIFO_RESET,
-	       &mmchost->reg->gctrl);
+	return mmc_finish_cmd(mmc, error);
+}
 
-	return error;
+static int mmc_send_cmd(struct mmc *mmc, struct mmc_cmd *cmd,
+			struct mmc_data *data)
+{
+	int error;
+
+	error = mmc_start_cmd(mmc, cmd, data);
+	if (error)
+		return error;
+
+	return mmc_wait_cmd(mmc, cmd, data);
 }
 
 static const struct mmc_ops sunxi_mmc_ops = {
 	.send_cmd	= mmc_send_cmd,
+	.start_cmd	= mmc_start_cmd,
+	.wait_cmd	= mmc_wait_cmd,
 	.set_ios	= mmc_set_ios,
 	.init		= mmc_core_init,
 };
@@ -369,8 +599,17 @@ int sunxi_mmc_init(int sdc_no)
 
 	cfg->voltages = MMC_VDD_32_33 | MMC_VDD_33_34;
 	cfg->host_caps = MMC_MODE_4BIT;
-	cfg->host_caps |= MMC_MODE_HS_52MHz | MMC_MODE_HS;
+#ifdef CONFIG_MMC_SUNXI_SLOT2_8BIT
+	if (sdc_no == 2)
+		cfg->host_caps |= MMC_MODE_8BIT;
+#endif
+	cfg->host_caps |= MMC_MODE_HS_52MHz | MMC_MODE_HS | MMC_MODE_DDR_52MHz;
 	cfg->b_max = CONFIG_SYS_MMC_MAX_BLK_COUNT;
+#ifdef CONFIG_MMC_SUNXI_DMA
+	/* keep multi-block transfers within one descriptor chain */
+	if (cfg->b_max > SUNXI_MMC_DMA_BLK_MAX)
+		cfg->b_max = SUNXI_MMC_DMA_BLK_MAX;
+#endif
 
 	cfg->f_min = 400000;
 	cfg->f_max = 52000000;
@@ -0,0 +1,545 @@
+/*
+ * Allwinner A10/A13/A20 NAND flash controller driver
+ *
+ * Pages are moved by the dedicated DMA engine through the controller's
+ * page operation, which runs the hardware BCH engine (and optionally the
+ * data randomizer) on the fly. Commands, addresses and raw data go
+ * through the controller's internal RAM.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <malloc.h>
+#include <nand.h>
+#include <asm/io.h>
+#include <asm/errno.h>
+#include <asm/unaligned.h>
+#include <asm/arch/cpu.h>
+#include <asm/arch/dma.h>
+#include <asm/arch/nand.h>
+
+#define SUNXI_NFC_TIMEOUT	1000	/* ms */
+
+struct sunxi_nand {
+	struct nand_chip chip;
+	struct sunxi_nfc *regs;
+	int ecc_mode;
+	int page;			/* page being programmed */
+	int randomize;
+	int seed_mod;			/* pages sharing no seed */
+	u16 seeds[SUNXI_NAND_RND_MAX_PAGES];
+	u16 oob_seeds[SUNXI_NAND_RND_MAX_PAGES];
+	u8 *bounce;			/* DMA buffer for unaligned pages */
+	struct nand_ecclayout layout;
+};
+
+static struct sunxi_nand sunxi_nand;
+
+static int sunxi_nfc_wait_fifo(struct sunxi_nfc *regs)
+{
+	ulong start = get_timer(0);
+
+	while (readl(&regs->st) & SUNXI_NFC_ST_CMD_FIFO_STATUS) {
+		if (get_timer(start) > SUNXI_NFC_TIMEOUT) {
+			printf("NAND: command FIFO timeout\n");
+			return -ETIMEDOUT;
+		}
+	}
+
+	return 0;
+}
+
+static int sunxi_nfc_wait_cmd(struct sunxi_nfc *regs)
+{
+	ulong start = get_timer(0);
+
+	while (!(readl(&regs->st) & SUNXI_NFC_ST_CMD_INT_FLAG)) {
+		if (get_timer(start) > SUNXI_NFC_TIMEOUT) {
+			printf("NAND: command timeout\n");
+			return -ETIMEDOUT;
+		}
+	}
+	writel(SUNXI_NFC_ST_CMD_INT_FLAG, &regs->st);
+
+	return 0;
+}
+
+static int sunxi_nfc_run(struct sunxi_nfc *regs, u32 cmd)
+{
+	int ret;
+
+	ret = sunxi_nfc_wait_fifo(regs);
+	if (ret)
+		return ret;
+
+	writel(SUNXI_NFC_ST_CMD_INT_FLAG, &regs->st);
+	writel(cmd, &regs->cmd);
+
+	return sunxi_nfc_wait_cmd(regs);
+}
+
+static void sunxi_nand_cmd_ctrl(struct mtd_info *mtd, int dat,
+				unsigned int ctrl)
+{
+	struct nand_chip *chip = mtd->priv;
+	struct sunxi_nand *nfc = chip->priv;
+
+	if (dat == NAND_CMD_NONE)
+		return;
+
+	if (ctrl & NAND_CLE) {
+		sunxi_nfc_run(nfc->regs, SUNXI_NFC_CMD_SEND_CMD1 | dat);
+	} else if (ctrl & NAND_ALE) {
+		writel(dat, &nfc->regs->addr_low);
+		sunxi_nfc_run(nfc->regs, SUNXI_NFC_CMD_SEND_ADR |
+			      SUNXI_NFC_CMD_ADR_NUM(1));
+	}
+}
+
+static int sunxi_nand_dev_ready(struct mtd_info *mtd)
+{
+	struct nand_chip *chip = mtd->priv;
+	struct sunxi_nand *nfc = chip->priv;
+
+	return !!(readl(&nfc->regs->st) & SUNXI_NFC_ST_RB_STATE(0));
+}
+
+static void sunxi_nand_select_chip(struct mtd_info *mtd, int cs)
+{
+	struct nand_chip *chip = mtd->priv;
+	struct sunxi_nand *nfc = chip->priv;
+
+	if (cs < 0)
+		return;
+
+	clrsetbits_le32(&nfc->regs->ctl, SUNXI_NFC_CTL_CE_SEL_MASK |
+			SUNXI_NFC_CTL_RB_SEL_MASK,
+			SUNXI_NFC_CTL_CE_SEL(cs) | SUNXI_NFC_CTL_RB_SEL(cs & 1));
+}
+
+static void sunxi_nand_read_buf(struct mtd_info *mtd, uint8_t *buf, int len)
+{
+	struct nand_chip *chip = mtd->priv;
+	struct sunxi_nand *nfc = chip->priv;
+	int cnt;
+
+	while (len > 0) {
+		cnt = min(len, SUNXI_NFC_RAM_SIZE);
+
+		if (sunxi_nfc_wait_fifo(nfc->regs))
+			return;
+		writel(cnt, &nfc->regs->cnt);
+		if (sunxi_nfc_run(nfc->regs, SUNXI_NFC_CMD_DATA_TRANS |
+				  SUNXI_NFC_CMD_DATA_SWAP_METHOD))
+			return;
+
+		memcpy(buf, nfc->regs->ram0, cnt);
+		buf += cnt;
+		len -= cnt;
+	}
+}
+
+static void sunxi_nand_write_buf(struct mtd_info *mtd, const uint8_t *buf,
+				 int len)
+{
+	struct nand_chip *chip = mtd->priv;
+	struct sunxi_nand *nfc = chip->priv;
+	int cnt;
+
+	while (len > 0) {
+		cnt = min(len, SUNXI_NFC_RAM_SIZE);
+
+		if (sunxi_nfc_wait_fifo(nfc->regs))
+			return;
+		memcpy(nfc->regs->ram0, buf, cnt);
+		writel(cnt, &nfc->regs->cnt);
+		if (sunxi_nfc_run(nfc->regs, SUNXI_NFC_CMD_DATA_TRANS |
+				  SUNXI_NFC_CMD_DATA_SWAP_METHOD |
+				  SUNXI_NFC_CMD_ACCESS_DIR))
+			return;
+
+		buf += cnt;
+		len -= cnt;
+	}
+}
+
+static uint8_t sunxi_nand_read_byte(struct mtd_info *mtd)
+{
+	uint8_t ret = 0xff;
+
+	sunxi_nand_read_buf(mtd, &ret, 1);
+
+	return ret;
+}
+
+/*
+ * The randomizer also scrambles the user data of the first step, which
+ * holds the bad block marker. Pre-scramble the marker with the same key
+ * stream so that it ends up unmodified on the flash, and undo that on
+ * read.
+ */
+static void sunxi_nand_randomize_bbm(struct sunxi_nand *nfc, int page,
+				     u8 *oob)
+{
+	u16 state = nfc->oob_seeds[page % nfc->seed_mod];
+
+	oob[0] ^= state;
+	oob[1] ^= sunxi_nand_rnd_step(state, 8);
+}
+
+static void sunxi_nand_ecc_enable(struct sunxi_nand *nfc, int page)
+{
+	u32 ecc_ctl;
+
+	ecc_ctl = readl(&nfc->regs->ecc_ctl);
+	ecc_ctl &= ~(SUNXI_NFC_ECC_MODE_MASK | SUNXI_NFC_ECC_BLOCK_512 |
+		     SUNXI_NFC_ECC_RANDOM_EN | SUNXI_NFC_ECC_RANDOM_DIRECTION |
+		     SUNXI_NFC_ECC_RANDOM_SEED_MASK);
+	ecc_ctl |= SUNXI_NFC_ECC_EN | SUNXI_NFC_ECC_PIPELINE |
+		   SUNXI_NFC_ECC_EXCEPTION | SUNXI_NFC_ECC_MODE(nfc->ecc_mode);
+
+	if (nfc->randomize)
+		ecc_ctl |= SUNXI_NFC_ECC_RANDOM_EN |
+			   SUNXI_NFC_ECC_RANDOM_SEED(
+				nfc->seeds[page % nfc->seed_mod]);
+
+	writel(ecc_ctl, &nfc->regs->ecc_ctl);
+}
+
+static void sunxi_nand_ecc_disable(struct sunxi_nand *nfc)
+{
+	clrbits_le32(&nfc->regs->ecc_ctl,
+		     SUNXI_NFC_ECC_EN | SUNXI_NFC_ECC_RANDOM_EN);
+}
+
+/*
+ * Move one page between memory and the flash page buffer, all ECC steps
+ * in a single page operation. The page (or the program sequence) must
+ * already have been opened by the caller.
+ */
+static int sunxi_nand_dma_page(struct mtd_info *mtd, u8 *buf, int write,
+			       int page)
+{
+	struct nand_chip *chip = mtd->priv;
+	struct sunxi_nand *nfc = chip->priv;
+	struct sunxi_nfc *regs = nfc->regs;
+	unsigned long start = (unsigned long)buf;
+	unsigned long end = start + mtd->writesize;
+	u32 cfg, para, cmd;
+	int ret, dma_ret;
+
+	ret = sunxi_nfc_wait_fifo(regs);
+	if (ret)
+		return ret;
+
+	setbits_le32(&regs->ctl, SUNXI_NFC_CTL_RAM_METHOD);
+	writel(chip->ecc.steps, &regs->sector_num);
+	writel(chip->ecc.size, &regs->cnt);
+	writel(mtd->writesize, &regs->spare_area);
+	sunxi_nand_ecc_enable(nfc, page);
+
+	if (write) {
+		flush_dcache_range(start, end);
+
+		cfg = SUNXI_DMA_CFG_SRC_DRQ(SUNXI_DDMA_DRQ_SDRAM) |
+		      SUNXI_DMA_CFG_SRC_WIDTH_32 |
+		      SUNXI_DMA_CFG_DST_DRQ(SUNXI_DDMA_DRQ_NAND) |
+		      SUNXI_DMA_CFG_DST_ADDR_IO | SUNXI_DMA_CFG_DST_WIDTH_32;
+		para = SUNXI_DDMA_PARA_DST_WAIT(0x0f) |
+		       SUNXI_DDMA_PARA_DST_BLK(0x7f);
+		sunxi_ddma_start(SUNXI_DDMA_CH_NAND, cfg, para, start,
+				 (u32)&regs->io_data, mtd->writesize);
+
+		writel(SUNXI_NFC_WCMD(NAND_CMD_PAGEPROG, NAND_CMD_RNDIN),
+		       &regs->wcmd_set);
+		cmd = SUNXI_NFC_CMD_ACCESS_DIR | SUNXI_NFC_CMD_ECC_OP;
+	} else {
+		invalidate_dcache_range(start, end);
+
+		cfg = SUNXI_DMA_CFG_SRC_DRQ(SUNXI_DDMA_DRQ_NAND) |
+		      SUNXI_DMA_CFG_SRC_ADDR_IO | SUNXI_DMA_CFG_SRC_WIDTH_32 |
+		      SUNXI_DMA_CFG_DST_DRQ(SUNXI_DDMA_DRQ_SDRAM) |
+		      SUNXI_DMA_CFG_DST_WIDTH_32;
+		para = SUNXI_DDMA_PARA_SRC_WAIT(0x0f) |
+		       SUNXI_DDMA_PARA_SRC_BLK(0x7f);
+		sunxi_ddma_start(SUNXI_DDMA_CH_NAND, cfg, para,
+				 (u32)&regs->io_data, start, mtd->writesize);
+
+		writel(SUNXI_NFC_RCMD(NAND_CMD_READSTART, NAND_CMD_RNDOUT,
+				      NAND_CMD_RNDOUTSTART), &regs->rcmd_set);
+		cmd = 0;
+	}
+
+	writel(SUNXI_NFC_ST_CMD_INT_FLAG, &regs->st);
+	writel(cmd | SUNXI_NFC_CMD_PAGE_OP | SUNXI_NFC_CMD_DATA_TRANS |
+	       SUNXI_NFC_CMD_DATA_SWAP_METHOD, &regs->cmd);
+
+	ret = sunxi_nfc_wait_cmd(regs);
+	dma_ret = sunxi_ddma_wait(SUNXI_DDMA_CH_NAND, SUNXI_NFC_TIMEOUT);
+
+	if (!write)
+		invalidate_dcache_range(start, end);
+
+	sunxi_nand_ecc_disable(nfc);
+	clrbits_le32(&regs->ctl, SUNXI_NFC_CTL_RAM_METHOD);
+
+	return ret ? ret : dma_ret;
+}
+
+static u8 *sunxi_nand_dma_buf(struct sunxi_nand *nfc, const u8 *buf)
+{
+	if ((unsigned long)buf & (ARCH_DMA_MINALIGN - 1))
+		return nfc->bounce;
+
+	return (u8 *)buf;
+}
+
+static int sunxi_nand_read_page(struct mtd_info *mtd, struct nand_chip *chip,
+				uint8_t *buf, int oob_required, int page)
+{
+	struct sunxi_nand *nfc = chip->priv;
+	struct sunxi_nfc *regs = nfc->regs;
+	u8 *dma_buf = sunxi_nand_dma_buf(nfc, buf);
+	u32 user_data[SUNXI_NAND_MAX_STEPS];
+	unsigned int max_bitflips = 0;
+	u32 status;
+	int i, cnt, ret;
+
+	ret = sunxi_nand_dma_page(mtd, dma_buf, 0, page);
+	if (ret)
+		return -EIO;
+
+	status = readl(&regs->ecc_st);
+	for (i = 0; i < chip->ecc.steps; i++) {
+		/* erased step, the engine does not correct those */
+		if (status & SUNXI_NFC_ECC_PAT_FOUND(i)) {
+			memset(dma_buf + i * chip->ecc.size, 0xff,
+			       chip->ecc.size);
+			user_data[i] = 0xffffffff;
+			continue;
+		}
+
+		user_data[i] = readl(&regs->user_data[i]);
+
+		if (status & SUNXI_NFC_ECC_ERR(i)) {
+			mtd->ecc_stats.failed++;
+			continue;
+		}
+
+		cnt = SUNXI_NFC_ECC_ERR_CNT(regs, i);
+		mtd->ecc_stats.corrected += cnt;
+		max_bitflips = max_t(unsigned int, max_bitflips, cnt);
+	}
+
+	if (dma_buf != buf)
+		memcpy(buf, dma_buf, mtd->writesize);
+
+	if (oob_required) {
+		chip->cmdfunc(mtd, NAND_CMD_RNDOUT, mtd->writesize, -1);
+		chip->read_buf(mtd, chip->oob_poi, mtd->oobsize);
+	} else {
+		memset(chip->oob_poi, 0xff, mtd->oobsize);
+	}
+
+	/* the user data comes back corrected and de-randomized */
+	for (i = 0; i < chip->ecc.steps; i++) {
+		u8 *oob = chip->oob_poi + i * (chip->ecc.bytes +
+					       SUNXI_NAND_USER_DATA_LEN);
+
+		put_unaligned_le32(user_data[i], oob);
+		if (!i && nfc->randomize &&
+		    !(status & SUNXI_NFC_ECC_PAT_FOUND(0)))
+			sunxi_nand_randomize_bbm(nfc, page, oob);
+	}
+
+	return max_bitflips;
+}
+
+static int sunxi_nand_write_page(struct mtd_info *mtd, struct nand_chip *chip,
+				 const uint8_t *buf, int oob_required)
+{
+	struct sunxi_nand *nfc = chip->priv;
+	u8 *dma_buf = sunxi_nand_dma_buf(nfc, buf);
+	u8 user_data[SUNXI_NAND_USER_DATA_LEN];
+	int i;
+
+	for (i = 0; i < chip->ecc.steps; i++) {
+		memcpy(user_data, chip->oob_poi + i * (chip->ecc.bytes +
+		       SUNXI_NAND_USER_DATA_LEN), sizeof(user_data));
+		if (!i && nfc->randomize)
+			sunxi_nand_randomize_bbm(nfc, nfc->page, user_data);
+
+		writel(get_unaligned_le32(user_data),
+		       &nfc->regs->user_data[i]);
+	}
+
+	if (dma_buf != buf)
+		memcpy(dma_buf, buf, mtd->writesize);
+
+	return sunxi_nand_dma_page(mtd, dma_buf, 1, nfc->page) ? -EIO : 0;
+}
+
+/*
+ * Same as the generic page program sequence, but the ECC write_page
+ * hook does not get the page number, which the randomizer needs.
+ */
+static int sunxi_nand_program_page(struct mtd_info *mtd,
+				   struct nand_chip *chip, const uint8_t *buf,
+				   int oob_required, int page, int cached,
+				   int raw)
+{
+	struct sunxi_nand *nfc = chip->priv;
+	int status;
+
+	nfc->page = page;
+
+	chip->cmdfunc(mtd, NAND_CMD_SEQIN, 0x00, page);
+
+	if (unlikely(raw))
+		status = chip->ecc.write_page_raw(mtd, chip, buf, oob_required);
+	else
+		status = chip->ecc.write_page(mtd, chip, buf, oob_required);
+
+	if (status < 0)
+		return status;
+
+	chip->cmdfunc(mtd, NAND_CMD_PAGEPROG, -1, -1);
+	status = chip->waitfunc(mtd, chip);
+	if (status & NAND_STATUS_FAIL)
+		return -EIO;
+
+	return 0;
+}
+
+static void sunxi_nand_init_layout(struct sunxi_nand *nfc, int steps)
+{
+	struct nand_ecclayout *layout = &nfc->layout;
+	int bytes = nfc->chip.ecc.bytes;
+	int i, j, n = 0;
+
+	/* [user data][ECC] per step, the first two bytes are the BBM */
+	for (i = 0; i < steps; i++) {
+		int offs = i * (bytes + SUNXI_NAND_USER_DATA_LEN);
+
+		layout->oobfree[i].offset = offs + (i ? 0 : 2);
+		layout->oobfree[i].length = SUNXI_NAND_USER_DATA_LEN -
+					    (i ? 0 : 2);
+
+		offs += SUNXI_NAND_USER_DATA_LEN;
+		for (j = 0; j < bytes && n < MTD_MAX_ECCPOS_ENTRIES_LARGE; j++)
+			layout->eccpos[n++] = offs + j;
+	}
+	layout->eccbytes = n;
+}
+
+static int sunxi_nand_chip_init(struct sunxi_nand *nfc, struct mtd_info *mtd)
+{
+	struct nand_chip *chip = &nfc->chip;
+	int i, pages_per_block;
+
+	if (nand_scan_ident(mtd, 1, NULL))
+		return -ENODEV;
+
+	if (mtd->writesize > NAND_MAX_PAGESIZE ||
+	    mtd->oobsize > NAND_MAX_OOBSIZE) {
+		printf("NAND: %u+%u byte pages are too large\n",
+		       mtd->writesize, mtd->oobsize);
+		return -EINVAL;
+	}
+
+	if (chip->options & NAND_BUSWIDTH_16)
+		setbits_le32(&nfc->regs->ctl, SUNXI_NFC_CTL_BUS_WIDTH_16);
+	clrsetbits_le32(&nfc->regs->ctl, SUNXI_NFC_CTL_PAGE_SHIFT_MASK,
+			SUNXI_NFC_CTL_PAGE_SHIFT(chip->page_shift));
+
+	nfc->ecc_mode = sunxi_nand_ecc_mode(mtd->writesize, mtd->oobsize);
+	if (nfc->ecc_mode < 0) {
+		printf("NAND: no ECC mode fits %u+%u byte pages\n",
+		       mtd->writesize, mtd->oobsize);
+		return -EINVAL;
+	}
+
+	chip->ecc.mode = NAND_ECC_HW;
+	chip->ecc.size = SUNXI_NAND_ECC_STEP;
+	chip->ecc.strength = sunxi_nand_ecc_strength(nfc->ecc_mode);
+	chip->ecc.bytes = sunxi_nand_ecc_bytes(chip->ecc.strength);
+	chip->ecc.read_page = sunxi_nand_read_page;
+	chip->ecc.write_page = sunxi_nand_write_page;
+	sunxi_nand_init_layout(nfc, mtd->writesize / SUNXI_NAND_ECC_STEP);
+	chip->ecc.layout = &nfc->layout;
+
+#ifdef CONFIG_NAND_SUNXI_RANDOMIZE
+	nfc->randomize = 1;
+#endif
+	pages_per_block = mtd->erasesize / mtd->writesize;
+	nfc->seed_mod = min(pages_per_block, SUNXI_NAND_RND_MAX_PAGES);
+	for (i = 0; nfc->randomize && i < nfc->seed_mod; i++) {
+		nfc->seeds[i] = sunxi_nand_rnd_seed(i, pages_per_block);
+		/*
+		 * The user data is scrambled with the LFSR as the engine
+		 * leaves it after the first step of data: its bits and 15
+		 * more. This is how Linux derives its ECC seed tables.
+		 */
+		nfc->oob_seeds[i] = sunxi_nand_rnd_step(nfc->seeds[i],
+						SUNXI_NAND_ECC_STEP * 8 + 15);
+	}
+
+	nfc->bounce = memalign(ARCH_DMA_MINALIGN, mtd->writesize);
+	if (!nfc->bounce)
+		return -ENOMEM;
+
+	if (nand_scan_tail(mtd))
+		return -ENODEV;
+
+	debug("NAND: %u byte pages, BCH-%d per %d bytes%s\n", mtd->writesize,
+	      chip->ecc.strength, chip->ecc.size,
+	      nfc->randomize ? ", randomized" : "");
+
+	return 0;
+}
+
+void board_nand_init(void)
+{
+	struct sunxi_nand *nfc = &sunxi_nand;
+	struct mtd_info *mtd = &nand_info[0];
+	struct nand_chip *chip = &nfc->chip;
+	struct sunxi_nfc *regs = (struct sunxi_nfc *)SUNXI_NFC_BASE;
+	ulong start;
+
+	sunxi_nand_board_init();
+	sunxi_dma_init();
+
+	/* Enable and reset the controller */
+	nfc->regs = regs;
+	writel(SUNXI_NFC_CTL_EN | SUNXI_NFC_CTL_RESET, &regs->ctl);
+	start = get_timer(0);
+	while (readl(&regs->ctl) & SUNXI_NFC_CTL_RESET) {
+		if (get_timer(start) > SUNXI_NFC_TIMEOUT) {
+			printf("NAND: controller reset timeout\n");
+			return;
+		}
+	}
+	writel(0, &regs->intr);
+	/* slowest timings, good for any chip */
+	writel(0, &regs->timing_ctl);
+	writel(0xff, &regs->timing_cfg);
+
+	mtd->priv = chip;
+	chip->priv = nfc;
+	chip->IO_ADDR_R = chip->IO_ADDR_W = regs;
+	chip->cmd_ctrl = sunxi_nand_cmd_ctrl;
+	chip->dev_ready = sunxi_nand_dev_ready;
+	chip->select_chip = sunxi_nand_select_chip;
+	chip->read_byte = sunxi_nand_read_byte;
+	chip->read_buf = sunxi_nand_read_buf;
+	chip->write_buf = sunxi_nand_write_buf;
+	chip->write_page = sunxi_nand_program_page;
+	chip->options |= NAND_NO_SUBPAGE_WRITE;
+	chip->chip_delay = 30;
+
+	if (sunxi_nand_chip_init(nfc, mtd))
+		return;
+
+	nand_register(0);
+}
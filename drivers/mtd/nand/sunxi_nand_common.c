@@ -0,0 +1,86 @@
+/*
+ * ECC and randomizer parameters of the Allwinner A10/A13/A20 NAND
+ * controller, shared by the driver and the SPL loader
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <asm/arch/nand.h>
+
+static const u8 sunxi_nand_ecc_strengths[] = {
+	16, 24, 28, 32, 40, 48, 56, 60, 64
+};
+
+/*
+ * Randomizer seeds of the pages of a block, as used by the boot ROM, the
+ * vendor tools and Linux. Page n of the flash uses entry n modulo the
+ * number of pages per block, or modulo 128 for larger blocks.
+ */
+static const u16 sunxi_nand_rnd_page_seeds[SUNXI_NAND_RND_MAX_PAGES] = {
+	0x2b75, 0x0bd0, 0x5ca3, 0x62d1, 0x1c93, 0x07e9, 0x2162, 0x3a72,
+	0x0d67, 0x67f9, 0x1be7, 0x077d, 0x032f, 0x0dac, 0x2716, 0x2436,
+	0x7922, 0x1510, 0x3860, 0x5287, 0x480f, 0x4252, 0x1789, 0x5a2d,
+	0x2a49, 0x5e10, 0x437f, 0x4b4e, 0x2f45, 0x216e, 0x5cb7, 0x7130,
+	0x2a3f, 0x60e4, 0x4dc9, 0x0ef0, 0x0f52, 0x1bb9, 0x6211, 0x7a56,
+	0x226d, 0x4ea7, 0x6f36, 0x3692, 0x38bf, 0x0c62, 0x05eb, 0x4c55,
+	0x60f4, 0x728c, 0x3b6f, 0x2037, 0x7f69, 0x0936, 0x651a, 0x4ceb,
+	0x6218, 0x79f3, 0x383f, 0x18d9, 0x4f05, 0x5c82, 0x2912, 0x6f17,
+	0x6856, 0x5938, 0x1007, 0x61ab, 0x3e7f, 0x57c2, 0x542f, 0x4f62,
+	0x7454, 0x2eac, 0x7739, 0x42d4, 0x2f90, 0x435a, 0x2e52, 0x2064,
+	0x637c, 0x66ad, 0x2c90, 0x0bad, 0x759c, 0x0029, 0x0986, 0x7126,
+	0x1ca7, 0x1605, 0x386a, 0x27f5, 0x1380, 0x6d75, 0x24c3, 0x0f8e,
+	0x2b7a, 0x1418, 0x1fd1, 0x7dc1, 0x2d8e, 0x43af, 0x2267, 0x7da3,
+	0x4e3d, 0x1338, 0x50db, 0x454d, 0x764d, 0x40a3, 0x42e6, 0x262b,
+	0x2d2e, 0x1aea, 0x2e17, 0x173d, 0x3a6e, 0x71bf, 0x25f9, 0x0a5d,
+	0x7c57, 0x0fbe, 0x46ce, 0x4939, 0x6b17, 0x37bb, 0x3e91, 0x76db,
+};
+
+/* The correctable bits per step of an ECC mode */
+int sunxi_nand_ecc_strength(int mode)
+{
+	return sunxi_nand_ecc_strengths[mode];
+}
+
+/*
+ * Pick the strongest ECC mode whose parity and user data fit in the
+ * spare area. Returns the mode (index into sunxi_nand_ecc_strengths[])
+ * or -1 if even the weakest one does not fit.
+ */
+int sunxi_nand_ecc_mode(int page_size, int oob_size)
+{
+	int steps = page_size / SUNXI_NAND_ECC_STEP;
+	int avail, mode;
+
+	if (!steps || steps > SUNXI_NAND_MAX_STEPS)
+		return -1;
+
+	avail = oob_size / steps - SUNXI_NAND_USER_DATA_LEN;
+	for (mode = ARRAY_SIZE(sunxi_nand_ecc_strengths) - 1; mode >= 0;
+	     mode--) {
+		if (sunxi_nand_ecc_bytes(sunxi_nand_ecc_strengths[mode]) <=
+		    avail)
+			break;
+	}
+
+	return mode;
+}
+
+/* Advance the 15 bit randomizer LFSR (x^15 + x^14 + 1) by count bits */
+u16 sunxi_nand_rnd_step(u16 state, int count)
+{
+	state &= 0x7fff;
+	while (count--)
+		state = ((state >> 1) |
+			 (((state ^ (state >> 1)) & 1) << 14)) & 0x7fff;
+
+	return state;
+}
+
+/* Randomizer seed used for the data of a given page */
+u16 sunxi_nand_rnd_seed(int page, int pages_per_block)
+{
+	int mod = min(pages_per_block, SUNXI_NAND_RND_MAX_PAGES);
+
+	return sunxi_nand_rnd_page_seeds[page % mod];
+}
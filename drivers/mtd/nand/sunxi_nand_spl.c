@@ -0,0 +1,213 @@
+/*
+ * Minimal NAND loader for the SPL on Allwinner A10/A13/A20
+ *
+ * Reads pages the way the full sunxi_nand driver writes them: hardware
+ * BCH over 1 KiB steps, the strongest mode that fits the spare area and
+ * optionally randomized, moved to memory by the dedicated DMA engine.
+ * The geometry comes from the board configuration.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <nand.h>
+#include <asm/io.h>
+#include <asm/errno.h>
+#include <asm/arch/cpu.h>
+#include <asm/arch/dma.h>
+#include <asm/arch/nand.h>
+
+#define SUNXI_NFC_TIMEOUT	1000	/* ms */
+
+#define PAGES_PER_BLOCK	(CONFIG_SYS_NAND_BLOCK_SIZE / CONFIG_SYS_NAND_PAGE_SIZE)
+
+#ifdef CONFIG_SYS_NAND_5_ADDR_CYCLE
+#define ADDR_CYCLES	5
+#else
+#define ADDR_CYCLES	4
+#endif
+
+static struct sunxi_nfc *const regs = (struct sunxi_nfc *)SUNXI_NFC_BASE;
+
+/* For pages only partly loaded, or to a destination the DMA cannot use */
+static u8 page_buf[CONFIG_SYS_NAND_PAGE_SIZE] __aligned(ARCH_DMA_MINALIGN);
+
+static int nfc_wait(u32 *reg, u32 mask, u32 val)
+{
+	ulong start = get_timer(0);
+
+	while ((readl(reg) & mask) != val) {
+		if (get_timer(start) > SUNXI_NFC_TIMEOUT)
+			return -ETIMEDOUT;
+	}
+
+	return 0;
+}
+
+static int nfc_run(u32 cmd)
+{
+	if (nfc_wait(&regs->st, SUNXI_NFC_ST_CMD_FIFO_STATUS, 0))
+		return -ETIMEDOUT;
+
+	writel(SUNXI_NFC_ST_CMD_INT_FLAG, &regs->st);
+	writel(cmd, &regs->cmd);
+
+	return nfc_wait(&regs->st, SUNXI_NFC_ST_CMD_INT_FLAG,
+			SUNXI_NFC_ST_CMD_INT_FLAG);
+}
+
+static void nfc_set_addr(int page, int column)
+{
+	writel((page << 16) | column, &regs->addr_low);
+	writel(page >> 16, &regs->addr_high);
+}
+
+static int nand_block_bad(int page)
+{
+	/* bad block marker, first byte of the spare area of the first page */
+	nfc_set_addr(page, CONFIG_SYS_NAND_PAGE_SIZE);
+	if (nfc_run(SUNXI_NFC_CMD_SEND_CMD1 | NAND_CMD_READ0 |
+		    SUNXI_NFC_CMD_SEND_ADR | SUNXI_NFC_CMD_ADR_NUM(ADDR_CYCLES)) ||
+	    nfc_run(SUNXI_NFC_CMD_SEND_CMD1 | NAND_CMD_READSTART |
+		    SUNXI_NFC_CMD_WAIT_FLAG))
+		return 1;
+
+	writel(1, &regs->cnt);
+	if (nfc_run(SUNXI_NFC_CMD_DATA_TRANS | SUNXI_NFC_CMD_DATA_SWAP_METHOD))
+		return 1;
+
+	return readb(&regs->ram0[0]) != 0xff;
+}
+
+static int nand_read_page(int page, void *dst)
+{
+	int steps = CONFIG_SYS_NAND_PAGE_SIZE / SUNXI_NAND_ECC_STEP;
+	int mode = sunxi_nand_ecc_mode(CONFIG_SYS_NAND_PAGE_SIZE,
+				       CONFIG_SYS_NAND_OOBSIZE);
+	u32 ecc_ctl, cfg, status;
+	int i;
+
+	if (mode < 0)
+		return -EINVAL;
+
+	ecc_ctl = SUNXI_NFC_ECC_EN | SUNXI_NFC_ECC_PIPELINE |
+		  SUNXI_NFC_ECC_EXCEPTION | SUNXI_NFC_ECC_MODE(mode);
+#ifdef CONFIG_NAND_SUNXI_RANDOMIZE
+	ecc_ctl |= SUNXI_NFC_ECC_RANDOM_EN | SUNXI_NFC_ECC_RANDOM_SEED(
+			sunxi_nand_rnd_seed(page, PAGES_PER_BLOCK));
+#endif
+	writel(ecc_ctl, &regs->ecc_ctl);
+
+	setbits_le32(&regs->ctl, SUNXI_NFC_CTL_RAM_METHOD);
+	writel(steps, &regs->sector_num);
+	writel(SUNXI_NAND_ECC_STEP, &regs->cnt);
+	writel(CONFIG_SYS_NAND_PAGE_SIZE, &regs->spare_area);
+
+	/* The data cache is off in the SPL, no maintenance needed */
+	cfg = SUNXI_DMA_CFG_SRC_DRQ(SUNXI_DDMA_DRQ_NAND) |
+	      SUNXI_DMA_CFG_SRC_ADDR_IO | SUNXI_DMA_CFG_SRC_WIDTH_32 |
+	      SUNXI_DMA_CFG_DST_DRQ(SUNXI_DDMA_DRQ_SDRAM) |
+	      SUNXI_DMA_CFG_DST_WIDTH_32;
+	sunxi_ddma_start(SUNXI_DDMA_CH_NAND, cfg,
+			 SUNXI_DDMA_PARA_SRC_WAIT(0x0f) |
+			 SUNXI_DDMA_PARA_SRC_BLK(0x7f),
+			 (u32)&regs->io_data, (u32)dst,
+			 CONFIG_SYS_NAND_PAGE_SIZE);
+
+	/* READ0, address, READSTART, wait, then one step after the other */
+	writel(SUNXI_NFC_RCMD(NAND_CMD_READSTART, NAND_CMD_RNDOUT,
+			      NAND_CMD_RNDOUTSTART), &regs->rcmd_set);
+	nfc_set_addr(page, 0);
+	if (nfc_run(SUNXI_NFC_CMD_PAGE_OP | NAND_CMD_READ0 |
+		    SUNXI_NFC_CMD_SEND_CMD1 | SUNXI_NFC_CMD_SEND_ADR |
+		    SUNXI_NFC_CMD_ADR_NUM(ADDR_CYCLES) |
+		    SUNXI_NFC_CMD_SEND_CMD2 | SUNXI_NFC_CMD_WAIT_FLAG |
+		    SUNXI_NFC_CMD_DATA_TRANS | SUNXI_NFC_CMD_DATA_SWAP_METHOD) ||
+	    sunxi_ddma_wait(SUNXI_DDMA_CH_NAND, SUNXI_NFC_TIMEOUT)) {
+		sunxi_ddma_stop(SUNXI_DDMA_CH_NAND);
+		return -ETIMEDOUT;
+	}
+
+	clrbits_le32(&regs->ctl, SUNXI_NFC_CTL_RAM_METHOD);
+	writel(0, &regs->ecc_ctl);
+
+	status = readl(&regs->ecc_st);
+	for (i = 0; i < steps; i++) {
+		if ((status & SUNXI_NFC_ECC_ERR(i)) &&
+		    !(status & SUNXI_NFC_ECC_PAT_FOUND(i)))
+			return -EBADMSG;
+	}
+
+	return 0;
+}
+
+int nand_spl_load_image(uint32_t offs, unsigned int size, void *dst)
+{
+	int page = offs / CONFIG_SYS_NAND_PAGE_SIZE;
+	unsigned int col = offs % CONFIG_SYS_NAND_PAGE_SIZE;
+	int checked = -1;
+	int ret;
+
+	while (size) {
+		int block = page / PAGES_PER_BLOCK;
+		unsigned int len = min_t(unsigned int, size,
+					 CONFIG_SYS_NAND_PAGE_SIZE - col);
+
+		if (block != checked) {
+			checked = block;
+			if (nand_block_bad(block * PAGES_PER_BLOCK)) {
+				debug("NAND: skipping bad block %d\n", block);
+				page = (block + 1) * PAGES_PER_BLOCK;
+				continue;
+			}
+		}
+
+		/* whole pages go straight to word aligned destinations */
+		if (len == CONFIG_SYS_NAND_PAGE_SIZE && !((ulong)dst & 3)) {
+			ret = nand_read_page(page, dst);
+		} else {
+			ret = nand_read_page(page, page_buf);
+			if (!ret)
+				memcpy(dst, page_buf + col, len);
+		}
+		if (ret) {
+			printf("NAND: error %d reading page %d\n", ret, page);
+			return ret;
+		}
+
+		dst += len;
+		size -= len;
+		col = 0;
+		page++;
+	}
+
+	return 0;
+}
+
+void nand_init(void)
+{
+	sunxi_nand_board_init();
+	sunxi_dma_init();
+
+	writel(SUNXI_NFC_CTL_EN | SUNXI_NFC_CTL_RESET, &regs->ctl);
+	if (nfc_wait(&regs->ctl, SUNXI_NFC_CTL_RESET, 0)) {
+		printf("NAND: controller reset timeout\n");
+		return;
+	}
+
+	writel(SUNXI_NFC_CTL_EN | SUNXI_NFC_CTL_CE_SEL(0) |
+	       SUNXI_NFC_CTL_PAGE_SHIFT(ffs(CONFIG_SYS_NAND_PAGE_SIZE) - 1),
+	       &regs->ctl);
+	writel(0, &regs->intr);
+	writel(0, &regs->timing_ctl);
+	writel(0xff, &regs->timing_cfg);
+
+	if (nfc_run(SUNXI_NFC_CMD_SEND_CMD1 | NAND_CMD_RESET |
+		    SUNXI_NFC_CMD_WAIT_FLAG))
+		printf("NAND: chip reset timeout\n");
+}
+
+void nand_deselect(void)
+{
+	writel(0, &regs->ctl);
+}
@@ -126,6 +126,8 @@ static void tx_descs_init(struct eth_device *dev)
 
 	writel((ulong)&desc_table_p[0], &dma_p->txdesclistaddr);
 	priv->tx_currdescnum = 0;
+	priv->tx_dirtydescnum = 0;
+	priv->tx_pending = 0;
 }
 
 static void rx_descs_init(struct eth_device *dev)
@@ -168,6 +170,7 @@ static void rx_descs_init(struct eth_device *dev)
 
 	writel((ulong)&desc_table_p[0], &dma_p->rxdesclistaddr);
 	priv->rx_currdescnum = 0;
+	priv->rx_ring_gen++;
 }
 
 static int dw_write_hwaddr(struct eth_device *dev)
@@ -225,6 +228,32 @@ static void dw_eth_halt(struct eth_device *dev)
 	phy_shutdown(priv->phydev);
 }
 
+#ifdef CONFIG_DW_CSUM_OFFLOAD
+/*
+ * Find out which checksums the GMAC can take care of. Only what the HW
+ * feature register reports is used: cores older than 3.50a read it as
+ * zero and may not have the engine at all, so they stay on software
+ * checksums. Receive checksums also need the full (type 2) engine and
+ * the IPC bit to stick.
+ */
+static void dw_csum_init(struct eth_device *dev)
+{
+	struct dw_eth_dev *priv = dev->priv;
+	struct eth_mac_regs *mac_p = priv->mac_regs_p;
+	u32 hwfeature = readl(&priv->dma_regs_p->hwfeature);
+
+	dev->csum_offload = 0;
+	if (hwfeature & HWFEAT_TXCOESEL)
+		dev->csum_offload |= ETH_CSUM_TX;
+
+	if (hwfeature & HWFEAT_RXTYP2COE) {
+		writel(readl(&mac_p->conf) | CHECKSUMOFFLOAD, &mac_p->conf);
+		if (readl(&mac_p->conf) & CHECKSUMOFFLOAD)
+			dev->csum_offload |= ETH_CSUM_RX_IP | ETH_CSUM_RX_L4;
+	}
+}
+#endif
+
 static int dw_eth_init(struct eth_device *dev, bd_t *bis)
 {
 	struct dw_eth_dev *priv = dev->priv;
@@ -268,11 +297,42 @@ static int dw_eth_init(struct eth_device *dev, bd_t *bis)
 	if (!priv->phydev->link)
 		return -1;
 
+#ifdef CONFIG_DW_CSUM_OFFLOAD
+	dw_csum_init(dev);
+#endif
+
 	writel(readl(&mac_p->conf) | RXENABLE | TXENABLE, &mac_p->conf);
 
 	return 0;
 }
 
+/*
+ * Take back every descriptor the DMA has finished with since the last
+ * call. The status words are pulled in with a single invalidate of the
+ * whole table instead of one cache operation per frame.
+ */
+static void dw_tx_reclaim(struct dw_eth_dev *priv)
+{
+	struct dmamacdescr *desc_p;
+
+	if (!priv->tx_pending)
+		return;
+
+	invalidate_dcache_range((unsigned long)priv->tx_mac_descrtable,
+				(unsigned long)priv->tx_mac_descrtable +
+				sizeof(priv->tx_mac_descrtable));
+
+	while (priv->tx_pending) {
+		desc_p = &priv->tx_mac_descrtable[priv->tx_dirtydescnum];
+		if (desc_p->txrx_status & DESC_TXSTS_OWNBYDMA)
+			break;
+
+		if (++priv->tx_dirtydescnum >= CONFIG_TX_DESCR_NUM)
+			priv->tx_dirtydescnum = 0;
+		priv->tx_pending--;
+	}
+}
+
 static int dw_eth_send(struct eth_device *dev, void *packet, int length)
 {
 	struct dw_eth_dev *priv = dev->priv;
@@ -280,21 +340,12 @@ static int dw_eth_send(struct eth_device *dev, void *packet, int length)
 	u32 desc_num = priv->tx_currdescnum;
 	struct dmamacdescr *desc_p = &priv->tx_mac_descrtable[desc_num];
 
-	/*
-	 * Strictly we only need to invalidate the "txrx_status" field
-	 * for the following check, but on some platforms we cannot
-	 * invalidate only 4 bytes, so roundup to
-	 * ARCH_DMA_MINALIGN. This is safe because the individual
-	 * descriptors in the array are each aligned to
-	 * ARCH_DMA_MINALIGN.
-	 */
-	invalidate_dcache_range(
-		(unsigned long)desc_p,
-		(unsigned long)desc_p +
-		roundup(sizeof(desc_p->txrx_status), ARCH_DMA_MINALIGN));
+	/* Only look at the ring once it is full */
+	if (priv->tx_pending >= CONFIG_TX_DESCR_NUM)
+		dw_tx_reclaim(priv);
 
 	/* Check if the descriptor is owned by CPU */
-	if (desc_p->txrx_status & DESC_TXSTS_OWNBYDMA) {
+	if (priv->tx_pending >= CONFIG_TX_DESCR_NUM) {
 		printf("CPU not owner of tx frame\n");
 		return -1;
 	}
@@ -307,15 +358,22 @@ static int dw_eth_send(struct eth_device *dev, void *packet, int length)
 
 #if defined(CONFIG_DW_ALTDESCRIPTOR)
 	desc_p->txrx_status |= DESC_TXSTS_TXFIRST | DESC_TXSTS_TXLAST;
+	desc_p->dmamac_cntl &= ~DESC_TXCTRL_SIZE1MASK;
 	desc_p->dmamac_cntl |= (length << DESC_TXCTRL_SIZE1SHFT) & \
 			       DESC_TXCTRL_SIZE1MASK;
 
 	desc_p->txrx_status &= ~(DESC_TXSTS_MSK);
+	if (dev->csum_offload & ETH_CSUM_TX)
+		desc_p->txrx_status |= DESC_TXSTS_TXCHECKINSCTRL;
 	desc_p->txrx_status |= DESC_TXSTS_OWNBYDMA;
 #else
+	/* The descriptor is reused, drop the size of the last frame */
+	desc_p->dmamac_cntl &= ~DESC_TXCTRL_SIZE1MASK;
 	desc_p->dmamac_cntl |= ((length << DESC_TXCTRL_SIZE1SHFT) & \
 			       DESC_TXCTRL_SIZE1MASK) | DESC_TXCTRL_TXLAST | \
 			       DESC_TXCTRL_TXFIRST;
+	if (dev->csum_offload & ETH_CSUM_TX)
+		desc_p->dmamac_cntl |= DESC_TXCTRL_TXCHECKINSCTRL;
 
 	desc_p->txrx_status = DESC_TXSTS_OWNBYDMA;
 #endif
@@ -329,6 +387,7 @@ static int dw_eth_send(struct eth_device *dev, void *packet, int length)
 		desc_num = 0;
 
 	priv->tx_currdescnum = desc_num;
+	priv->tx_pending++;
 
 	/* Start the transmission */
 	writel(POLL_DATA, &dma_p->txpolldemand);
@@ -336,22 +395,61 @@ static int dw_eth_send(struct eth_device *dev, void *packet, int length)
 	return 0;
 }
 
-static int dw_eth_recv(struct eth_device *dev)
+/* Give "count" rx descriptors starting at "first" back to the DMA */
+static void dw_rx_release(struct dw_eth_dev *priv, u32 first, u32 count)
+{
+	struct dmamacdescr *desc_table_p = priv->rx_mac_descrtable;
+	u32 idx = first, end;
+
+	while (count--) {
+		desc_table_p[idx].txrx_status = DESC_RXSTS_OWNBYDMA;
+		if (++idx >= CONFIG_RX_DESCR_NUM)
+			idx = 0;
+	}
+
+	/*
+	 * Descriptors are each aligned to ARCH_DMA_MINALIGN, so the batch
+	 * is written back with at most two flushes, one on either side of
+	 * the wrap-around.
+	 */
+	end = (idx > first) ? idx : CONFIG_RX_DESCR_NUM;
+	flush_dcache_range((unsigned long)&desc_table_p[first],
+			   (unsigned long)&desc_table_p[end]);
+	if (idx <= first && idx)
+		flush_dcache_range((unsigned long)&desc_table_p[0],
+				   (unsigned long)&desc_table_p[idx]);
+}
+
+static int dw_eth_recv_batch(struct eth_device *dev, int budget)
 {
 	struct dw_eth_dev *priv = dev->priv;
-	u32 status, desc_num = priv->rx_currdescnum;
-	struct dmamacdescr *desc_p = &priv->rx_mac_descrtable[desc_num];
-	int length = 0;
+	struct eth_dma_regs *dma_p = priv->dma_regs_p;
+	u32 status, first = priv->rx_currdescnum, desc_num = first;
+	u32 gen = priv->rx_ring_gen, count = 0;
+	struct dmamacdescr *desc_p;
+	int length, csum;
 
-	/* Invalidate entire buffer descriptor */
-	invalidate_dcache_range((unsigned long)desc_p,
-				(unsigned long)desc_p +
-				sizeof(struct dmamacdescr));
+	if (budget > CONFIG_RX_DESCR_NUM)
+		budget = CONFIG_RX_DESCR_NUM;
 
-	status = desc_p->txrx_status;
+	/*
+	 * Pass up to budget frames the GMAC has completed to the stack
+	 * straight out of their descriptor buffers, then return the whole
+	 * batch to the DMA.
+	 */
+	while (count < budget) {
+		desc_p = &priv->rx_mac_descrtable[desc_num];
 
-	/* Check  if the owner is the CPU */
-	if (!(status & DESC_RXSTS_OWNBYDMA)) {
+		/* Invalidate entire buffer descriptor */
+		invalidate_dcache_range((unsigned long)desc_p,
+					(unsigned long)desc_p +
+					sizeof(struct dmamacdescr));
+
+		status = desc_p->txrx_status;
+
+		/* Check  if the owner is the CPU */
+		if (status & DESC_RXSTS_OWNBYDMA)
+			break;
 
 		length = (status & DESC_RXSTS_FRMLENMSK) >> \
 			 DESC_RXSTS_FRMLENSHFT;
@@ -361,27 +459,42 @@ static int dw_eth_recv(struct eth_device *dev)
 					(unsigned long)desc_p->dmamac_addr +
 					roundup(length, ARCH_DMA_MINALIGN));
 
-		NetReceive(desc_p->dmamac_addr, length);
+		csum = 0;
+		if ((status & DESC_RXSTS_CSUMMSK) == DESC_RXSTS_CSUMOK)
+			csum = dev->csum_offload &
+			       (ETH_CSUM_RX_IP | ETH_CSUM_RX_L4);
+
+		net_receive_csum(desc_p->dmamac_addr, length, csum);
 
-		/*
-		 * Make the current descriptor valid again and go to
-		 * the next one
-		 */
-		desc_p->txrx_status |= DESC_RXSTS_OWNBYDMA;
+		/* The stack restarted the interface, the ring is fresh */
+		if (priv->rx_ring_gen != gen)
+			return count + 1;
 
-		/* Flush only status field - others weren't changed */
-		flush_dcache_range((unsigned long)&desc_p->txrx_status,
-				   (unsigned long)&desc_p->txrx_status +
-				   sizeof(desc_p->txrx_status));
+		count++;
 
 		/* Test the wrap-around condition. */
 		if (++desc_num >= CONFIG_RX_DESCR_NUM)
 			desc_num = 0;
+
+		if (net_state != NETLOOP_CONTINUE)
+			break;
+	}
+
+	if (count) {
+		dw_rx_release(priv, first, count);
+
+		/* Resume reception in case the ring had run dry */
+		writel(POLL_DATA, &dma_p->rxpolldemand);
 	}
 
 	priv->rx_currdescnum = desc_num;
 
-	return length;
+	return count;
+}
+
+static int dw_eth_recv(struct eth_device *dev)
+{
+	return dw_eth_recv_batch(dev, CONFIG_RX_DESCR_NUM);
 }
 
 static int dw_phy_init(struct eth_device *dev)
@@ -444,6 +557,7 @@ int designware_initialize(ulong base_addr, u32 interface)
 	dev->init = dw_eth_init;
 	dev->send = dw_eth_send;
 	dev->recv = dw_eth_recv;
+	dev->recv_batch = dw_eth_recv_batch;
 	dev->halt = dw_eth_halt;
 	dev->write_hwaddr = dw_write_hwaddr;
 
@@ -8,8 +8,12 @@
 #ifndef _DW_ETH_H
 #define _DW_ETH_H
 
+#ifndef CONFIG_TX_DESCR_NUM
 #define CONFIG_TX_DESCR_NUM	16
+#endif
+#ifndef CONFIG_RX_DESCR_NUM
 #define CONFIG_RX_DESCR_NUM	16
+#endif
 #define CONFIG_ETH_BUFSIZE	2048
 #define TX_TOTAL_BUFSIZE	(CONFIG_ETH_BUFSIZE * CONFIG_TX_DESCR_NUM)
 #define RX_TOTAL_BUFSIZE	(CONFIG_ETH_BUFSIZE * CONFIG_RX_DESCR_NUM)
@@ -40,6 +44,7 @@ struct eth_mac_regs {
 #define FES_100			(1 << 14)
 #define DISABLERXOWN		(1 << 13)
 #define FULLDPLXMODE		(1 << 11)
+#define CHECKSUMOFFLOAD		(1 << 10)	/* IPC, receive checksums */
 #define RXENABLE		(1 << 2)
 #define TXENABLE		(1 << 3)
 
@@ -73,6 +78,7 @@ struct eth_dma_regs {
 	u32 currhostrxdesc;	/* 0x4c */
 	u32 currhosttxbuffaddr;	/* 0x50 */
 	u32 currhostrxbuffaddr;	/* 0x54 */
+	u32 hwfeature;		/* 0x58, 3.50a and later */
 };
 
 #define DW_DMA_BASE_OFFSET	(0x1000)
@@ -102,6 +108,10 @@ struct eth_dma_regs {
 #define TXSECONDFRAME		(1 << 2)
 #define RXSTART			(1 << 1)
 
+/* HW feature register definitions */
+#define HWFEAT_RXTYP2COE	(1 << 18)	/* full receive checksums */
+#define HWFEAT_TXCOESEL		(1 << 16)	/* transmit checksums */
+
 /* Descriptior related definitions */
 #define MAC_MAX_FRAME_SZ	(1600)
 
@@ -159,6 +169,16 @@ struct dmamacdescr {
 #define DESC_RXSTS_RXMIIERROR		(1 << 3)
 #define DESC_RXSTS_RXDRIBBLING		(1 << 2)
 #define DESC_RXSTS_RXCRC		(1 << 1)
+#define DESC_RXSTS_RXPAYLOADCSUM	(1 << 0)
+
+/*
+ * With the receive checksum engine on, an IPv4/IPv6 frame whose header
+ * and payload checksums are both good has just this of the three bits
+ */
+#define DESC_RXSTS_CSUMMSK		(DESC_RXSTS_RXIPC_GIANT | \
+					 DESC_RXSTS_RXFRAMEETHER | \
+					 DESC_RXSTS_RXPAYLOADCSUM)
+#define DESC_RXSTS_CSUMOK		DESC_RXSTS_RXFRAMEETHER
 
 /*
  * dmamac_cntl definitions
@@ -222,7 +242,10 @@ struct dw_eth_dev {
 
 	u32 interface;
 	u32 tx_currdescnum;
+	u32 tx_dirtydescnum;	/* oldest descriptor not reclaimed yet */
+	u32 tx_pending;		/* descriptors handed to the DMA */
 	u32 rx_currdescnum;
+	u32 rx_ring_gen;	/* bumped whenever the rx ring is rebuilt */
 
 	struct eth_mac_regs *mac_regs_p;
 	struct eth_dma_regs *dma_regs_p;
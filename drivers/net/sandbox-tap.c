@@ -0,0 +1,224 @@
+/*
+ * Sandbox Ethernet driver on top of a host tap device
+ *
+ * Start sandbox with --tap=tap0 to put its Ethernet on a tap device set up
+ * on the host, for example with
+ *
+ *	ip tuntap add dev tap0 mode tap user $USER
+ *	ip addr add 192.168.0.1/24 dev tap0
+ *	ip link set tap0 up
+ *
+ * and run the TFTP, NFS or HTTP server to test against on 192.168.0.1.
+ * With --pcap=file every frame sent and received is also written to file,
+ * for tcpdump or wireshark to look at.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <errno.h>
+#include <malloc.h>
+#include <net.h>
+#include <netdev.h>
+#include <os.h>
+#include <asm/getopt.h>
+#include <asm/state.h>
+
+struct sandbox_tap_priv {
+	const char *ifname;
+	int fd;			/* tap device, -1 while halted */
+	int pcap_fd;		/* frame trace, -1 if none */
+	uchar *rxbuf;
+};
+
+/* Headers of the pcap file format, in host byte order */
+struct pcap_file_hdr {
+	u32 magic;
+	u16 version_major;
+	u16 version_minor;
+	s32 thiszone;
+	u32 sigfigs;
+	u32 snaplen;
+	u32 linktype;
+};
+
+struct pcap_rec_hdr {
+	u32 ts_sec;
+	u32 ts_usec;
+	u32 incl_len;
+	u32 orig_len;
+};
+
+#define PCAP_MAGIC		0xa1b2c3d4
+#define PCAP_LINKTYPE_ETHERNET	1
+
+static void sandbox_tap_trace(struct sandbox_tap_priv *priv, void *packet,
+			      int length)
+{
+	struct pcap_rec_hdr rec;
+	u64 usec;
+
+	if (priv->pcap_fd < 0)
+		return;
+
+	usec = os_get_nsec() / 1000;
+	rec.ts_sec = usec / 1000000;
+	rec.ts_usec = usec % 1000000;
+	rec.incl_len = length;
+	rec.orig_len = length;
+	if (os_write(priv->pcap_fd, &rec, sizeof(rec)) != sizeof(rec) ||
+	    os_write(priv->pcap_fd, packet, length) != length) {
+		printf("%s: cannot write frame trace, stopping it\n", __func__);
+		os_close(priv->pcap_fd);
+		priv->pcap_fd = -1;
+	}
+}
+
+static int sandbox_tap_pcap_open(struct sandbox_tap_priv *priv,
+				 const char *fname)
+{
+	struct pcap_file_hdr hdr = {
+		.magic		= PCAP_MAGIC,
+		.version_major	= 2,
+		.version_minor	= 4,
+		.snaplen	= PKTSIZE,
+		.linktype	= PCAP_LINKTYPE_ETHERNET,
+	};
+
+	priv->pcap_fd = os_open(fname, OS_O_WRONLY | OS_O_CREAT | OS_O_TRUNC);
+	if (priv->pcap_fd < 0)
+		return -1;
+	if (os_write(priv->pcap_fd, &hdr, sizeof(hdr)) != sizeof(hdr)) {
+		os_close(priv->pcap_fd);
+		priv->pcap_fd = -1;
+		return -1;
+	}
+
+	return 0;
+}
+
+static int sandbox_tap_init(struct eth_device *dev, bd_t *bis)
+{
+	struct sandbox_tap_priv *priv = dev->priv;
+
+	/* Start from an empty queue, like hardware coming out of reset */
+	if (priv->fd < 0)
+		priv->fd = os_tap_open(priv->ifname);
+	if (priv->fd < 0) {
+		printf("%s: cannot open tap device %s\n", __func__,
+		       priv->ifname);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int sandbox_tap_send(struct eth_device *dev, void *packet, int length)
+{
+	struct sandbox_tap_priv *priv = dev->priv;
+
+	sandbox_tap_trace(priv, packet, length);
+	if (os_write(priv->fd, packet, length) != length)
+		return -1;
+
+	return 0;
+}
+
+static int sandbox_tap_recv_batch(struct eth_device *dev, int budget)
+{
+	struct sandbox_tap_priv *priv = dev->priv;
+	int count = 0;
+	int length;
+
+	while (count < budget) {
+		length = os_read(priv->fd, priv->rxbuf, PKTSIZE);
+		if (length <= 0)
+			break;
+
+		sandbox_tap_trace(priv, priv->rxbuf, length);
+		NetReceive(priv->rxbuf, length);
+		count++;
+
+		/* The stack may have halted us */
+		if (priv->fd < 0 || net_state != NETLOOP_CONTINUE)
+			break;
+	}
+
+	return count;
+}
+
+static int sandbox_tap_recv(struct eth_device *dev)
+{
+	return sandbox_tap_recv_batch(dev, ETH_RX_BUDGET);
+}
+
+static void sandbox_tap_halt(struct eth_device *dev)
+{
+	struct sandbox_tap_priv *priv = dev->priv;
+
+	/* Frames for a halted device are dropped, so stop queueing them */
+	if (priv->fd >= 0) {
+		os_close(priv->fd);
+		priv->fd = -1;
+	}
+}
+
+int sandbox_tap_initialize(bd_t *bis)
+{
+	struct sandbox_state *state = state_get_current();
+	struct sandbox_tap_priv *priv;
+	struct eth_device *dev;
+
+	/* No --tap, no Ethernet */
+	if (!state->eth_tap)
+		return 0;
+
+	dev = calloc(1, sizeof(*dev));
+	priv = calloc(1, sizeof(*priv));
+	if (priv)
+		priv->rxbuf = malloc(PKTSIZE_ALIGN);
+	if (!dev || !priv || !priv->rxbuf) {
+		if (priv)
+			free(priv->rxbuf);
+		free(priv);
+		free(dev);
+		return -ENOMEM;
+	}
+
+	priv->ifname = state->eth_tap;
+	priv->fd = -1;
+	priv->pcap_fd = -1;
+	if (state->eth_pcap && sandbox_tap_pcap_open(priv, state->eth_pcap))
+		printf("%s: cannot write %s\n", __func__, state->eth_pcap);
+
+	sprintf(dev->name, "tap.%.11s", priv->ifname);
+	/* Locally administered; 'ethaddr' replaces it */
+	dev->enetaddr[0] = 0x02;
+	dev->enetaddr[5] = 0x01;
+	dev->priv = priv;
+	dev->init = sandbox_tap_init;
+	dev->send = sandbox_tap_send;
+	dev->recv = sandbox_tap_recv;
+	dev->recv_batch = sandbox_tap_recv_batch;
+	dev->halt = sandbox_tap_halt;
+
+	eth_register(dev);
+
+	return 1;
+}
+
+static int sandbox_cmdline_cb_tap(struct sandbox_state *state,
+				  const char *arg)
+{
+	state->eth_tap = arg;
+	return 0;
+}
+SANDBOX_CMDLINE_OPT(tap, 1, "Use host tap device <name> for Ethernet");
+
+static int sandbox_cmdline_cb_pcap(struct sandbox_state *state,
+				   const char *arg)
+{
+	state->eth_pcap = arg;
+	return 0;
+}
+SANDBOX_CMDLINE_OPT(pcap, 1, "Record Ethernet frames in pcap file <name>");
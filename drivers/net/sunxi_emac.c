@@ -14,6 +14,9 @@
 #include <asm/io.h>
 #include <asm/arch/clock.h>
 #include <asm/arch/gpio.h>
+#ifdef CONFIG_SUNXI_EMAC_DMA
+#include <asm/arch/dma.h>
+#endif
 
 /* EMAC register  */
 struct emac_regs {
@@ -153,13 +156,19 @@ struct sunxi_sramc_regs {
 #define EMAC_CRCERR		(0x1 << 4)
 #define EMAC_LENERR		(0x3 << 5)
 
-#define DMA_CPU_TRRESHOLD	2000
+/* Frames at least this long are moved by the DMA engine */
+#define DMA_CPU_TRRESHOLD	256
+
+#define EMAC_DMA_TIMEOUT	100	/* ms */
 
 struct emac_eth_dev {
 	u32 speed;
 	u32 duplex;
 	u32 phy_configured;
 	int link_printed;
+	int rx_idx;		/* next NetRxPackets[] slot to fill */
+	uchar *rx_dma_buf;	/* frame being moved by DMA, if any */
+	int rx_dma_len;
 };
 
 struct emac_rxhdr {
@@ -364,12 +373,96 @@ static int sunxi_emac_eth_init(struct eth_device *dev, bd_t *bd)
 
 static void sunxi_emac_eth_halt(struct eth_device *dev)
 {
-	/* Nothing to do here */
+#ifdef CONFIG_SUNXI_EMAC_DMA
+	struct emac_regs *regs = (struct emac_regs *)dev->iobase;
+	struct emac_eth_dev *priv = dev->priv;
+
+	/* Drop a frame still in flight, nobody is going to look at it */
+	if (priv->rx_dma_len) {
+		sunxi_ddma_stop(SUNXI_DDMA_CH_EMAC_RX);
+		clrbits_le32(&regs->rx_ctl, EMAC_RX_TM | EMAC_RX_DRQ_MODE);
+		priv->rx_dma_len = 0;
+	}
+#endif
 }
 
-static int sunxi_emac_eth_recv(struct eth_device *dev)
+static uchar *emac_next_rxbuf(struct emac_eth_dev *priv)
+{
+	uchar *buf = NetRxPackets[priv->rx_idx];
+
+	priv->rx_idx = (priv->rx_idx + 1) % PKTBUFSRX;
+
+	return buf;
+}
+
+#ifdef CONFIG_SUNXI_EMAC_DMA
+static void emac_rx_dma_start(struct eth_device *dev, uchar *buf, int len)
+{
+	struct emac_regs *regs = (struct emac_regs *)dev->iobase;
+	struct emac_eth_dev *priv = dev->priv;
+	u32 cfg;
+
+	/* Make sure no dirty line gets evicted on top of the DMA data */
+	invalidate_dcache_range((unsigned long)buf,
+				(unsigned long)buf + PKTSIZE_ALIGN);
+
+	/* Let the EMAC raise DRQ for the remainder of this frame */
+	setbits_le32(&regs->rx_ctl, EMAC_RX_TM | EMAC_RX_DRQ_MODE);
+
+	cfg = SUNXI_DMA_CFG_SRC_DRQ(SUNXI_DDMA_DRQ_EMAC) |
+	      SUNXI_DMA_CFG_SRC_ADDR_IO | SUNXI_DMA_CFG_SRC_WIDTH_32 |
+	      SUNXI_DMA_CFG_DST_DRQ(SUNXI_DDMA_DRQ_SDRAM) |
+	      SUNXI_DMA_CFG_DST_WIDTH_32;
+	sunxi_ddma_start(SUNXI_DDMA_CH_EMAC_RX, cfg, 0,
+			 (u32)&regs->rx_io_data, (u32)buf,
+			 roundup(len, 4));
+
+	priv->rx_dma_buf = buf;
+	priv->rx_dma_len = len;
+}
+
+/*
+ * Wait for the frame started by emac_rx_dma_start() and hand the FIFO
+ * back to the CPU. Returns the frame length, or 0 if it was lost.
+ */
+static int emac_rx_dma_finish(struct eth_device *dev)
+{
+	struct emac_regs *regs = (struct emac_regs *)dev->iobase;
+	struct emac_eth_dev *priv = dev->priv;
+	int len = priv->rx_dma_len;
+	int ret;
+
+	ret = sunxi_ddma_wait(SUNXI_DDMA_CH_EMAC_RX, EMAC_DMA_TIMEOUT);
+
+	clrbits_le32(&regs->rx_ctl, EMAC_RX_TM | EMAC_RX_DRQ_MODE);
+	priv->rx_dma_len = 0;
+
+	if (ret) {
+		printf("EMAC RX DMA timeout\n");
+		/* Flush RX FIFO, the frame boundary is gone */
+		setbits_le32(&regs->rx_ctl, 0x1 << 3);
+		while (readl(&regs->rx_ctl) & (0x1 << 3))
+			;
+		return 0;
+	}
+
+	invalidate_dcache_range((unsigned long)priv->rx_dma_buf,
+				(unsigned long)priv->rx_dma_buf + PKTSIZE_ALIGN);
+
+	return len;
+}
+#endif
+
+/*
+ * Pull the next frame out of the RX FIFO. Short frames are copied by
+ * the CPU and returned in *buf with their length. Long frames are handed
+ * to the DMA engine and 0 is returned, the data is collected by the next
+ * call to sunxi_emac_eth_recv().
+ */
+static int emac_rx_frame(struct eth_device *dev, uchar **buf)
 {
 	struct emac_regs *regs = (struct emac_regs *)dev->iobase;
+	struct emac_eth_dev *priv = dev->priv;
 	struct emac_rxhdr rxhdr;
 	u32 rxcount;
 	u32 reg_val;
@@ -433,14 +526,19 @@ static int sunxi_emac_eth_recv(struct eth_device *dev)
 
 	/* Move data from EMAC */
 	if (good_packet) {
-		if (rx_len > DMA_CPU_TRRESHOLD) {
+		if (rx_len > PKTSIZE_ALIGN) {
 			printf("Received packet is too big (len=%d)\n", rx_len);
 		} else {
+#ifdef CONFIG_SUNXI_EMAC_DMA
+			if (rx_len >= DMA_CPU_TRRESHOLD) {
+				emac_rx_dma_start(dev, emac_next_rxbuf(priv),
+						  rx_len);
+				return 0;
+			}
+#endif
+			*buf = emac_next_rxbuf(priv);
 			emac_inblk_32bit((void *)&regs->rx_io_data,
-					 NetRxPackets[0], rx_len);
-
-			/* Pass to upper layer */
-			NetReceive(NetRxPackets[0], rx_len);
+					 *buf, rx_len);
 			return rx_len;
 		}
 	}
@@ -448,6 +546,101 @@ static int sunxi_emac_eth_recv(struct eth_device *dev)
 	return 0;
 }
 
+static int sunxi_emac_eth_recv(struct eth_device *dev)
+{
+	uchar *buf = NULL;
+	int len;
+#ifdef CONFIG_SUNXI_EMAC_DMA
+	struct emac_eth_dev *priv = dev->priv;
+	uchar *dma_buf = priv->rx_dma_buf;
+	int dma_len = 0;
+
+	/*
+	 * Collect the frame the DMA engine moved since the last call and
+	 * get the next one going before the stack looks at it, so that
+	 * draining the FIFO overlaps with protocol processing.
+	 */
+	if (priv->rx_dma_len)
+		dma_len = emac_rx_dma_finish(dev);
+#endif
+
+	len = emac_rx_frame(dev, &buf);
+
+#ifdef CONFIG_SUNXI_EMAC_DMA
+	/* Pass to upper layer in arrival order */
+	if (dma_len)
+		NetReceive(dma_buf, dma_len);
+	if (len)
+		NetReceive(buf, len);
+
+	return dma_len + len;
+#else
+	if (len)
+		NetReceive(buf, len);
+
+	return len;
+#endif
+}
+
+/*
+ * Drain the RX FIFO in one go, so that a burst does not wait for a trip
+ * through the NetLoop() polling loop per frame and overflow the FIFO.
+ */
+static int sunxi_emac_eth_recv_batch(struct eth_device *dev, int budget)
+{
+	struct emac_eth_dev *priv = dev->priv;
+	int n;
+
+	for (n = 0; n < budget && net_state == NETLOOP_CONTINUE; n++) {
+		/* Stop when the FIFO is empty and no frame is in flight */
+		if (!sunxi_emac_eth_recv(dev) && !priv->rx_dma_len)
+			break;
+	}
+
+	return n;
+}
+
+#ifdef CONFIG_SUNXI_EMAC_DMA
+static int emac_tx_dma(struct eth_device *dev, void *packet, int len)
+{
+	struct emac_regs *regs = (struct emac_regs *)dev->iobase;
+	unsigned long start = (unsigned long)packet;
+	u32 cfg;
+	int ret;
+
+	start &= ~(ARCH_DMA_MINALIGN - 1);
+	flush_dcache_range(start, roundup((unsigned long)packet + len,
+					  ARCH_DMA_MINALIGN));
+
+	setbits_le32(&regs->tx_mode, EMAC_TX_TM);
+
+	cfg = SUNXI_DMA_CFG_SRC_DRQ(SUNXI_DDMA_DRQ_SDRAM) |
+	      SUNXI_DMA_CFG_SRC_WIDTH_32 |
+	      SUNXI_DMA_CFG_DST_DRQ(SUNXI_DDMA_DRQ_EMAC) |
+	      SUNXI_DMA_CFG_DST_ADDR_IO | SUNXI_DMA_CFG_DST_WIDTH_32;
+	sunxi_ddma_start(SUNXI_DDMA_CH_EMAC_TX, cfg, 0, (u32)packet,
+			 (u32)&regs->tx_io_data, roundup(len, 4));
+	ret = sunxi_ddma_wait(SUNXI_DDMA_CH_EMAC_TX, EMAC_DMA_TIMEOUT);
+
+	clrbits_le32(&regs->tx_mode, EMAC_TX_TM);
+
+	return ret;
+}
+#endif
+
+static int emac_tx_write(struct eth_device *dev, void *packet, int len)
+{
+	struct emac_regs *regs = (struct emac_regs *)dev->iobase;
+
+#ifdef CONFIG_SUNXI_EMAC_DMA
+	if (len >= DMA_CPU_TRRESHOLD && !((unsigned long)packet & 3))
+		return emac_tx_dma(dev, packet, len);
+#endif
+	emac_outblk_32bit((void *)&regs->tx_io_data, packet, len);
+
+	return 0;
+}
+
 static int sunxi_emac_eth_send(struct eth_device *dev, void *packet, int len)
 {
 	struct emac_regs *regs = (struct emac_regs *)dev->iobase;
@@ -456,7 +649,10 @@ static int sunxi_emac_eth_send(struct eth_device *dev, void *packet, int len)
 	writel(0, &regs->tx_ins);
 
 	/* Write packet */
-	emac_outblk_32bit((void *)&regs->tx_io_data, packet, len);
+	if (emac_tx_write(dev, packet, len)) {
+		printf("EMAC TX DMA timeout\n");
+		return -ETIMEDOUT;
+	}
 
 	/* Set TX len */
 	writel(len, &regs->tx_pl0);
@@ -502,6 +698,10 @@ int sunxi_emac_initialize(void)
 	/* Set up clock gating */
 	setbits_le32(&ccm->ahb_gate0, 0x1 << AHB_GATE_OFFSET_EMAC);
 
+#ifdef CONFIG_SUNXI_EMAC_DMA
+	sunxi_dma_init();
+#endif
+
 	/* Set MII clock */
 	clrsetbits_le32(&regs->mac_mcfg, 0xf << 2, 0xd << 2);
 
@@ -511,6 +711,7 @@ int sunxi_emac_initialize(void)
 	dev->halt = sunxi_emac_eth_halt;
 	dev->send = sunxi_emac_eth_send;
 	dev->recv = sunxi_emac_eth_recv;
+	dev->recv_batch = sunxi_emac_eth_recv_batch;
 	strcpy(dev->name, "emac");
 
 	eth_register(dev);
@@ -0,0 +1,173 @@
+/*
+ * LRU cache of ext4 metadata blocks
+ *
+ * Group descriptors, inode tables, extent tree and indirect blocks and
+ * directories are read through here, so that finding several files, or the
+ * same file in several commands, does not read the same blocks from the
+ * device each time.
+ *
+ * The cache holds the blocks of one filesystem, that of the device and
+ * partition last mounted. Mounting another one, or the same one with a
+ * superblock that has changed since (written to by someone else), empties
+ * it. Writes through put_ext4() drop the blocks they touch.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <ext4fs.h>
+#include <malloc.h>
+#include <linux/list.h>
+#include "ext4_common.h"
+
+#ifndef CONFIG_EXT4_META_CACHE_BLOCKS
+#define CONFIG_EXT4_META_CACHE_BLOCKS	32
+#endif
+
+struct ext4_cache_block {
+	struct list_head lru;
+	uint64_t blknr;
+	char *data;
+};
+
+static LIST_HEAD(cache_lru);		/* most recently used first */
+static int cache_count;
+
+/* The filesystem the blocks are from */
+static block_dev_desc_t *cache_dev;
+static lbaint_t cache_part;
+static int cache_log2_blksz;
+static struct ext2_sblock cache_sblock;
+
+static struct {
+	ulong hits;
+	ulong misses;
+	ulong evictions;
+	ulong flushes;		/* emptied for another filesystem */
+} cache_stats;
+
+static void ext4fs_cache_free(struct ext4_cache_block *cb)
+{
+	list_del(&cb->lru);
+	free(cb->data);
+	free(cb);
+	cache_count--;
+}
+
+void ext4fs_cache_drop(void)
+{
+	struct ext4_cache_block *cb, *tmp;
+
+	list_for_each_entry_safe(cb, tmp, &cache_lru, lru)
+		ext4fs_cache_free(cb);
+	cache_dev = NULL;
+}
+
+void ext4fs_cache_mount(struct ext2_data *data)
+{
+	if (cache_dev == get_fs()->dev_desc && cache_part == part_offset &&
+	    !memcmp(&cache_sblock, &data->sblock, sizeof(cache_sblock)))
+		return;
+
+	if (cache_count)
+		cache_stats.flushes++;
+	ext4fs_cache_drop();
+	cache_dev = get_fs()->dev_desc;
+	cache_part = part_offset;
+	cache_log2_blksz = LOG2_BLOCK_SIZE(data);
+	memcpy(&cache_sblock, &data->sblock, sizeof(cache_sblock));
+}
+
+/* Get a block to read into: a new one, or the least recently used */
+static struct ext4_cache_block *ext4fs_cache_get(void)
+{
+	struct ext4_cache_block *cb;
+
+	if (cache_count >= CONFIG_EXT4_META_CACHE_BLOCKS) {
+		cb = list_entry(cache_lru.prev, struct ext4_cache_block, lru);
+		list_del_init(&cb->lru);
+		cache_stats.evictions++;
+		return cb;
+	}
+
+	cb = malloc(sizeof(*cb));
+	if (!cb)
+		return NULL;
+	cb->data = malloc(1 << cache_log2_blksz);
+	if (!cb->data) {
+		free(cb);
+		return NULL;
+	}
+	INIT_LIST_HEAD(&cb->lru);
+	cache_count++;
+
+	return cb;
+}
+
+int ext4fs_cache_read(struct ext2_data *data, uint64_t blknr,
+		      int byte_offset, int byte_len, char *buf)
+{
+	int log2_sect = LOG2_BLOCK_SIZE(data) - get_fs()->dev_desc->log2blksz;
+	struct ext4_cache_block *cb;
+
+	/* Not mounted through ext4fs_mount(), so not ours to cache */
+	if (cache_dev != get_fs()->dev_desc || cache_part != part_offset ||
+	    cache_log2_blksz != LOG2_BLOCK_SIZE(data))
+		return ext4fs_devread((lbaint_t)blknr << log2_sect,
+				      byte_offset, byte_len, buf);
+
+	list_for_each_entry(cb, &cache_lru, lru) {
+		if (cb->blknr == blknr) {
+			list_move(&cb->lru, &cache_lru);
+			cache_stats.hits++;
+			memcpy(buf, cb->data + byte_offset, byte_len);
+			return 1;
+		}
+	}
+
+	cache_stats.misses++;
+	cb = ext4fs_cache_get();
+	if (!cb)
+		return ext4fs_devread((lbaint_t)blknr << log2_sect,
+				      byte_offset, byte_len, buf);
+
+	if (!ext4fs_devread((lbaint_t)blknr << log2_sect, 0,
+			    1 << cache_log2_blksz, cb->data)) {
+		ext4fs_cache_free(cb);
+		return 0;
+	}
+	cb->blknr = blknr;
+	list_add(&cb->lru, &cache_lru);
+	memcpy(buf, cb->data + byte_offset, byte_len);
+
+	return 1;
+}
+
+void ext4fs_cache_forget(uint64_t off, uint32_t size)
+{
+	struct ext4_cache_block *cb, *tmp;
+	uint64_t first, last;
+
+	if (cache_dev != get_fs()->dev_desc || cache_part != part_offset ||
+	    !size)
+		return;
+
+	first = off >> cache_log2_blksz;
+	last = (off + size - 1) >> cache_log2_blksz;
+	list_for_each_entry_safe(cb, tmp, &cache_lru, lru)
+		if (cb->blknr >= first && cb->blknr <= last)
+			ext4fs_cache_free(cb);
+}
+
+void ext4fs_cache_info(void)
+{
+	printf("%d of %d blocks cached", cache_count,
+	       CONFIG_EXT4_META_CACHE_BLOCKS);
+	if (cache_dev)
+		printf(", %d bytes each, of the partition at sector " LBAFU
+		       " of device %d", 1 << cache_log2_blksz, cache_part,
+		       cache_dev->dev);
+	printf("\n%lu hits, %lu misses, %lu evictions, %lu flushes\n",
+	       cache_stats.hits, cache_stats.misses, cache_stats.evictions,
+	       cache_stats.flushes);
+}
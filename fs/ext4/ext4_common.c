@@ -78,6 +78,8 @@ void put_ext4(uint64_t off, void *buf, uint32_t size)
 		return;
 	}
 
+	ext4fs_cache_forget(off, size);
+
 	if (remainder) {
 		if (fs->dev_desc->block_read) {
 			fs->dev_desc->block_read(fs->dev_desc->dev,
@@ -496,6 +498,13 @@ restart:
 
 	*p_ino = inodeno;
 
+	/*
+	 * The hash tree does not know about the new entry. Drop the index
+	 * flag, as Linux does with an index it cannot update, so lookups
+	 * scan the blocks again; e2fsck -D can rebuild the index.
+	 */
+	g_parent_inode->flags &= cpu_to_le32(~EXT4_INDEX_FL);
+
 	/* update or write  the 1st block of root inode */
 	if (ext4fs_put_metadata(root_first_block_buffer,
 				first_block_no_of_root))
@@ -520,10 +529,24 @@ static int search_dir(struct ext2_inode *parent_inode, char *dirname)
 	struct ext2_dirent *dir = NULL;
 	struct ext2_dirent *previous_dir = NULL;
 	struct ext_filesystem *fs = get_fs();
+	struct ext2fs_node dir_node;
+	struct ext4_dx_path path;
+	long int leaf = -1;
+
+	direct_blk_idx = 0;
+	/* With a hash tree, only the leaves it points to need looking at */
+	if (le32_to_cpu(parent_inode->flags) & EXT4_INDEX_FL) {
+		dir_node.data = ext4fs_root;
+		dir_node.inode = *parent_inode;
+		dir_node.ino = 0;
+		dir_node.inode_read = 1;
+		leaf = ext4fs_dx_probe(&dir_node, dirname, &path);
+		if (leaf > 0)
+			direct_blk_idx = leaf;
+	}
 
 	/* read the block no allocated to a file */
-	for (direct_blk_idx = 0; direct_blk_idx < INDIRECT_BLOCKS;
-		direct_blk_idx++) {
+	while (leaf > 0 || direct_blk_idx < INDIRECT_BLOCKS) {
 		blknr = read_allocated_block(parent_inode, direct_blk_idx);
 		if (blknr == 0)
 			goto fail;
@@ -541,6 +564,7 @@ static int search_dir(struct ext2_inode *parent_inode, char *dirname)
 		dir = (struct ext2_dirent *)block_buffer;
 		ptr = (char *)dir;
 		totalbytes = 0;
+		previous_dir = NULL;
 		while (dir->direntlen >= 0) {
 			/*
 			 * blocksize-totalbytes because last directory
@@ -552,7 +576,9 @@ static int search_dir(struct ext2_inode *parent_inode, char *dirname)
 				if (strncmp(dirname, ptr +
 					sizeof(struct ext2_dirent),
 					dir->namelen) == 0) {
-					previous_dir->direntlen +=
+					/* A hash tree leaf can start with it */
+					if (previous_dir)
+						previous_dir->direntlen +=
 							dir->direntlen;
 					inodeno = dir->inode;
 					dir->inode = 0;
@@ -580,6 +606,15 @@ static int search_dir(struct ext2_inode *parent_inode, char *dirname)
 
 		free(block_buffer);
 		block_buffer = NULL;
+
+		if (leaf > 0) {
+			leaf = ext4fs_dx_next_leaf(&dir_node, &path);
+			if (leaf <= 0)
+				break;
+			direct_blk_idx = leaf;
+		} else {
+			direct_blk_idx++;
+		}
 	}
 
 fail:
@@ -1407,16 +1442,21 @@ void ext4fs_allocate_blocks(struct ext2_inode *file_inode,
 
 #endif
 
+/*
+ * Find the leaf of the extent tree that maps fileblock. *end is set to the
+ * first file block past the part of the file the leaf covers.
+ */
 static struct ext4_extent_header *ext4fs_get_extent_block
 	(struct ext2_data *data, char *buf,
 		struct ext4_extent_header *ext_block,
-		uint32_t fileblock, int log2_blksz)
+		uint32_t fileblock, uint32_t *end)
 {
 	struct ext4_extent_idx *index;
 	unsigned long long block;
 	int blksz = EXT2_BLOCK_SIZE(data);
 	int i;
 
+	*end = ~0U;
 	while (1) {
 		index = (struct ext4_extent_idx *)(ext_block + 1);
 
@@ -1432,26 +1472,82 @@ static struct ext4_extent_header *ext4fs_get_extent_block
 				break;
 		} while (fileblock >= le32_to_cpu(index[i].ei_block));
 
+		if (i < le16_to_cpu(ext_block->eh_entries))
+			*end = le32_to_cpu(index[i].ei_block);
 		if (--i < 0)
 			return 0;
 
 		block = le16_to_cpu(index[i].ei_leaf_hi);
 		block = (block << 32) + le32_to_cpu(index[i].ei_leaf_lo);
 
-		if (ext4fs_devread((lbaint_t)block << log2_blksz, 0, blksz,
-				   buf))
+		if (ext4fs_cache_read(data, block, 0, blksz, buf))
 			ext_block = (struct ext4_extent_header *)buf;
 		else
 			return 0;
 	}
 }
 
+/*
+ * Map fileblock of an extent mapped inode to the filesystem block holding
+ * it, or 0 for a hole, and set *count to the number of blocks from there on
+ * that are contiguous on disk (or all a hole). buf is one filesystem block
+ * of scratch space for walking the extent tree. *uninit is set if the
+ * blocks are allocated but never written, so they must read as zeroes.
+ */
+long int ext4fs_map_extent(struct ext2_inode *inode, uint32_t fileblock,
+			   char *buf, uint32_t *count, int *uninit)
+{
+	struct ext4_extent_header *ext_block;
+	struct ext4_extent *extent;
+	unsigned long long start;
+	uint32_t ee_block, ee_len, end;
+	int entries;
+	int i;
+
+	ext_block = ext4fs_get_extent_block(ext4fs_root, buf,
+					    (struct ext4_extent_header *)
+					    inode->b.blocks.dir_blocks,
+					    fileblock, &end);
+	if (!ext_block) {
+		printf("invalid extent block\n");
+		return -EINVAL;
+	}
+
+	*uninit = 0;
+	extent = (struct ext4_extent *)(ext_block + 1);
+	entries = le16_to_cpu(ext_block->eh_entries);
+	for (i = 0; i < entries; i++)
+		if (fileblock < le32_to_cpu(extent[i].ee_block))
+			break;
+
+	/* A hole runs up to the next extent */
+	if (i < entries)
+		end = le32_to_cpu(extent[i].ee_block);
+	if (--i >= 0) {
+		ee_block = le32_to_cpu(extent[i].ee_block);
+		ee_len = le16_to_cpu(extent[i].ee_len);
+		if (ee_len > EXT4_EXT_INIT_MAX_LEN) {
+			ee_len -= EXT4_EXT_INIT_MAX_LEN;
+			*uninit = 1;
+		}
+		if (fileblock - ee_block < ee_len) {
+			*count = ee_len - (fileblock - ee_block);
+			start = le16_to_cpu(extent[i].ee_start_hi);
+			start = (start << 32) +
+					le32_to_cpu(extent[i].ee_start_lo);
+			return start + fileblock - ee_block;
+		}
+	}
+
+	*count = end - fileblock;
+	return 0;
+}
+
 static int ext4fs_blockgroup
 	(struct ext2_data *data, int group, struct ext2_block_group *blkgrp)
 {
 	long int blkno;
 	unsigned int blkoff, desc_per_blk;
-	int log2blksz = get_fs()->dev_desc->log2blksz;
 
 	desc_per_blk = EXT2_BLOCK_SIZE(data) / sizeof(struct ext2_block_group);
 
@@ -1462,10 +1558,9 @@ static int ext4fs_blockgroup
 	debug("ext4fs read %d group descriptor (blkno %ld blkoff %u)\n",
 	      group, blkno, blkoff);
 
-	return ext4fs_devread((lbaint_t)blkno <<
-			      (LOG2_BLOCK_SIZE(data) - log2blksz),
-			      blkoff, sizeof(struct ext2_block_group),
-			      (char *)blkgrp);
+	return ext4fs_cache_read(data, blkno, blkoff,
+				 sizeof(struct ext2_block_group),
+				 (char *)blkgrp);
 }
 
 int ext4fs_read_inode(struct ext2_data *data, int ino, struct ext2_inode *inode)
@@ -1473,7 +1568,6 @@ int ext4fs_read_inode(struct ext2_data *data, int ino, struct ext2_inode *inode)
 	struct ext2_block_group blkgrp;
 	struct ext2_sblock *sblock = &data->sblock;
 	struct ext_filesystem *fs = get_fs();
-	int log2blksz = get_fs()->dev_desc->log2blksz;
 	int inodes_per_block, status;
 	long int blkno;
 	unsigned int blkoff;
@@ -1490,9 +1584,8 @@ int ext4fs_read_inode(struct ext2_data *data, int ino, struct ext2_inode *inode)
 	    (ino % __le32_to_cpu(sblock->inodes_per_group)) / inodes_per_block;
 	blkoff = (ino % inodes_per_block) * fs->inodesz;
 	/* Read the inode. */
-	status = ext4fs_devread((lbaint_t)blkno << (LOG2_BLOCK_SIZE(data) -
-				log2blksz), blkoff,
-				sizeof(struct ext2_inode), (char *)inode);
+	status = ext4fs_cache_read(data, blkno, blkoff,
+				   sizeof(struct ext2_inode), (char *)inode);
 	if (status == 0)
 		return 0;
 
@@ -1508,7 +1601,6 @@ long int read_allocated_block(struct ext2_inode *inode, int fileblock)
 	long int rblock;
 	long int perblock_parent;
 	long int perblock_child;
-	unsigned long long start;
 	/* get the blocksize of the filesystem */
 	blksz = EXT2_BLOCK_SIZE(ext4fs_root);
 	log2_blksz = LOG2_BLOCK_SIZE(ext4fs_root)
@@ -1516,46 +1608,15 @@ long int read_allocated_block(struct ext2_inode *inode, int fileblock)
 
 	if (le32_to_cpu(inode->flags) & EXT4_EXTENTS_FL) {
 		char *buf = zalloc(blksz);
+		uint32_t count;
+		int uninit;
+
 		if (!buf)
 			return -ENOMEM;
-		struct ext4_extent_header *ext_block;
-		struct ext4_extent *extent;
-		int i = -1;
-		ext_block =
-			ext4fs_get_extent_block(ext4fs_root, buf,
-						(struct ext4_extent_header *)
-						inode->b.blocks.dir_blocks,
-						fileblock, log2_blksz);
-		if (!ext_block) {
-			printf("invalid extent block\n");
-			free(buf);
-			return -EINVAL;
-		}
-
-		extent = (struct ext4_extent *)(ext_block + 1);
-
-		do {
-			i++;
-			if (i >= le16_to_cpu(ext_block->eh_entries))
-				break;
-		} while (fileblock >= le32_to_cpu(extent[i].ee_block));
-		if (--i >= 0) {
-			fileblock -= le32_to_cpu(extent[i].ee_block);
-			if (fileblock >= le16_to_cpu(extent[i].ee_len)) {
-				free(buf);
-				return 0;
-			}
-
-			start = le16_to_cpu(extent[i].ee_start_hi);
-			start = (start << 32) +
-					le32_to_cpu(extent[i].ee_start_lo);
-			free(buf);
-			return fileblock + start;
-		}
-
-		printf("Extent Error\n");
+		blknr = ext4fs_map_extent(inode, fileblock, buf, &count,
+					  &uninit);
 		free(buf);
-		return -1;
+		return blknr;
 	}
 
 	/* Direct blocks. */
@@ -1590,10 +1651,9 @@ long int read_allocated_block(struct ext2_inode *inode, int fileblock)
 		if ((__le32_to_cpu(inode->b.blocks.indir_block) <<
 		     log2_blksz) != ext4fs_indir1_blkno) {
 			status =
-			    ext4fs_devread((lbaint_t)__le32_to_cpu
-					   (inode->b.blocks.
-					    indir_block) << log2_blksz, 0,
-					   blksz, (char *)ext4fs_indir1_block);
+			    ext4fs_cache_read(ext4fs_root, __le32_to_cpu
+					      (inode->b.blocks.indir_block), 0,
+					      blksz, (char *)ext4fs_indir1_block);
 			if (status == 0) {
 				printf("** SI ext2fs read block (indir 1)"
 					"failed. **\n");
@@ -1639,11 +1699,10 @@ long int read_allocated_block(struct ext2_inode *inode, int fileblock)
 		if ((__le32_to_cpu(inode->b.blocks.double_indir_block) <<
 		     log2_blksz) != ext4fs_indir1_blkno) {
 			status =
-			    ext4fs_devread((lbaint_t)__le32_to_cpu
-					   (inode->b.blocks.
-					    double_indir_block) << log2_blksz,
-					   0, blksz,
-					   (char *)ext4fs_indir1_block);
+			    ext4fs_cache_read(ext4fs_root, __le32_to_cpu
+					      (inode->b.blocks.double_indir_block),
+					      0, blksz,
+					      (char *)ext4fs_indir1_block);
 			if (status == 0) {
 				printf("** DI ext2fs read block (indir 2 1)"
 					"failed. **\n");
@@ -1679,12 +1738,11 @@ long int read_allocated_block(struct ext2_inode *inode, int fileblock)
 		}
 		if ((__le32_to_cpu(ext4fs_indir1_block[rblock / perblock]) <<
 		     log2_blksz) != ext4fs_indir2_blkno) {
-			status = ext4fs_devread((lbaint_t)__le32_to_cpu
-						(ext4fs_indir1_block
-						 [rblock /
-						  perblock]) << log2_blksz, 0,
-						blksz,
-						(char *)ext4fs_indir2_block);
+			status = ext4fs_cache_read(ext4fs_root, __le32_to_cpu
+						   (ext4fs_indir1_block
+						    [rblock / perblock]), 0,
+						   blksz,
+						   (char *)ext4fs_indir2_block);
 			if (status == 0) {
 				printf("** DI ext2fs read block (indir 2 2)"
 					"failed. **\n");
@@ -1730,11 +1788,10 @@ long int read_allocated_block(struct ext2_inode *inode, int fileblock)
 		}
 		if ((__le32_to_cpu(inode->b.blocks.triple_indir_block) <<
 		     log2_blksz) != ext4fs_indir1_blkno) {
-			status = ext4fs_devread
-			    ((lbaint_t)
-			     __le32_to_cpu(inode->b.blocks.triple_indir_block)
-			     << log2_blksz, 0, blksz,
-			     (char *)ext4fs_indir1_block);
+			status = ext4fs_cache_read
+			    (ext4fs_root,
+			     __le32_to_cpu(inode->b.blocks.triple_indir_block),
+			     0, blksz, (char *)ext4fs_indir1_block);
 			if (status == 0) {
 				printf("** TI ext2fs read block (indir 2 1)"
 					"failed. **\n");
@@ -1772,12 +1829,11 @@ long int read_allocated_block(struct ext2_inode *inode, int fileblock)
 						       perblock_parent]) <<
 		     log2_blksz)
 		    != ext4fs_indir2_blkno) {
-			status = ext4fs_devread((lbaint_t)__le32_to_cpu
-						(ext4fs_indir1_block
-						 [rblock /
-						  perblock_parent]) <<
-						log2_blksz, 0, blksz,
-						(char *)ext4fs_indir2_block);
+			status = ext4fs_cache_read(ext4fs_root, __le32_to_cpu
+						   (ext4fs_indir1_block
+						    [rblock / perblock_parent]),
+						   0, blksz,
+						   (char *)ext4fs_indir2_block);
 			if (status == 0) {
 				printf("** TI ext2fs read block (indir 2 2)"
 					"failed. **\n");
@@ -1817,11 +1873,11 @@ long int read_allocated_block(struct ext2_inode *inode, int fileblock)
 						       perblock_child]) <<
 		     log2_blksz) != ext4fs_indir3_blkno) {
 			status =
-			    ext4fs_devread((lbaint_t)__le32_to_cpu
-					   (ext4fs_indir2_block
-					    [(rblock / perblock_child)
-					     % (blksz / 4)]) << log2_blksz, 0,
-					   blksz, (char *)ext4fs_indir3_block);
+			    ext4fs_cache_read(ext4fs_root, __le32_to_cpu
+					      (ext4fs_indir2_block
+					       [(rblock / perblock_child)
+						% (blksz / 4)]), 0,
+					      blksz, (char *)ext4fs_indir3_block);
 			if (status == 0) {
 				printf("** TI ext2fs read block (indir 2 2)"
 				       "failed. **\n");
@@ -1873,24 +1929,15 @@ void ext4fs_close(void)
 	}
 }
 
-int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
-				struct ext2fs_node **fnode, int *ftype)
+/* Go through the entries of directory diro from fpos up to end */
+static int ext4fs_iterate_dir_range(struct ext2fs_node *diro,
+				    unsigned int fpos, unsigned int end,
+				    char *name, struct ext2fs_node **fnode,
+				    int *ftype)
 {
-	unsigned int fpos = 0;
 	int status;
-	struct ext2fs_node *diro = (struct ext2fs_node *) dir;
 
-#ifdef DEBUG
-	if (name != NULL)
-		printf("Iterate dir %s\n", name);
-#endif /* of DEBUG */
-	if (!diro->inode_read) {
-		status = ext4fs_read_inode(diro->data, diro->ino, &diro->inode);
-		if (status == 0)
-			return 0;
-	}
-	/* Search the file.  */
-	while (fpos < __le32_to_cpu(diro->inode.size)) {
+	while (fpos < end) {
 		struct ext2_dirent dirent;
 
 		status = ext4fs_read_file(diro, fpos,
@@ -1898,6 +1945,10 @@ int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
 					   (char *) &dirent);
 		if (status < 1)
 			return 0;
+		/* A bad length would never get us to the end */
+		if (__le16_to_cpu(dirent.direntlen) <
+		    sizeof(struct ext2_dirent))
+			return 0;
 
 		if (dirent.namelen != 0) {
 			char filename[dirent.namelen + 1];
@@ -2001,6 +2052,48 @@ int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
 	return 0;
 }
 
+int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
+				struct ext2fs_node **fnode, int *ftype)
+{
+	int status;
+	struct ext2fs_node *diro = (struct ext2fs_node *) dir;
+	struct ext4_dx_path path;
+	unsigned int blocksize;
+	long int leaf;
+
+#ifdef DEBUG
+	if (name != NULL)
+		printf("Iterate dir %s\n", name);
+#endif /* of DEBUG */
+	if (!diro->inode_read) {
+		status = ext4fs_read_inode(diro->data, diro->ino, &diro->inode);
+		if (status == 0)
+			return 0;
+	}
+	/* Look a name up in the hash tree, if the directory has one */
+	if ((name != NULL) && (fnode != NULL) && (ftype != NULL) &&
+	    (__le32_to_cpu(diro->inode.flags) & EXT4_INDEX_FL)) {
+		blocksize = EXT2_BLOCK_SIZE(diro->data);
+		leaf = ext4fs_dx_probe(diro, name, &path);
+		while (leaf > 0) {
+			status = ext4fs_iterate_dir_range(diro,
+							  leaf * blocksize,
+							  (leaf + 1) * blocksize,
+							  name, fnode, ftype);
+			if (status)
+				return status;
+			leaf = ext4fs_dx_next_leaf(diro, &path);
+		}
+		if (leaf == 0)
+			return 0;
+		/* No usable index, so scan the whole directory */
+	}
+
+	return ext4fs_iterate_dir_range(diro, 0,
+					__le32_to_cpu(diro->inode.size),
+					name, fnode, ftype);
+}
+
 static char *ext4fs_read_symlink(struct ext2fs_node *node)
 {
 	char *symlink;
@@ -2206,6 +2299,8 @@ int ext4fs_mount(unsigned part_length)
 	if (__le16_to_cpu(data->sblock.magic) != EXT2_MAGIC)
 		goto fail;
 
+	ext4fs_cache_mount(data);
+
 	if (__le32_to_cpu(data->sblock.revision_level == 0))
 		fs->inodesz = 128;
 	else
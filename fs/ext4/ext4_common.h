@@ -48,8 +48,52 @@ static inline void *zalloc(size_t size)
 	return p;
 }
 
+/* Where a hash tree lookup went, one frame per index level */
+struct ext4_dx_frame {
+	uint32_t block;		/* of the index node, within the directory */
+	unsigned int offset;	/* of its ext4_dx_entry array */
+	int count;		/* entries in it */
+	int at;			/* the one taken */
+};
+
+struct ext4_dx_path {
+	uint32_t hash;
+	int levels;		/* below the root */
+	struct ext4_dx_frame frame[EXT4_DX_MAX_LEVELS];
+};
+
+long int ext4fs_dx_probe(struct ext2fs_node *dir, const char *name,
+			 struct ext4_dx_path *path);
+long int ext4fs_dx_next_leaf(struct ext2fs_node *dir,
+			     struct ext4_dx_path *path);
+
+#ifdef CONFIG_EXT4_META_CACHE
+void ext4fs_cache_mount(struct ext2_data *data);
+int ext4fs_cache_read(struct ext2_data *data, uint64_t blknr,
+		      int byte_offset, int byte_len, char *buf);
+void ext4fs_cache_forget(uint64_t off, uint32_t size);
+#else
+static inline void ext4fs_cache_mount(struct ext2_data *data)
+{
+}
+
+static inline int ext4fs_cache_read(struct ext2_data *data, uint64_t blknr,
+				    int byte_offset, int byte_len, char *buf)
+{
+	return ext4fs_devread((lbaint_t)blknr << (LOG2_BLOCK_SIZE(data) -
+			      get_fs()->dev_desc->log2blksz),
+			      byte_offset, byte_len, buf);
+}
+
+static inline void ext4fs_cache_forget(uint64_t off, uint32_t size)
+{
+}
+#endif
+
 int ext4fs_read_inode(struct ext2_data *data, int ino,
 		      struct ext2_inode *inode);
+long int ext4fs_map_extent(struct ext2_inode *inode, uint32_t fileblock,
+			   char *buf, uint32_t *count, int *uninit);
 int ext4fs_read_file(struct ext2fs_node *node, int pos,
 		unsigned int len, char *buf);
 int ext4fs_find_file(const char *path, struct ext2fs_node *rootnode,
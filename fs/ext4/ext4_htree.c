@@ -0,0 +1,337 @@
+/*
+ * Lookups in ext4 hash tree (dx_dir) indexed directories
+ *
+ * A name is hashed and the index walked down to the one leaf block that
+ * can hold it, instead of scanning the whole directory. The hash functions
+ * are those of Linux fs/ext4/hash.c:
+ * Copyright (C) 2002 by Theodore Ts'o
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <ext4fs.h>
+#include "ext4_common.h"
+
+#define DELTA		0x9E3779B9
+#define HTREE_EOF	0x7fffffff
+
+static void tea_transform(uint32_t buf[4], const uint32_t in[])
+{
+	uint32_t sum = 0;
+	uint32_t b0 = buf[0], b1 = buf[1];
+	uint32_t a = in[0], b = in[1], c = in[2], d = in[3];
+	int n = 16;
+
+	do {
+		sum += DELTA;
+		b0 += ((b1 << 4) + a) ^ (b1 + sum) ^ ((b1 >> 5) + b);
+		b1 += ((b0 << 4) + c) ^ (b0 + sum) ^ ((b0 >> 5) + d);
+	} while (--n);
+
+	buf[0] += b0;
+	buf[1] += b1;
+}
+
+/* F, G and H are basic MD4 functions: selection, majority, parity */
+#define F(x, y, z)	((z) ^ ((x) & ((y) ^ (z))))
+#define G(x, y, z)	(((x) & (y)) + (((x) ^ (y)) & (z)))
+#define H(x, y, z)	((x) ^ (y) ^ (z))
+
+#define MD4_ROUND(f, a, b, c, d, x, s)	\
+	(a += f(b, c, d) + x, a = (a << s) | (a >> (32 - s)))
+#define K1	0
+#define K2	013240474631UL
+#define K3	015666365641UL
+
+static void half_md4_transform(uint32_t buf[4], const uint32_t in[8])
+{
+	uint32_t a = buf[0], b = buf[1], c = buf[2], d = buf[3];
+
+	/* Round 1 */
+	MD4_ROUND(F, a, b, c, d, in[0] + K1,  3);
+	MD4_ROUND(F, d, a, b, c, in[1] + K1,  7);
+	MD4_ROUND(F, c, d, a, b, in[2] + K1, 11);
+	MD4_ROUND(F, b, c, d, a, in[3] + K1, 19);
+	MD4_ROUND(F, a, b, c, d, in[4] + K1,  3);
+	MD4_ROUND(F, d, a, b, c, in[5] + K1,  7);
+	MD4_ROUND(F, c, d, a, b, in[6] + K1, 11);
+	MD4_ROUND(F, b, c, d, a, in[7] + K1, 19);
+
+	/* Round 2 */
+	MD4_ROUND(G, a, b, c, d, in[1] + K2,  3);
+	MD4_ROUND(G, d, a, b, c, in[3] + K2,  5);
+	MD4_ROUND(G, c, d, a, b, in[5] + K2,  9);
+	MD4_ROUND(G, b, c, d, a, in[7] + K2, 13);
+	MD4_ROUND(G, a, b, c, d, in[0] + K2,  3);
+	MD4_ROUND(G, d, a, b, c, in[2] + K2,  5);
+	MD4_ROUND(G, c, d, a, b, in[4] + K2,  9);
+	MD4_ROUND(G, b, c, d, a, in[6] + K2, 13);
+
+	/* Round 3 */
+	MD4_ROUND(H, a, b, c, d, in[3] + K3,  3);
+	MD4_ROUND(H, d, a, b, c, in[7] + K3,  9);
+	MD4_ROUND(H, c, d, a, b, in[2] + K3, 11);
+	MD4_ROUND(H, b, c, d, a, in[6] + K3, 15);
+	MD4_ROUND(H, a, b, c, d, in[1] + K3,  3);
+	MD4_ROUND(H, d, a, b, c, in[5] + K3,  9);
+	MD4_ROUND(H, c, d, a, b, in[0] + K3, 11);
+	MD4_ROUND(H, b, c, d, a, in[4] + K3, 15);
+
+	buf[0] += a;
+	buf[1] += b;
+	buf[2] += c;
+	buf[3] += d;
+}
+
+/* The legacy hash, with the name's chars signed or unsigned */
+static uint32_t dx_hack_hash(const char *name, int len, int unsigned_chars)
+{
+	uint32_t hash, hash0 = 0x12a3fe2d, hash1 = 0x37abe8f9;
+	int c;
+
+	while (len--) {
+		if (unsigned_chars)
+			c = *(const unsigned char *)name++;
+		else
+			c = *(const signed char *)name++;
+		hash = hash1 + (hash0 ^ (c * 7152373));
+
+		if (hash & 0x80000000)
+			hash -= 0x7fffffff;
+		hash1 = hash0;
+		hash0 = hash;
+	}
+
+	return hash0 << 1;
+}
+
+static void str2hashbuf(const char *msg, int len, uint32_t *buf, int num,
+			int unsigned_chars)
+{
+	uint32_t pad, val;
+	int i, c;
+
+	pad = (uint32_t)len | ((uint32_t)len << 8);
+	pad |= pad << 16;
+
+	val = pad;
+	if (len > num * 4)
+		len = num * 4;
+	for (i = 0; i < len; i++) {
+		if (unsigned_chars)
+			c = ((const unsigned char *)msg)[i];
+		else
+			c = ((const signed char *)msg)[i];
+		val = c + (val << 8);
+		if ((i % 4) == 3) {
+			*buf++ = val;
+			val = pad;
+			num--;
+		}
+	}
+	if (--num >= 0)
+		*buf++ = val;
+	while (--num >= 0)
+		*buf++ = pad;
+}
+
+/* The major hash of name, as stored in the index; seed is little endian */
+static uint32_t ext4fs_dirhash(const char *name, int len, int version,
+			       const uint32_t *seed)
+{
+	int unsigned_chars = version >= DX_HASH_UNSIGNED;
+	uint32_t in[8], buf[4];
+	uint32_t hash;
+	int i;
+
+	buf[0] = 0x67452301;
+	buf[1] = 0xefcdab89;
+	buf[2] = 0x98badcfe;
+	buf[3] = 0x10325476;
+
+	/* An all zero seed means the default one */
+	for (i = 0; i < 4; i++) {
+		if (seed[i]) {
+			for (i = 0; i < 4; i++)
+				buf[i] = __le32_to_cpu(seed[i]);
+			break;
+		}
+	}
+
+	switch (version % DX_HASH_UNSIGNED) {
+	case DX_HASH_LEGACY:
+		hash = dx_hack_hash(name, len, unsigned_chars);
+		break;
+	case DX_HASH_HALF_MD4:
+		for (; len > 0; len -= 32, name += 32) {
+			str2hashbuf(name, len, in, 8, unsigned_chars);
+			half_md4_transform(buf, in);
+		}
+		hash = buf[1];
+		break;
+	default:
+		for (; len > 0; len -= 16, name += 16) {
+			str2hashbuf(name, len, in, 4, unsigned_chars);
+			tea_transform(buf, in);
+		}
+		hash = buf[0];
+		break;
+	}
+
+	hash &= ~1;
+	if (hash == (HTREE_EOF << 1))
+		hash = (HTREE_EOF - 1) << 1;
+
+	return hash;
+}
+
+static int dx_read(struct ext2fs_node *dir, uint32_t block, unsigned int off,
+		   unsigned int len, void *buf)
+{
+	unsigned int blocksize = EXT2_BLOCK_SIZE(dir->data);
+
+	if (ext4fs_read_file(dir, block * blocksize + off, len, buf) != len)
+		return -1;
+
+	return 0;
+}
+
+/* Read the count of entries of the index node of frame */
+static int dx_node_open(struct ext2fs_node *dir, struct ext4_dx_frame *frame)
+{
+	unsigned int blocksize = EXT2_BLOCK_SIZE(dir->data);
+	struct ext4_dx_countlimit cl;
+
+	if (dx_read(dir, frame->block, frame->offset, sizeof(cl), &cl))
+		return -1;
+
+	frame->count = __le16_to_cpu(cl.count);
+	if (!frame->count || frame->count > __le16_to_cpu(cl.limit) ||
+	    frame->offset + __le16_to_cpu(cl.limit) *
+	    sizeof(struct ext4_dx_entry) > blocksize) {
+		printf("ext4fs: bad directory index in inode %d\n", dir->ino);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int dx_entry_read(struct ext2fs_node *dir, struct ext4_dx_frame *frame,
+			 int i, uint32_t *hash, uint32_t *block)
+{
+	struct ext4_dx_entry entry;
+
+	if (dx_read(dir, frame->block,
+		    frame->offset + i * sizeof(struct ext4_dx_entry),
+		    sizeof(entry), &entry))
+		return -1;
+
+	*hash = __le32_to_cpu(entry.hash);
+	*block = __le32_to_cpu(entry.block) & 0x0fffffff;
+
+	return 0;
+}
+
+/*
+ * Walk the index of dir down to the leaf block that would hold name.
+ * Returns its number within the directory, or -1 if the directory cannot
+ * be looked up this way and has to be scanned.
+ */
+long int ext4fs_dx_probe(struct ext2fs_node *dir, const char *name,
+			 struct ext4_dx_path *path)
+{
+	struct ext2_sblock *sblock = &dir->data->sblock;
+	struct ext4_dx_root_info info;
+	struct ext4_dx_frame *frame;
+	uint32_t hash, block = 0;
+	int version, level, lo, hi, mid;
+
+	if (!(__le32_to_cpu(sblock->feature_compatibility) &
+	      EXT4_FEATURE_COMPAT_DIR_INDEX))
+		return -1;
+
+	if (dx_read(dir, 0, EXT4_DX_ROOT_INFO_OFFSET, sizeof(info), &info))
+		return -1;
+	version = info.hash_version;
+	if (info.reserved_zero || info.info_length < sizeof(info) ||
+	    info.indirect_levels >= EXT4_DX_MAX_LEVELS ||
+	    version > DX_HASH_TEA) {
+		debug("ext4fs: inode %d: unknown directory index\n", dir->ino);
+		return -1;
+	}
+	if (__le32_to_cpu(sblock->flags) & EXT2_FLAGS_UNSIGNED_HASH)
+		version += DX_HASH_UNSIGNED;
+
+	path->hash = ext4fs_dirhash(name, strlen(name), version,
+				    sblock->hash_seed);
+	path->levels = info.indirect_levels;
+
+	for (level = 0; level <= path->levels; level++) {
+		frame = &path->frame[level];
+		frame->block = block;
+		frame->offset = level ? EXT4_DX_NODE_OFFSET :
+			EXT4_DX_ROOT_INFO_OFFSET + info.info_length;
+		if (dx_node_open(dir, frame))
+			return -1;
+
+		/* The last entry not above the hash; entry 0 is below all */
+		lo = 1;
+		hi = frame->count - 1;
+		while (lo <= hi) {
+			mid = lo + (hi - lo) / 2;
+			if (dx_entry_read(dir, frame, mid, &hash, &block))
+				return -1;
+			if (hash > path->hash)
+				hi = mid - 1;
+			else
+				lo = mid + 1;
+		}
+		frame->at = lo - 1;
+		if (dx_entry_read(dir, frame, frame->at, &hash, &block))
+			return -1;
+		/* Block 0 is the root, never a node or leaf */
+		if (!block)
+			return -1;
+	}
+
+	return block;
+}
+
+/*
+ * Names with the same hash can spill over into the following leaf blocks,
+ * which the index marks. Returns the next leaf to look in for the name
+ * ext4fs_dx_probe() was given, 0 if there is none, or -1 on error.
+ */
+long int ext4fs_dx_next_leaf(struct ext2fs_node *dir, struct ext4_dx_path *path)
+{
+	struct ext4_dx_frame *frame;
+	uint32_t hash, block;
+	int level = path->levels;
+
+	while (path->frame[level].at + 1 >= path->frame[level].count) {
+		if (!level)
+			return 0;
+		level--;
+	}
+
+	frame = &path->frame[level];
+	frame->at++;
+	if (dx_entry_read(dir, frame, frame->at, &hash, &block))
+		return -1;
+	if ((hash & ~1) != path->hash)
+		return 0;
+
+	/* Down the leftmost entries to the leaf */
+	while (level < path->levels) {
+		frame = &path->frame[++level];
+		frame->block = block;
+		frame->offset = EXT4_DX_NODE_OFFSET;
+		frame->at = 0;
+		if (dx_node_open(dir, frame) ||
+		    dx_entry_read(dir, frame, 0, &hash, &block))
+			return -1;
+	}
+
+	return block;
+}
@@ -452,6 +452,13 @@ static int ext4fs_delete_file(int inodeno)
 
 		for (i = 0; i < no_blocks; i++) {
 			blknr = read_allocated_block(&(node_inode->inode), i);
+			if (blknr < 0) {
+				free(node_inode);
+				goto fail;
+			}
+			/* A hole has no block to give back */
+			if (!blknr)
+				continue;
 			if (fs->blksz != 1024) {
 				bg_idx = blknr / blk_per_grp;
 			} else {
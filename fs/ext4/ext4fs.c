@@ -40,6 +40,95 @@ void ext4fs_free_node(struct ext2fs_node *node, struct ext2fs_node *currroot)
 		free(node);
 }
 
+/*
+ * Directories are read a directory entry at a time, so they go through the
+ * metadata cache a block at a time.
+ */
+static int ext4fs_read_dir(struct ext2fs_node *node, int pos,
+			   unsigned int len, char *buf)
+{
+	unsigned int blocksize = EXT2_BLOCK_SIZE(node->data);
+	unsigned int skipfirst, n, left = len;
+	long int blknr;
+
+	while (left) {
+		skipfirst = pos % blocksize;
+		n = min(left, blocksize - skipfirst);
+		blknr = read_allocated_block(&node->inode, pos / blocksize);
+		if (blknr < 0)
+			return -1;
+
+		if (blknr) {
+			if (!ext4fs_cache_read(node->data, blknr, skipfirst, n,
+					       buf))
+				return -1;
+		} else {
+			memset(buf, 0, n);
+		}
+		buf += n;
+		pos += n;
+		left -= n;
+	}
+
+	return len;
+}
+
+/*
+ * Extent mapped files are read a run of contiguous blocks at a time, with
+ * one walk of the extent tree and one device read per run, straight into buf.
+ */
+static int ext4fs_read_extents(struct ext2fs_node *node, int pos,
+			       unsigned int len, char *buf)
+{
+	struct ext_filesystem *fs = get_fs();
+	int log2blksz = fs->dev_desc->log2blksz;
+	int log2_fs_blocksize = LOG2_BLOCK_SIZE(node->data) - log2blksz;
+	unsigned int blocksize = 1 << (log2_fs_blocksize + log2blksz);
+	unsigned int end = pos + len;
+	unsigned int skipfirst, wanted, run;
+	uint32_t count;
+	long int blknr;
+	char *tree_buf;
+	int uninit;
+
+	tree_buf = zalloc(blocksize);
+	if (!tree_buf)
+		return -1;
+
+	while (pos < end) {
+		skipfirst = pos % blocksize;
+		blknr = ext4fs_map_extent(&node->inode, pos / blocksize,
+					  tree_buf, &count, &uninit);
+		if (blknr < 0)
+			goto fail;
+
+		/* Blocks still to read, and the bytes of them in this run */
+		wanted = (skipfirst + end - pos + blocksize - 1) / blocksize;
+		if (count < wanted)
+			run = count * blocksize - skipfirst;
+		else
+			run = end - pos;
+
+		/* Holes and blocks allocated but never written read as 0 */
+		if (blknr && !uninit) {
+			if (!ext4fs_devread((lbaint_t)blknr << log2_fs_blocksize,
+					    skipfirst, run, buf))
+				goto fail;
+		} else {
+			memset(buf, 0, run);
+		}
+		buf += run;
+		pos += run;
+	}
+
+	free(tree_buf);
+	return len;
+
+fail:
+	free(tree_buf);
+	return -1;
+}
+
 /*
  * Taken from openmoko-kernel mailing list: By Andy green
  * Optimized read file API : collects and defers contiguous sector
@@ -67,6 +156,12 @@ int ext4fs_read_file(struct ext2fs_node *node, int pos,
 	if (len > filesize)
 		len = filesize;
 
+	if ((__le16_to_cpu(node->inode.mode) & FILETYPE_INO_MASK) ==
+	    FILETYPE_INO_DIRECTORY)
+		return ext4fs_read_dir(node, pos, len, buf);
+	if (le32_to_cpu(node->inode.flags) & EXT4_EXTENTS_FL)
+		return ext4fs_read_extents(node, pos, len, buf);
+
 	blockcnt = ((len + pos) + blocksize - 1) / blocksize;
 
 	for (i = pos / blocksize; i < blockcnt; i++) {
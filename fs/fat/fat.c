@@ -52,6 +52,108 @@ static int disk_read(__u32 block, __u32 nr_blocks, void *buf)
 			cur_part_info.start + block, nr_blocks, buf);
 }
 
+/*
+ * The volume being read. With CONFIG_FAT_MOUNT_CACHE it stays mounted
+ * from one command to the next, with the window of its FAT in fatbuf and
+ * the directory sectors last read, until a command finds another device,
+ * partition or boot sector, or the volume is written to.
+ */
+static struct {
+	fsdata data;
+	int mounted;
+	__u32 root_cluster;	/* FAT32 root directory */
+	int rootdir_size;	/* FAT12/16 root directory, in sectors */
+	block_dev_desc_t *dev;
+	lbaint_t part_start;
+	__u8 bootsect[sizeof(boot_sector) + sizeof(volume_info)];
+} fat_mnt;
+
+#ifdef CONFIG_FAT_MOUNT_CACHE
+#ifndef CONFIG_FAT_DIR_CACHE_BLOCKS
+#define CONFIG_FAT_DIR_CACHE_BLOCKS	8
+#endif
+
+/* Directory sectors read from the mounted volume */
+static struct {
+	__u32 sect;
+	__u32 nr;		/* 0 when unused */
+	ulong used;		/* for finding the least recently used */
+	__u8 *data;
+} dir_cache[CONFIG_FAT_DIR_CACHE_BLOCKS];
+static ulong dir_cache_clock;
+
+static void dir_cache_drop(void)
+{
+	int i;
+
+	for (i = 0; i < CONFIG_FAT_DIR_CACHE_BLOCKS; i++) {
+		free(dir_cache[i].data);
+		dir_cache[i].data = NULL;
+		dir_cache[i].nr = 0;
+		dir_cache[i].used = 0;
+	}
+}
+
+/*
+ * Read 'nr' directory sectors from 'sect' into 'buffer', from the cache
+ * when they are of the mounted volume.
+ * Return 0 on success, -1 otherwise.
+ */
+static int get_dir_sects(fsdata *mydata, __u32 sect, __u32 nr, __u8 *buffer)
+{
+	unsigned long size = nr * mydata->sect_size;
+	int i, lru = 0;
+
+	if (mydata != &fat_mnt.data)
+		return disk_read(sect, nr, buffer) == nr ? 0 : -1;
+
+	for (i = 0; i < CONFIG_FAT_DIR_CACHE_BLOCKS; i++) {
+		if (dir_cache[i].nr == nr && dir_cache[i].sect == sect) {
+			dir_cache[i].used = ++dir_cache_clock;
+			memcpy(buffer, dir_cache[i].data, size);
+			return 0;
+		}
+		if (dir_cache[i].used < dir_cache[lru].used)
+			lru = i;
+	}
+
+	if (disk_read(sect, nr, buffer) != nr)
+		return -1;
+
+	free(dir_cache[lru].data);
+	dir_cache[lru].nr = 0;
+	dir_cache[lru].data = malloc(size);
+	if (dir_cache[lru].data) {
+		memcpy(dir_cache[lru].data, buffer, size);
+		dir_cache[lru].sect = sect;
+		dir_cache[lru].nr = nr;
+		dir_cache[lru].used = ++dir_cache_clock;
+	}
+
+	return 0;
+}
+#else
+static inline void dir_cache_drop(void)
+{
+}
+
+static int get_dir_sects(fsdata *mydata, __u32 sect, __u32 nr, __u8 *buffer)
+{
+	return disk_read(sect, nr, buffer) == nr ? 0 : -1;
+}
+#endif
+
+static void fat_unmount(void)
+{
+	if (!fat_mnt.mounted)
+		return;
+
+	dir_cache_drop();
+	free(fat_mnt.data.fatbuf);
+	fat_mnt.data.fatbuf = NULL;
+	fat_mnt.mounted = 0;
+}
+
 int fat_set_blk_dev(block_dev_desc_t *dev_desc, disk_partition_t *info)
 {
 	ALLOC_CACHE_ALIGN_BUFFER(unsigned char, buffer, dev_desc->blksz);
@@ -72,13 +174,21 @@ int fat_set_blk_dev(block_dev_desc_t *dev_desc, disk_partition_t *info)
 	}
 
 	/* Check for FAT12/FAT16/FAT32 filesystem */
-	if (!memcmp(buffer + DOS_FS_TYPE_OFFSET, "FAT", 3))
-		return 0;
-	if (!memcmp(buffer + DOS_FS32_TYPE_OFFSET, "FAT32", 5))
-		return 0;
+	if (memcmp(buffer + DOS_FS_TYPE_OFFSET, "FAT", 3) &&
+	    memcmp(buffer + DOS_FS32_TYPE_OFFSET, "FAT32", 5)) {
+		cur_dev = NULL;
+		return -1;
+	}
 
-	cur_dev = NULL;
-	return -1;
+	/* Another volume than the one mounted, or it reformatted */
+	if (fat_mnt.mounted && (fat_mnt.dev != dev_desc ||
+				fat_mnt.part_start != info->start ||
+				memcmp(fat_mnt.bootsect, buffer,
+				       sizeof(fat_mnt.bootsect))))
+		fat_unmount();
+	memcpy(fat_mnt.bootsect, buffer, sizeof(fat_mnt.bootsect));
+
+	return 0;
 }
 
 int fat_register_device(block_dev_desc_t *dev_desc, int part_no)
@@ -251,6 +361,28 @@ static __u32 get_fatent(fsdata *mydata, __u32 entry)
 	return ret;
 }
 
+/* The first sector of a cluster; cluster 0 is the FAT12/16 root directory */
+static __u32 clust_to_sect(fsdata *mydata, __u32 clustnum)
+{
+	if (clustnum > 0)
+		return mydata->data_begin + clustnum * mydata->clust_size;
+
+	return mydata->rootdir_sect;
+}
+
+/*
+ * Read a whole cluster of a directory into 'buffer'.
+ * Return 0 on success, -1 otherwise.
+ */
+static int get_dir_cluster(fsdata *mydata, __u32 clustnum, __u8 *buffer)
+{
+	return get_dir_sects(mydata, clust_to_sect(mydata, clustnum),
+			     mydata->clust_size, buffer);
+}
+
+__u8 get_contents_vfatname_block[MAX_CLUSTSIZE]
+	__aligned(ARCH_DMA_MINALIGN);
+
 /*
  * Read at most 'size' bytes from the specified cluster into 'buffer'.
  * Return 0 on success, -1 otherwise.
@@ -259,33 +391,31 @@ static int
 get_cluster(fsdata *mydata, __u32 clustnum, __u8 *buffer, unsigned long size)
 {
 	__u32 idx = 0;
-	__u32 startsect;
+	__u32 startsect = clust_to_sect(mydata, clustnum);
 	int ret;
 
-	if (clustnum > 0) {
-		startsect = mydata->data_begin +
-				clustnum * mydata->clust_size;
-	} else {
-		startsect = mydata->rootdir_sect;
-	}
-
 	debug("gc - clustnum: %d, startsect: %d\n", clustnum, startsect);
 
 	if ((unsigned long)buffer & (ARCH_DMA_MINALIGN - 1)) {
-		ALLOC_CACHE_ALIGN_BUFFER(__u8, tmpbuf, mydata->sect_size);
-
 		printf("FAT: Misaligned buffer address (%p)\n", buffer);
 
+		/* Bounce as many sectors at a time as the block holds */
 		while (size >= mydata->sect_size) {
-			ret = disk_read(startsect++, 1, tmpbuf);
-			if (ret != 1) {
+			idx = min(size, (unsigned long)
+				  sizeof(get_contents_vfatname_block)) /
+				mydata->sect_size;
+			ret = disk_read(startsect, idx,
+					get_contents_vfatname_block);
+			if (ret != idx) {
 				debug("Error reading data (got %d)\n", ret);
 				return -1;
 			}
 
-			memcpy(buffer, tmpbuf, mydata->sect_size);
-			buffer += mydata->sect_size;
-			size -= mydata->sect_size;
+			startsect += idx;
+			idx *= mydata->sect_size;
+			memcpy(buffer, get_contents_vfatname_block, idx);
+			buffer += idx;
+			size -= idx;
 		}
 	} else {
 		idx = size / mydata->sect_size;
@@ -314,14 +444,37 @@ get_cluster(fsdata *mydata, __u32 clustnum, __u8 *buffer, unsigned long size)
 	return 0;
 }
 
+/*
+ * Follow the chain from 'clust' for as long as it goes on to the next
+ * cluster on disk, over at most 'maxclust' clusters, so that they can be
+ * read at once. The entries come from fatbuf, which holds FATBUFBLOCKS
+ * sectors of the FAT at a time.
+ * Return the number of clusters in the run, and set '*next' to the entry
+ * of its last one: the cluster after it, or an end of chain mark.
+ */
+static __u32
+get_clust_run(fsdata *mydata, __u32 clust, __u32 maxclust, __u32 *next)
+{
+	__u32 count = 1, newclust;
+
+	while (1) {
+		newclust = get_fatent(mydata, clust);
+		if (count >= maxclust || newclust != clust + 1 ||
+		    CHECK_CLUST(newclust, mydata->fatsize))
+			break;
+		clust = newclust;
+		count++;
+	}
+
+	*next = newclust;
+	return count;
+}
+
 /*
  * Read at most 'maxsize' bytes from 'pos' in the file associated with 'dentptr'
  * into 'buffer'.
  * Return the number of bytes read or -1 on fatal errors.
  */
-__u8 get_contents_vfatname_block[MAX_CLUSTSIZE]
-	__aligned(ARCH_DMA_MINALIGN);
-
 static long
 get_contents(fsdata *mydata, dir_entry *dentptr, unsigned long pos,
 	     __u8 *buffer, unsigned long maxsize)
@@ -329,7 +482,7 @@ get_contents(fsdata *mydata, dir_entry *dentptr, unsigned long pos,
 	unsigned long filesize = FAT2CPU32(dentptr->size), gotsize = 0;
 	unsigned int bytesperclust = mydata->clust_size * mydata->sect_size;
 	__u32 curclust = START(dentptr);
-	__u32 endclust, newclust;
+	__u32 newclust, count;
 	unsigned long actsize;
 
 	debug("Filesize: %ld bytes\n", filesize);
@@ -386,50 +539,31 @@ get_contents(fsdata *mydata, dir_entry *dentptr, unsigned long pos,
 		}
 	}
 
-	actsize = bytesperclust;
-	endclust = curclust;
-
-	do {
-		/* search for consecutive clusters */
-		while (actsize < filesize) {
-			newclust = get_fatent(mydata, endclust);
-			if ((newclust - 1) != endclust)
-				goto getit;
-			if (CHECK_CLUST(newclust, mydata->fatsize)) {
-				debug("curclust: 0x%x\n", newclust);
-				debug("Invalid FAT entry\n");
-				return gotsize;
-			}
-			endclust = newclust;
-			actsize += bytesperclust;
-		}
-
-		/* get remaining bytes */
-		actsize = filesize;
-		if (get_cluster(mydata, curclust, buffer, (int)actsize) != 0) {
+	/* read the rest a run of contiguous clusters at a time */
+	while (filesize) {
+		count = get_clust_run(mydata, curclust,
+				      DIV_ROUND_UP(filesize, bytesperclust),
+				      &newclust);
+		actsize = min(filesize, (unsigned long)count * bytesperclust);
+		if (get_cluster(mydata, curclust, buffer, actsize) != 0) {
 			printf("Error reading cluster\n");
 			return -1;
 		}
 		gotsize += actsize;
-		return gotsize;
-getit:
-		if (get_cluster(mydata, curclust, buffer, (int)actsize) != 0) {
-			printf("Error reading cluster\n");
-			return -1;
-		}
-		gotsize += (int)actsize;
 		filesize -= actsize;
 		buffer += actsize;
+		if (!filesize)
+			break;
 
-		curclust = get_fatent(mydata, endclust);
+		curclust = newclust;
 		if (CHECK_CLUST(curclust, mydata->fatsize)) {
 			debug("curclust: 0x%x\n", curclust);
 			printf("Invalid FAT entry\n");
 			return gotsize;
 		}
-		actsize = bytesperclust;
-		endclust = curclust;
-	} while (1);
+	}
+
+	return gotsize;
 }
 
 /*
@@ -507,8 +641,8 @@ get_vfatname(fsdata *mydata, int curclust, __u8 *cluster,
 			return -1;
 		}
 
-		if (get_cluster(mydata, curclust, get_contents_vfatname_block,
-				mydata->clust_size * mydata->sect_size) != 0) {
+		if (get_dir_cluster(mydata, curclust,
+				    get_contents_vfatname_block) != 0) {
 			debug("Error: reading directory block\n");
 			return -1;
 		}
@@ -589,8 +723,8 @@ static dir_entry *get_dentfromdir(fsdata *mydata, int startsect,
 
 		int i;
 
-		if (get_cluster(mydata, curclust, get_dentfromdir_block,
-				mydata->clust_size * mydata->sect_size) != 0) {
+		if (get_dir_cluster(mydata, curclust,
+				    get_dentfromdir_block) != 0) {
 			debug("Error: reading directory block\n");
 			return NULL;
 		}
@@ -803,29 +937,22 @@ exit:
 	return ret;
 }
 
-__u8 do_fat_read_at_block[MAX_CLUSTSIZE]
-	__aligned(ARCH_DMA_MINALIGN);
-
-long
-do_fat_read_at(const char *filename, unsigned long pos, void *buffer,
-	       unsigned long maxsize, int dols, int dogetsize)
+/*
+ * Mount the volume of the current device, unless it is mounted already.
+ * Return 0 on success, -1 otherwise.
+ */
+static int fat_mount(void)
 {
-	char fnamecopy[2048];
+	fsdata *mydata = &fat_mnt.data;
 	boot_sector bs;
 	volume_info volinfo;
-	fsdata datablock;
-	fsdata *mydata = &datablock;
-	dir_entry *dentptr = NULL;
-	__u16 prevcksum = 0xffff;
-	char *subname = "";
-	__u32 cursect;
-	int idx, isdir = 0;
-	int files = 0, dirs = 0;
-	long ret = -1;
-	int firsttime;
-	__u32 root_cluster = 0;
-	int rootdir_size = 0;
-	int j;
+
+	if (fat_mnt.mounted) {
+		if (fat_mnt.dev == cur_dev &&
+		    fat_mnt.part_start == cur_part_info.start)
+			return 0;
+		fat_unmount();
+	}
 
 	if (read_bootsectandvi(&bs, &volinfo, &mydata->fatsize)) {
 		debug("Error: reading boot sector\n");
@@ -833,16 +960,16 @@ do_fat_read_at(const char *filename, unsigned long pos, void *buffer,
 	}
 
 	if (mydata->fatsize == 32) {
-		root_cluster = bs.root_cluster;
+		fat_mnt.root_cluster = bs.root_cluster;
 		mydata->fatlength = bs.fat32_length;
 	} else {
+		fat_mnt.root_cluster = 0;
 		mydata->fatlength = bs.fat_length;
 	}
 
 	mydata->fat_sect = bs.reserved;
 
-	cursect = mydata->rootdir_sect
-		= mydata->fat_sect + mydata->fatlength * bs.fats;
+	mydata->rootdir_sect = mydata->fat_sect + mydata->fatlength * bs.fats;
 
 	mydata->sect_size = (bs.sector_size[1] << 8) + bs.sector_size[0];
 	mydata->clust_size = bs.cluster_size;
@@ -853,15 +980,16 @@ do_fat_read_at(const char *filename, unsigned long pos, void *buffer,
 	}
 
 	if (mydata->fatsize == 32) {
+		fat_mnt.rootdir_size = 0;
 		mydata->data_begin = mydata->rootdir_sect -
 					(mydata->clust_size * 2);
 	} else {
-		rootdir_size = ((bs.dir_entries[1]  * (int)256 +
+		fat_mnt.rootdir_size = ((bs.dir_entries[1]  * (int)256 +
 				 bs.dir_entries[0]) *
 				 sizeof(dir_entry)) /
 				 mydata->sect_size;
 		mydata->data_begin = mydata->rootdir_sect +
-					rootdir_size -
+					fat_mnt.rootdir_size -
 					(mydata->clust_size * 2);
 	}
 
@@ -879,12 +1007,48 @@ do_fat_read_at(const char *filename, unsigned long pos, void *buffer,
 	       mydata->fatsize, mydata->fat_sect, mydata->fatlength);
 	debug("Rootdir begins at cluster: %d, sector: %d, offset: %x\n"
 	       "Data begins at: %d\n",
-	       root_cluster,
+	       fat_mnt.root_cluster,
 	       mydata->rootdir_sect,
 	       mydata->rootdir_sect * mydata->sect_size, mydata->data_begin);
 	debug("Sector size: %d, cluster size: %d\n", mydata->sect_size,
 	      mydata->clust_size);
 
+	fat_mnt.dev = cur_dev;
+	fat_mnt.part_start = cur_part_info.start;
+	fat_mnt.mounted = 1;
+
+	return 0;
+}
+
+__u8 do_fat_read_at_block[MAX_CLUSTSIZE]
+	__aligned(ARCH_DMA_MINALIGN);
+
+long
+do_fat_read_at(const char *filename, unsigned long pos, void *buffer,
+	       unsigned long maxsize, int dols, int dogetsize)
+{
+	char fnamecopy[2048];
+	fsdata *mydata;
+	dir_entry *dentptr = NULL;
+	__u16 prevcksum = 0xffff;
+	char *subname = "";
+	__u32 cursect;
+	int idx, isdir = 0;
+	int files = 0, dirs = 0;
+	long ret = -1;
+	int firsttime;
+	__u32 root_cluster;
+	int rootdir_size;
+	int j;
+
+	if (fat_mount())
+		return -1;
+
+	mydata = &fat_mnt.data;
+	cursect = mydata->rootdir_sect;
+	root_cluster = fat_mnt.root_cluster;
+	rootdir_size = fat_mnt.rootdir_size;
+
 	/* "cwd" is always the root... */
 	while (ISDIRDELIM(*filename))
 		filename++;
@@ -918,11 +1082,11 @@ do_fat_read_at(const char *filename, unsigned long pos, void *buffer,
 			debug("FAT read sect=%d, clust_size=%d, DIRENTSPERBLOCK=%zd\n",
 				cursect, mydata->clust_size, DIRENTSPERBLOCK);
 
-			if (disk_read(cursect,
-					(mydata->fatsize == 32) ?
-					(mydata->clust_size) :
-					PREFETCH_BLOCKS,
-					do_fat_read_at_block) < 0) {
+			if (get_dir_sects(mydata, cursect,
+					  (mydata->fatsize == 32) ?
+					  (mydata->clust_size) :
+					  PREFETCH_BLOCKS,
+					  do_fat_read_at_block) < 0) {
 				debug("Error: reading rootdir block\n");
 				goto exit;
 			}
@@ -1159,7 +1323,9 @@ rootdir_done:
 	debug("Size: %d, got: %ld\n", FAT2CPU32(dentptr->size), ret);
 
 exit:
-	free(mydata->fatbuf);
+#ifndef CONFIG_FAT_MOUNT_CACHE
+	fat_unmount();
+#endif
 	return ret;
 }
 
@@ -1181,6 +1347,9 @@ int file_fat_detectfs(void)
 		return 1;
 	}
 
+	/* Detect it afresh, in case it was written to behind our back */
+	fat_unmount();
+
 #if defined(CONFIG_CMD_IDE) || \
     defined(CONFIG_CMD_SATA) || \
     defined(CONFIG_CMD_SCSI) || \
@@ -811,6 +811,12 @@ int	init_timebase (void);
 int gunzip(void *, int, unsigned char *, unsigned long *);
 int zunzip(void *dst, int dstlen, unsigned char *src, unsigned long *lenp,
 						int stoponerr, int offset);
+struct z_stream_s;
+/* Start inflating a gzip file to dst, fed piecewise by gzip_stream_feed() */
+int gzip_stream_start(struct z_stream_s *s, void *dst, unsigned long dstlen);
+/* Returns 0 if more input is wanted, 1 at the end of the file, -1 on error */
+int gzip_stream_feed(struct z_stream_s *s, void *src, unsigned long len);
+void gzip_stream_end(struct z_stream_s *s);
 
 /* lib/qsort.c */
 void qsort(void *base, size_t nmemb, size_t size,
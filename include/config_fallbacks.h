@@ -75,6 +75,14 @@
 #define CONFIG_LIB_RAND
 #endif
 
+#if defined(CONFIG_SYS_MMC_READAHEAD) && !defined(CONFIG_MMC_ASYNC_READ)
+#define CONFIG_MMC_ASYNC_READ
+#endif
+
+#if defined(CONFIG_CMD_WGET) && !defined(CONFIG_PROT_TCP)
+#define CONFIG_PROT_TCP
+#endif
+
 #ifndef CONFIG_SYS_PROMPT
 #define CONFIG_SYS_PROMPT	"=> "
 #endif
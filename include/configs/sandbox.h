@@ -43,8 +43,10 @@
 #define CONFIG_DEFAULT_DEVICE_TREE	sandbox
 
 #define CONFIG_FS_FAT
+#define CONFIG_FAT_MOUNT_CACHE
 #define CONFIG_FS_EXT4
 #define CONFIG_EXT4_WRITE
+#define CONFIG_EXT4_META_CACHE
 #define CONFIG_CMD_FAT
 #define CONFIG_CMD_EXT4
 #define CONFIG_CMD_EXT4_WRITE
@@ -122,9 +124,13 @@
 /* include default commands */
 #include <config_cmd_default.h>
 
-/* We don't have networking support yet */
-#undef CONFIG_CMD_NET
-#undef CONFIG_CMD_NFS
+/* Networking goes through a host tap device, given with --tap */
+#define CONFIG_SANDBOX_ETH_TAP
+#define CONFIG_CMD_PING
+#define CONFIG_CMD_WGET
+#define CONFIG_CMD_NET_BENCH
+#define CONFIG_TFTP_RANGES
+#define CONFIG_TFTP_OFFSET_OPTION
 
 #define CONFIG_CMD_HASH
 #define CONFIG_HASH_VERIFY
@@ -27,6 +27,17 @@
 
 #define CONFIG_SYS_TEXT_BASE		0x4a000000
 
+/*
+ * All sunxi cores have NEON, use it for memcpy/memset. The FEL SPL has
+ * its own start code which does not enable the unit.
+ */
+#if !defined CONFIG_SPL_BUILD || !defined CONFIG_SPL_FEL
+#define CONFIG_USE_ARCH_MEMCPY
+#define CONFIG_USE_ARCH_MEMCPY_NEON
+#define CONFIG_USE_ARCH_MEMSET
+#define CONFIG_USE_ARCH_MEMSET_NEON
+#endif
+
 /*
  * Display CPU and Board information
  */
@@ -63,16 +74,18 @@
 #else
 #define PHYS_SDRAM_0_SIZE		0x40000000 /* 1 GiB */
 #endif
-#if 0
+#ifdef CONFIG_NAND_SUNXI
 /* Nand config */
 #define CONFIG_NAND
-#define CONFIG_NAND_SUNXI
 #define CONFIG_CMD_NAND                         /* NAND support */
 #define CONFIG_SYS_MAX_NAND_DEVICE      1
-#define CONFIG_SYS_NAND_BASE            0x00
+#define CONFIG_SYS_NAND_MAX_CHIPS       1
+#define CONFIG_SYS_NAND_SELF_INIT
+#define CONFIG_SYS_NAND_ONFI_DETECTION
 #endif
 
 #define CONFIG_CMD_MEMORY
+#define CONFIG_CMD_MEMBENCH		/* compare the NEON memcpy/memset */
 #define CONFIG_CMD_SETEXPR
 
 #define CONFIG_SETUP_MEMORY_TAGS
@@ -86,6 +99,10 @@
 #define CONFIG_GENERIC_MMC
 #define CONFIG_CMD_MMC
 #define CONFIG_MMC_SUNXI
+#define CONFIG_MMC_SUNXI_DMA
+#ifndef CONFIG_SPL_BUILD
+#define CONFIG_SYS_MMC_READAHEAD	128	/* blocks, 64 KiB */
+#endif
 #ifndef CONFIG_MMC_SUNXI_SLOT
 #define CONFIG_MMC_SUNXI_SLOT		0
 #endif
@@ -247,6 +264,8 @@
 #include <config_cmd_default.h>
 
 #define CONFIG_FAT_WRITE	/* enable write access */
+#define CONFIG_FAT_MOUNT_CACHE	/* boot scripts load several files */
+#define CONFIG_EXT4_META_CACHE	/* boot scripts look up many files */
 
 #define CONFIG_SPL_FRAMEWORK
 #define CONFIG_SPL_LIBCOMMON_SUPPORT
@@ -276,15 +295,26 @@
 #define CONFIG_SPL_BSS_START_ADDR	0x4ff80000
 #define CONFIG_SPL_BSS_MAX_SIZE		0x80000		/* 512 KiB */
 
-#define CONFIG_SPL_TEXT_BASE		0x20		/* sram start+header */
+#define CONFIG_SPL_TEXT_BASE		0x40		/* sram start+header */
 #ifdef CONFIG_SUN5I
-#define CONFIG_SPL_MAX_SIZE		0x75e0		/* 7748+ is used */
+#define CONFIG_SPL_MAX_SIZE		0x75c0		/* 7748+ is used */
 #else
-#define CONFIG_SPL_MAX_SIZE		0x5fe0		/* 24KB on sun4i/sun7i */
+#define CONFIG_SPL_MAX_SIZE		0x5fc0		/* 24KB on sun4i/sun7i */
 #endif
 
+#if defined CONFIG_NAND_SUNXI && defined CONFIG_SYS_NAND_PAGE_SIZE
+/* Boards describing their NAND geometry load U-Boot from it */
+#define CONFIG_SPL_NAND_SUPPORT
+#ifndef CONFIG_SYS_NAND_U_BOOT_OFFS
+#define CONFIG_SYS_NAND_U_BOOT_OFFS	0x400000	/* 4 MiB */
+#endif
+#else
 #define CONFIG_SPL_LIBDISK_SUPPORT
 #define CONFIG_SPL_MMC_SUPPORT
+/* Keep the DRAM DLL scan result in the SPL header on the card */
+#define CONFIG_SUNXI_DRAM_TRAIN_CACHE
+#define CONFIG_SUNXI_DRAM_TRAIN_SAVE
+#endif
 
 #define CONFIG_SPL_LDSCRIPT "arch/arm/cpu/armv7/sunxi/u-boot-spl.lds"
 
@@ -305,6 +335,13 @@
 #define CONFIG_SYS_MMCSD_RAW_MODE_ARGS_SECTOR	1344
 #define CONFIG_SYS_MMCSD_RAW_MODE_ARGS_SECTORS  256
 #define CONFIG_SYS_MMCSD_RAW_MODE_KERNEL_SECTOR 1600
+#define CONFIG_SPL_MMC_OS_VERIFY
+#define CONFIG_MMC_ASYNC_READ
+#endif
+#ifdef CONFIG_SPL_NAND_SUPPORT
+#define CONFIG_CMD_SPL_NAND_OFS		0x300000	/* 3 MiB */
+#define CONFIG_CMD_SPL_WRITE_SIZE	0x2000
+#define CONFIG_SYS_NAND_SPL_KERNEL_OFFS	0x800000	/* 8 MiB */
 #endif
 #endif
 
@@ -392,15 +429,18 @@
 /* Ethernet support */
 #ifdef CONFIG_SUNXI_EMAC
 #define CONFIG_MII			/* MII PHY management		*/
+#define CONFIG_SUNXI_EMAC_DMA		/* move large frames with DMA	*/
 #endif
 
 #ifdef CONFIG_SUNXI_GMAC
 #define CONFIG_DESIGNWARE_ETH		/* GMAC can use designware driver */
 #define CONFIG_DW_AUTONEG
+#define CONFIG_DW_CSUM_OFFLOAD		/* GMAC checksums, if it has them */
 #define CONFIG_PHY_GIGE			/* GMAC can use gigabit PHY	*/
 #define CONFIG_PHY_ADDR		1
 #define CONFIG_MII			/* MII PHY management		*/
 #define CONFIG_PHYLIB
+#define CONFIG_RX_DESCR_NUM		64	/* absorb gigabit bursts	*/
 #endif
 
 #ifdef CONFIG_CMD_NET
@@ -409,6 +449,9 @@
 #define CONFIG_NETCONSOLE
 #define CONFIG_BOOTP_DNS2
 #define CONFIG_BOOTP_SEND_HOSTNAME
+#define CONFIG_NET_ARP_CACHE
+#define CONFIG_NET_GUNZIP
+#define CONFIG_IP_DEFRAG		/* 8 KiB NFS reads */
 #endif
 
 #if !defined CONFIG_ENV_IS_IN_MMC && \
@@ -28,8 +28,12 @@
 #define __EXT4__
 #include <ext_common.h>
 
+#define EXT4_INDEX_FL		0x00001000 /* Directory has a hash tree */
 #define EXT4_EXTENTS_FL		0x00080000 /* Inode uses extents */
 #define EXT4_EXT_MAGIC			0xf30a
+/* Longer ee_len: uninitialized extent of ee_len - this, reads as zeroes */
+#define EXT4_EXT_INIT_MAX_LEN		(1 << 15)
+#define EXT4_FEATURE_COMPAT_DIR_INDEX	0x0020
 #define EXT4_FEATURE_RO_COMPAT_GDT_CSUM	0x0010
 #define EXT4_FEATURE_INCOMPAT_EXTENTS	0x0040
 #define EXT4_INDIRECT_BLOCKS		12
@@ -76,6 +80,43 @@ struct ext4_extent_header {
 	__le32	eh_generation;	/* generation of the tree */
 };
 
+/*
+ * Hash tree directory index. Block 0 of an indexed directory holds the
+ * "." and ".." entries, then ext4_dx_root_info and the first level of
+ * ext4_dx_entry. Lower index levels are blocks with one empty directory
+ * entry covering the block, then their ext4_dx_entry array. The hash slot
+ * of the first entry of an array holds its ext4_dx_countlimit instead.
+ */
+#define EXT4_DX_ROOT_INFO_OFFSET	24
+#define EXT4_DX_NODE_OFFSET		8
+#define EXT4_DX_MAX_LEVELS		3
+
+#define DX_HASH_LEGACY			0
+#define DX_HASH_HALF_MD4		1
+#define DX_HASH_TEA			2
+#define DX_HASH_UNSIGNED		3	/* add for the unsigned variant */
+
+#define EXT2_FLAGS_UNSIGNED_HASH	0x0002	/* in the superblock flags */
+
+struct ext4_dx_root_info {
+	__le32	reserved_zero;
+	__u8	hash_version;
+	__u8	info_length;	/* 8 */
+	__u8	indirect_levels;
+	__u8	unused_flags;
+};
+
+struct ext4_dx_countlimit {
+	__le16	limit;
+	__le16	count;
+};
+
+struct ext4_dx_entry {
+	__le32	hash;		/* lowest hash in the block; bit 0 set *
+				 * if the block before ends with it too */
+	__le32	block;		/* directory block it is in */
+};
+
 struct ext_filesystem {
 	/* Total Sector of partition */
 	uint64_t total_sect;
@@ -143,4 +184,8 @@ int ext4fs_probe(block_dev_desc_t *fs_dev_desc,
 		 disk_partition_t *fs_partition);
 int ext4_read_file(const char *filename, void *buf, int offset, int len);
 int ext4_read_superblock(char *buffer);
+#ifdef CONFIG_EXT4_META_CACHE
+void ext4fs_cache_drop(void);
+void ext4fs_cache_info(void);
+#endif
 #endif
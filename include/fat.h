@@ -23,7 +23,18 @@
 #define DIRENTSPERCLUST	((mydata->clust_size * mydata->sect_size) / \
 			 sizeof(dir_entry))
 
-#define FATBUFBLOCKS	6
+/*
+ * Sectors of the FAT read at a time. A multiple of 3, so that no FAT12
+ * entry straddles two of them.
+ */
+#ifdef CONFIG_FAT_BUFBLOCKS
+#define FATBUFBLOCKS	CONFIG_FAT_BUFBLOCKS
+#else
+#define FATBUFBLOCKS	48
+#endif
+#if FATBUFBLOCKS % 3
+#error "CONFIG_FAT_BUFBLOCKS must be a multiple of 3"
+#endif
 #define FATBUFSIZE	(mydata->sect_size * FATBUFBLOCKS)
 #define FAT12BUFSIZE	((FATBUFSIZE*2)/3)
 #define FAT16BUFSIZE	(FATBUFSIZE/2)
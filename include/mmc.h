@@ -33,6 +33,7 @@
 
 #define MMC_MODE_HS		0x001
 #define MMC_MODE_HS_52MHz	0x010
+#define MMC_MODE_DDR_52MHz	0x020
 #define MMC_MODE_4BIT		0x100
 #define MMC_MODE_8BIT		0x200
 #define MMC_MODE_SPI		0x400
@@ -174,10 +175,14 @@
 
 #define EXT_CSD_CARD_TYPE_26	(1 << 0)	/* Card can run at 26MHz */
 #define EXT_CSD_CARD_TYPE_52	(1 << 1)	/* Card can run at 52MHz */
+#define EXT_CSD_CARD_TYPE_DDR_1_8V	(1 << 2)	/* DDR at 52MHz, 1.8V or 3V I/O */
+#define EXT_CSD_CARD_TYPE_DDR_1_2V	(1 << 3)	/* DDR at 52MHz, 1.2V I/O */
 
 #define EXT_CSD_BUS_WIDTH_1	0	/* Card is in 1 bit mode */
 #define EXT_CSD_BUS_WIDTH_4	1	/* Card is in 4 bit mode */
 #define EXT_CSD_BUS_WIDTH_8	2	/* Card is in 8 bit mode */
+#define EXT_CSD_DDR_BUS_WIDTH_4	5	/* Card is in 4 bit DDR mode */
+#define EXT_CSD_DDR_BUS_WIDTH_8	6	/* Card is in 8 bit DDR mode */
 
 #define EXT_CSD_BOOT_ACK_ENABLE			(1 << 6)
 #define EXT_CSD_BOOT_PARTITION_ENABLE		(1 << 3)
@@ -257,6 +262,16 @@ struct mmc;
 struct mmc_ops {
 	int (*send_cmd)(struct mmc *mmc,
 			struct mmc_cmd *cmd, struct mmc_data *data);
+	/*
+	 * Optional split version of send_cmd: start_cmd issues the command
+	 * and may return while its data is still being transferred,
+	 * wait_cmd then blocks until the transfer has completed. Only one
+	 * command may be outstanding at a time.
+	 */
+	int (*start_cmd)(struct mmc *mmc,
+			 struct mmc_cmd *cmd, struct mmc_data *data);
+	int (*wait_cmd)(struct mmc *mmc,
+			struct mmc_cmd *cmd, struct mmc_data *data);
 	void (*set_ios)(struct mmc *mmc);
 	int (*init)(struct mmc *mmc);
 	int (*getcd)(struct mmc *mmc);
@@ -284,6 +299,7 @@ struct mmc {
 	int high_capacity;
 	uint bus_width;
 	uint clock;
+	uint ddr_mode;		/* 1 if data is clocked on both edges */
 	uint card_caps;
 	uint ocr;
 	uint dsr;
@@ -308,6 +324,17 @@ struct mmc {
 	char init_in_progress;	/* 1 if we have done mmc_start_init() */
 	char preinit;		/* start init as early as possible */
 	uint op_cond_response;	/* the response byte from the last op_cond */
+#ifdef CONFIG_MMC_ASYNC_READ
+	char rd_pending;	/* 1 if rd_cmd is still transferring */
+	struct mmc_cmd rd_cmd;
+	struct mmc_data rd_data;
+#endif
+#ifdef CONFIG_SYS_MMC_READAHEAD
+	void *ra_buf;		/* read-ahead window */
+	lbaint_t ra_start;	/* first block held in ra_buf */
+	lbaint_t ra_blocks;	/* number of blocks held in ra_buf */
+	lbaint_t ra_next;	/* block following the last read */
+#endif
 };
 
 int mmc_register(struct mmc *mmc);
@@ -316,6 +343,17 @@ void mmc_destroy(struct mmc *mmc);
 int mmc_initialize(bd_t *bis);
 int mmc_init(struct mmc *mmc);
 int mmc_read(struct mmc *mmc, u64 src, uchar *dst, int size);
+#ifdef CONFIG_MMC_ASYNC_READ
+/*
+ * Split block read: mmc_bread_start() returns once the host is moving
+ * the data to dst, mmc_bread_wait() completes it. At most cfg->b_max
+ * blocks per call. Any other command waits for the read first. Hosts
+ * without start_cmd do the whole read in mmc_bread_start().
+ */
+int mmc_bread_start(struct mmc *mmc, lbaint_t start, lbaint_t blkcnt,
+		    void *dst);
+int mmc_bread_wait(struct mmc *mmc);
+#endif
 void mmc_set_clock(struct mmc *mmc, uint clock);
 struct mmc *find_mmc_device(int dev_num);
 int mmc_set_dev(int dev_num);
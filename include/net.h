@@ -36,6 +36,13 @@
 # define PKTBUFSRX	4
 #endif
 
+/* The most frames one eth_rx() call takes from a driver with recv_batch */
+#ifdef CONFIG_ETH_RX_BUDGET
+# define ETH_RX_BUDGET	CONFIG_ETH_RX_BUDGET
+#else
+# define ETH_RX_BUDGET	32
+#endif
+
 #define PKTALIGN	ARCH_DMA_MINALIGN
 
 /* IPv4 addresses are always 32 bits in size */
@@ -78,15 +85,31 @@ enum eth_state_t {
 	ETH_STATE_ACTIVE
 };
 
+/*
+ * Checksum offload. A device that checks received checksums passes the
+ * ETH_CSUM_RX_* flags of the ones found good to net_receive_csum(); the
+ * stack does not check those again. With ETH_CSUM_TX the stack leaves the
+ * checksums of outgoing IPv4, UDP, TCP and ICMP packets 0 for the device.
+ */
+#define ETH_CSUM_RX_IP	0x01	/* IPv4 header checksum */
+#define ETH_CSUM_RX_L4	0x02	/* UDP or TCP checksum */
+#define ETH_CSUM_TX	0x04	/* inserts all of the above when sending */
+
 struct eth_device {
 	char name[16];
 	unsigned char enetaddr[6];
 	int iobase;
 	int state;
+	int csum_offload;	/* ETH_CSUM_* done by the hardware */
 
 	int  (*init) (struct eth_device *, bd_t *);
 	int  (*send) (struct eth_device *, void *packet, int length);
 	int  (*recv) (struct eth_device *);
+	/*
+	 * Optional: pass up to budget received frames to NetReceive() in
+	 * one go and return how many there were. Used instead of recv().
+	 */
+	int  (*recv_batch) (struct eth_device *, int budget);
 	void (*halt) (struct eth_device *);
 #ifdef CONFIG_MCAST_TFTP
 	int (*mcast) (struct eth_device *, const u8 *enetaddr, u8 set);
@@ -111,6 +134,13 @@ struct eth_device *eth_get_dev(void)
 {
 	return eth_current;
 }
+
+/* The current device fills in the checksums of the packets we send */
+static inline int eth_csum_tx(void)
+{
+	return eth_current && (eth_current->csum_offload & ETH_CSUM_TX);
+}
+
 extern struct eth_device *eth_get_dev_by_name(const char *devname);
 extern struct eth_device *eth_get_dev_by_index(int index); /* get dev @ index */
 extern int eth_get_dev_index(void);		/* get the device index */
@@ -244,6 +274,7 @@ struct vlan_ethernet_hdr {
 #define PROT_VLAN	0x8100		/* IEEE 802.1q protocol		*/
 
 #define IPPROTO_ICMP	 1	/* Internet Control Message Protocol	*/
+#define IPPROTO_TCP	 6	/* Transmission Control Protocol	*/
 #define IPPROTO_UDP	17	/* User Datagram Protocol		*/
 
 /*
@@ -437,9 +468,38 @@ extern int		NetRestartWrap;		/* Tried all network devices */
 
 enum proto_t {
 	BOOTP, RARP, ARP, TFTPGET, DHCP, PING, DNS, NFS, CDP, NETCONS, SNTP,
-	TFTPSRV, TFTPPUT, LINKLOCAL
+	TFTPSRV, TFTPPUT, LINKLOCAL, WGET
+};
+
+#ifdef CONFIG_CMD_NET_BENCH
+/* What 'net bench' reports for each protocol run */
+struct net_proto_stats {
+	enum proto_t proto;
+	ulong runs;		/* NetLoop() calls */
+	ulong bytes;		/* file bytes loaded */
+	ulong msecs;		/* time spent in NetLoop() */
+	ulong retransmits;
 };
 
+#define NET_STATS_PROTOS	4
+
+struct net_stats {
+	ulong rx_frames;	/* frames passed to NetReceive() */
+	ulong rx_drops;		/* of those, thrown away as bad or not ours */
+	ulong rx_us;		/* time spent in NetReceive() */
+	ulong tx_frames;
+	ulong retransmits;	/* packets sent again after a loss or timeout */
+	int nprotos;
+	struct net_proto_stats protos[NET_STATS_PROTOS];
+};
+
+extern struct net_stats net_stats;
+
+#define NET_STATS_INC(field)	(net_stats.field++)
+#else
+#define NET_STATS_INC(field)	do { } while (0)
+#endif
+
 /* from net/net.c */
 extern char	BootFile[128];			/* Boot File name */
 
@@ -529,6 +589,7 @@ static inline void net_set_state(enum net_loop_state state)
 /* Transmit a packet */
 static inline void NetSendPacket(uchar *pkt, int len)
 {
+	NET_STATS_INC(tx_frames);
 	(void) eth_send(pkt, len);
 }
 
@@ -545,8 +606,40 @@ static inline void NetSendPacket(uchar *pkt, int len)
 extern int NetSendUDPPacket(uchar *ether, IPaddr_t dest, int dport,
 			int sport, int payload_len);
 
+/*
+ * Transmit the IP packet built in "NetTxPacket" after its Ethernet header,
+ * performing ARP request if needed (ether will be populated)
+ *
+ * @param ether Raw packet buffer
+ * @param dest IP address to send the packet to
+ * @param ip_len Length of the packet from the IP header on
+ * @return 0 if sent, 1 if waiting for ARP
+ */
+int net_send_ip_packet(uchar *ether, IPaddr_t dest, int ip_len);
+
+/*
+ * Store len bytes of the file being received at offset from load_addr.
+ * With CONFIG_NET_GUNZIP and 'netgunzip' set, a gzip file is inflated
+ * there instead, which needs the data in order.
+ *
+ * @return 0 if OK, -1 on error (give up the transfer)
+ */
+int net_store(ulong offset, void *src, ulong len);
+
+#ifdef CONFIG_NET_GUNZIP
+/* 1 if the file is to be inflated as it comes in, so must come in order */
+int net_gunzip_wanted(void);
+#else
+static inline int net_gunzip_wanted(void)
+{
+	return 0;
+}
+#endif
+
 /* Processes a received packet */
 extern void NetReceive(uchar *, int);
+/* Same, csum has the ETH_CSUM_RX_* checksums the device found good */
+void net_receive_csum(uchar *inpkt, int len, int csum);
 
 #ifdef CONFIG_NETCONSOLE
 void NcStart(void);
@@ -74,6 +74,7 @@ int os_open(const char *pathname, int flags);
 #define OS_O_RDWR	2
 #define OS_O_MASK	3	/* Mask for read/write flags */
 #define OS_O_CREAT	0100
+#define OS_O_TRUNC	01000
 
 /**
  * Access to the OS close() system call
@@ -276,4 +277,16 @@ int os_read_ram_buf(const char *fname);
  */
 int os_jump_to_image(const void *dest, int size);
 
+/**
+ * Attach to a host tap network device
+ *
+ * The device has to exist and be usable by us, e.g. after
+ * 'ip tuntap add dev tap0 mode tap user $USER'.
+ *
+ * @param ifname	Name of the tap device, e.g. "tap0"
+ * @return non-blocking file descriptor to read and write Ethernet frames
+ * with, or -1 on error
+ */
+int os_tap_open(const char *ifname);
+
 #endif
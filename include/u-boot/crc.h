@@ -14,6 +14,15 @@ uint32_t crc32 (uint32_t, const unsigned char *, uint);
 uint32_t crc32_wd (uint32_t, const unsigned char *, uint, uint);
 uint32_t crc32_no_comp (uint32_t, const unsigned char *, uint);
 
+/**
+ * crc32_combine - CRC32 of two buffers from the CRC32 of each
+ *
+ * @crc1:	CRC32 of the first buffer
+ * @crc2:	CRC32 of the second buffer
+ * @len2:	Length of the second buffer
+ */
+uint32_t crc32_combine(uint32_t crc1, uint32_t crc2, uint len2);
+
 /**
  * crc32_wd_buf - Perform CRC32 on a buffer and return result in buffer
  *
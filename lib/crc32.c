@@ -223,6 +223,72 @@ uint32_t ZEXPORT crc32 (uint32_t crc, const Bytef *p, uInt len)
      return crc32_no_comp(crc ^ 0xffffffffL, p, len) ^ 0xffffffffL;
 }
 
+#define GF2_DIM 32	/* dimension of GF(2) vectors (length of CRC) */
+
+local uint32_t gf2_matrix_times(const uint32_t *mat, uint32_t vec)
+{
+    uint32_t sum = 0;
+
+    while (vec) {
+        if (vec & 1)
+            sum ^= *mat;
+        vec >>= 1;
+        mat++;
+    }
+    return sum;
+}
+
+local void gf2_matrix_square(uint32_t *square, const uint32_t *mat)
+{
+    int n;
+
+    for (n = 0; n < GF2_DIM; n++)
+        square[n] = gf2_matrix_times(mat, mat[n]);
+}
+
+/*
+ * From zlib 1.2: feed len2 zero bytes through crc1 by repeatedly squaring
+ * the operator that appends one zero bit, then add crc2.
+ */
+uint32_t ZEXPORT crc32_combine(uint32_t crc1, uint32_t crc2, uInt len2)
+{
+    uint32_t even[GF2_DIM];	/* even-power-of-two zeros operator */
+    uint32_t odd[GF2_DIM];	/* odd-power-of-two zeros operator */
+    uint32_t row;
+    int n;
+
+    if (len2 == 0)
+        return crc1;
+
+    /* put operator for one zero bit in odd */
+    odd[0] = 0xedb88320UL;	/* CRC-32 polynomial */
+    row = 1;
+    for (n = 1; n < GF2_DIM; n++) {
+        odd[n] = row;
+        row <<= 1;
+    }
+
+    gf2_matrix_square(even, odd);	/* two zero bits */
+    gf2_matrix_square(odd, even);	/* four zero bits */
+
+    /* apply len2 zeros to crc1 (first square puts one zero byte in even) */
+    do {
+        gf2_matrix_square(even, odd);
+        if (len2 & 1)
+            crc1 = gf2_matrix_times(even, crc1);
+        len2 >>= 1;
+        if (len2 == 0)
+            break;
+
+        gf2_matrix_square(odd, even);
+        if (len2 & 1)
+            crc1 = gf2_matrix_times(odd, crc1);
+        len2 >>= 1;
+    } while (len2 != 0);
+
+    return crc1 ^ crc2;
+}
+
 /*
  * Calculate the crc32 checksum triggering the watchdog every 'chunk_sz' bytes
  * of input.
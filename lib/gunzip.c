@@ -102,3 +102,48 @@ int zunzip(void *dst, int dstlen, unsigned char *src, unsigned long *lenp,
 
 	return 0;
 }
+
+/*
+ * Inflate a gzip file fed in pieces as it comes in, e.g. from the network.
+ * zlib parses the gzip header and checks the CRC and length trailer.
+ */
+int gzip_stream_start(struct z_stream_s *s, void *dst, unsigned long dstlen)
+{
+	int r;
+
+	memset(s, 0, sizeof(*s));
+	s->zalloc = gzalloc;
+	s->zfree = gzfree;
+
+	r = inflateInit2(s, 16 + MAX_WBITS);
+	if (r != Z_OK) {
+		printf("Error: inflateInit2() returned %d\n", r);
+		return -1;
+	}
+	s->next_out = dst;
+	s->avail_out = dstlen;
+
+	return 0;
+}
+
+int gzip_stream_feed(struct z_stream_s *s, void *src, unsigned long len)
+{
+	int r;
+
+	s->next_in = src;
+	s->avail_in = len;
+	r = inflate(s, Z_NO_FLUSH);
+	if (r == Z_STREAM_END)
+		return 1;
+	/* Z_BUF_ERROR just means no progress, unless the output is full */
+	if (r == Z_OK || (r == Z_BUF_ERROR && s->avail_out))
+		return 0;
+
+	printf("Error: inflate() returned %d\n", r);
+	return -1;
+}
+
+void gzip_stream_end(struct z_stream_s *s)
+{
+	inflateEnd(s);
+}
@@ -37,6 +37,86 @@ int		NetArpWaitTry;
 static uchar   *NetArpTxPacket;	/* THE ARP transmit packet */
 static uchar	NetArpPacketBuf[PKTSIZE_ALIGN + PKTALIGN];
 
+#ifdef CONFIG_NET_ARP_CACHE
+#ifndef CONFIG_ARP_CACHE_SIZE
+# define CONFIG_ARP_CACHE_SIZE		8
+#endif
+/* Milliseconds an entry is trusted after it was learned */
+#ifndef CONFIG_ARP_CACHE_TIMEOUT
+# define CONFIG_ARP_CACHE_TIMEOUT	300000UL
+#endif
+
+/*
+ * Addresses learned from ARP, kept across NetLoop() calls so that e.g.
+ * "dhcp; tftp; nfs" resolves the server and gateway only once.
+ */
+static struct arp_entry {
+	IPaddr_t ip;		/* 0 == unused */
+	uchar ether[ARP_HLEN];
+	ulong stamp;		/* get_timer() when learned */
+} arp_cache[CONFIG_ARP_CACHE_SIZE];
+
+static int arp_entry_valid(struct arp_entry *e)
+{
+	return e->ip &&
+		get_timer(e->stamp) < CONFIG_ARP_CACHE_TIMEOUT;
+}
+
+static void arp_cache_add(IPaddr_t ip, const uchar *ether)
+{
+	struct arp_entry *e, *victim = &arp_cache[0];
+	int i;
+
+	for (i = 0; i < CONFIG_ARP_CACHE_SIZE; i++) {
+		e = &arp_cache[i];
+		if (e->ip == ip) {
+			victim = e;
+			break;
+		}
+		/* Reuse a stale entry, or else the oldest one */
+		if (!arp_entry_valid(e)) {
+			if (arp_entry_valid(victim))
+				victim = e;
+		} else if (arp_entry_valid(victim) &&
+			   (long)(e->stamp - victim->stamp) < 0) {
+			victim = e;
+		}
+	}
+
+	victim->ip = ip;
+	memcpy(victim->ether, ether, ARP_HLEN);
+	victim->stamp = get_timer(0);
+}
+
+void arp_cache_flush(void)
+{
+	memset(arp_cache, 0, sizeof(arp_cache));
+}
+
+int arp_cache_lookup(IPaddr_t ip, uchar *ether)
+{
+	struct arp_entry *e;
+	int i;
+
+	/* Off our subnet the gateway is the one to talk to */
+	if ((ip & NetOurSubnetMask) != (NetOurIP & NetOurSubnetMask) &&
+	    NetOurGatewayIP)
+		ip = NetOurGatewayIP;
+
+	for (i = 0; i < CONFIG_ARP_CACHE_SIZE; i++) {
+		e = &arp_cache[i];
+		if (e->ip == ip && arp_entry_valid(e)) {
+			memcpy(ether, e->ether, ARP_HLEN);
+			return 1;
+		}
+	}
+
+	return 0;
+}
+#else
+static inline void arp_cache_add(IPaddr_t ip, const uchar *ether) {}
+#endif
+
 void ArpInit(void)
 {
 	/* XXX problem with bss workaround */
@@ -46,6 +126,7 @@ void ArpInit(void)
 	NetArpWaitTxPacketSize = 0;
 	NetArpTxPacket = &NetArpPacketBuf[0] + (PKTALIGN - 1);
 	NetArpTxPacket -= (ulong)NetArpTxPacket % PKTALIGN;
+	arp_cache_flush();
 }
 
 void arp_raw_request(IPaddr_t sourceIP, const uchar *targetEther,
@@ -114,6 +195,7 @@ void ArpTimeoutCheck(void)
 			NetStartAgain();
 		} else {
 			NetArpWaitTimerStart = t;
+			NET_STATS_INC(retransmits);
 			ArpRequest();
 		}
 	}
@@ -140,22 +222,25 @@ void ArpReceive(struct ethernet_hdr *et, struct ip_udp_hdr *ip, int len)
 	arp = (struct arp_hdr *)ip;
 	if (len < ARP_HDR_SIZE) {
 		printf("bad length %d < %d\n", len, ARP_HDR_SIZE);
-		return;
+		goto drop;
 	}
 	if (ntohs(arp->ar_hrd) != ARP_ETHER)
-		return;
+		goto drop;
 	if (ntohs(arp->ar_pro) != PROT_IP)
-		return;
+		goto drop;
 	if (arp->ar_hln != ARP_HLEN)
-		return;
+		goto drop;
 	if (arp->ar_pln != ARP_PLEN)
-		return;
+		goto drop;
 
 	if (NetOurIP == 0)
-		return;
+		goto drop;
 
 	if (NetReadIP(&arp->ar_tpa) != NetOurIP)
-		return;
+		goto drop;
+
+	/* Whoever talks ARP to us, requests included, is worth knowing */
+	arp_cache_add(NetReadIP(&arp->ar_spa), &arp->ar_sha);
 
 	switch (ntohs(arp->ar_op)) {
 	case ARPOP_REQUEST:
@@ -225,12 +310,16 @@ void ArpReceive(struct ethernet_hdr *et, struct ip_udp_hdr *ip, int len)
 			NetArpWaitPacketIP = 0;
 			NetArpWaitTxPacketSize = 0;
 			NetArpWaitPacketMAC = NULL;
-
+			return;
 		}
-		return;
+		break;
 	default:
 		debug("Unexpected ARP opcode 0x%x\n",
 		      ntohs(arp->ar_op));
-		return;
+		break;
 	}
+
+drop:
+	/* Not well formed, or not a request or awaited reply for us */
+	NET_STATS_INC(rx_drops);
 }
@@ -27,4 +27,21 @@ void arp_raw_request(IPaddr_t sourceIP, const uchar *targetEther,
 void ArpTimeoutCheck(void);
 void ArpReceive(struct ethernet_hdr *et, struct ip_udp_hdr *ip, int len);
 
+#ifdef CONFIG_NET_ARP_CACHE
+/*
+ * Look up the Ethernet address for sending to ip, which is that of the
+ * gateway if ip is not on our subnet.
+ *
+ * @return 1 and the address in ether if it is known, else 0
+ */
+int arp_cache_lookup(IPaddr_t ip, uchar *ether);
+void arp_cache_flush(void);
+#else
+static inline int arp_cache_lookup(IPaddr_t ip, uchar *ether)
+{
+	return 0;
+}
+static inline void arp_cache_flush(void) {}
+#endif
+
 #endif /* __ARP_H__ */
@@ -446,6 +446,9 @@ int eth_rx(void)
 	if (!eth_current)
 		return -1;
 
+	if (eth_current->recv_batch)
+		return eth_current->recv_batch(eth_current, ETH_RX_BUDGET);
+
 	return eth_current->recv(eth_current);
 }
 
@@ -89,7 +89,11 @@
 #include <status_led.h>
 #endif
 #include <watchdog.h>
+#include <asm/io.h>
 #include <linux/compiler.h>
+#ifdef CONFIG_NET_GUNZIP
+#include <u-boot/zlib.h>
+#endif
 #include "arp.h"
 #include "bootp.h"
 #include "cdp.h"
@@ -103,10 +107,15 @@
 #if defined(CONFIG_CMD_SNTP)
 #include "sntp.h"
 #endif
+#include "tcp.h"
 #include "tftp.h"
+#include "wget.h"
 
 DECLARE_GLOBAL_DATA_PTR;
 
+/* Leave the stack and some room for it alone */
+#define NET_STACK_ROOM	(1 << 20)
+
 /** BOOTP EXTENTIONS **/
 
 /* Our subnet mask (0=unknown) */
@@ -284,7 +293,213 @@ static void net_clear_handlers(void)
 	net_set_udp_handler(NULL);
 	net_set_arp_handler(NULL);
 	NetSetTimeout(0, NULL);
+#ifdef CONFIG_PROT_TCP
+	tcp_init();
+#endif
+}
+
+#ifdef CONFIG_NET_GUNZIP
+/*
+ * With 'netgunzip' set, a file that starts with the gzip magic is inflated
+ * to load_addr as it comes in rather than stored as is. This needs the
+ * data in order; out of order protocols (NFS with a read window, TFTP
+ * ranges) fall back to in order transfers when net_gunzip_wanted().
+ */
+enum {
+	NET_GZ_OFF,		/* store data as is */
+	NET_GZ_WAIT,		/* look at the first bytes */
+	NET_GZ_INFLATE,
+	NET_GZ_DONE,		/* end of the gzip file seen */
+	NET_GZ_ERROR,
+};
+
+static int net_gz_state;
+static int net_gz_active;	/* net_gz needs gzip_stream_end() */
+static z_stream net_gz;
+static ulong net_gz_in;		/* compressed bytes fed so far */
+
+
+int net_gunzip_wanted(void)
+{
+	return getenv_yesno("netgunzip") == 1;
+}
+
+static void net_gunzip_begin(void)
+{
+	if (net_gz_active)
+		gzip_stream_end(&net_gz);
+	net_gz_active = 0;
+	net_gz_state = net_gunzip_wanted() ? NET_GZ_WAIT : NET_GZ_OFF;
+	net_gz_in = 0;
+}
+
+static int net_gunzip_start(void)
+{
+	if (load_addr + NET_STACK_ROOM >= gd->start_addr_sp) {
+		puts("\nnetgunzip: load address too high\n");
+		return -1;
+	}
+	if (gzip_stream_start(&net_gz, map_sysmem(load_addr, 0),
+			      gd->start_addr_sp - NET_STACK_ROOM -
+			      load_addr))
+		return -1;
+	net_gz_active = 1;
+	net_gz_state = NET_GZ_INFLATE;
+	net_gz_in = 0;
+
+	return 0;
+}
+
+static int net_gunzip_store(ulong offset, uchar *src, ulong len)
+{
+	int r;
+
+	if (net_gz_state == NET_GZ_ERROR)
+		return -1;
+
+	if (net_gz_state == NET_GZ_WAIT) {
+		/* Decide on the first piece of the file */
+		if (offset || len < 2 || src[0] != 0x1f || src[1] != 0x8b) {
+			net_gz_state = NET_GZ_OFF;
+			return 1;
+		}
+		if (net_gunzip_start())
+			return -1;
+		puts("(gunzip) ");
+	}
+
+	/* The transfer started over: so do we */
+	if (!offset && net_gz_in) {
+		gzip_stream_end(&net_gz);
+		net_gz_active = 0;
+		if (net_gunzip_start())
+			return -1;
+	}
+
+	if (offset > net_gz_in) {
+		puts("\nnetgunzip: data out of order\n");
+		return -1;
+	}
+	/* Skip what was fed before, e.g. a retransmission */
+	if (offset + len <= net_gz_in || net_gz_state == NET_GZ_DONE)
+		return 0;
+	src += net_gz_in - offset;
+	len -= net_gz_in - offset;
+
+	r = gzip_stream_feed(&net_gz, src, len);
+	net_gz_in += len;
+	if (r < 0)
+		return -1;
+	if (r > 0)
+		net_gz_state = NET_GZ_DONE;
+
+	return 0;
+}
+
+/* Swap the size of the gzip file for that of its contents */
+static int net_gunzip_finish(void)
+{
+	if (net_gz_state == NET_GZ_OFF || net_gz_state == NET_GZ_WAIT)
+		return 0;
+
+	if (net_gz_state != NET_GZ_DONE) {
+		puts("netgunzip: gzip file incomplete\n");
+		net_gunzip_begin();
+		return -1;
+	}
+
+	printf("Compressed size = %ld (%lx hex)\n", NetBootFileXferSize,
+	       NetBootFileXferSize);
+	NetBootFileXferSize = net_gz.total_out;
+	net_gunzip_begin();
+
+	return 0;
+}
+#else
+static inline void net_gunzip_begin(void) {}
+static inline int net_gunzip_finish(void)
+{
+	return 0;
+}
+#endif
+
+/*
+ * U-Boot's stack, malloc area and code lie between start_addr_sp and
+ * ram_top. Memory outside that, less some room for the stack to grow, may
+ * be loaded to.
+ */
+static int net_store_fits(ulong addr, ulong len)
+{
+	ulong low = gd->start_addr_sp - NET_STACK_ROOM;
+
+	if (addr >= gd->ram_top)
+		return 1;
+
+	return addr <= low && len <= low - addr;
+}
+
+int net_store(ulong offset, void *src, ulong len)
+{
+#ifdef CONFIG_NET_GUNZIP
+	int ret;
+
+	if (net_gz_state != NET_GZ_OFF) {
+		ret = net_gunzip_store(offset, src, len);
+		if (ret <= 0) {
+			if (ret < 0)
+				net_gz_state = NET_GZ_ERROR;
+			return ret;
+		}
+	}
+#endif
+	if (!net_store_fits(load_addr + offset, len)) {
+		printf("\nnet: file too large for 0x%lx, would overwrite "
+		       "U-Boot\n", load_addr);
+		return -1;
+	}
+	(void)memcpy(map_sysmem(load_addr + offset, len), src, len);
+
+	return 0;
+}
+
+#ifdef CONFIG_CMD_NET_BENCH
+struct net_stats net_stats;
+static ulong net_stats_start;		/* when this NetLoop() began */
+static ulong net_stats_retransmits;	/* retransmits by then */
+
+static void net_stats_loop_begin(void)
+{
+	net_stats_start = get_timer(0);
+	net_stats_retransmits = net_stats.retransmits;
+}
+
+/* Add a NetLoop() run to the numbers of its protocol */
+static void net_stats_loop_end(enum proto_t protocol, int ret)
+{
+	struct net_proto_stats *p;
+	int i;
+
+	for (i = 0; i < net_stats.nprotos; i++)
+		if (net_stats.protos[i].proto == protocol)
+			break;
+	if (i == NET_STATS_PROTOS)
+		return;
+
+	p = &net_stats.protos[i];
+	if (i == net_stats.nprotos) {
+		net_stats.nprotos++;
+		p->proto = protocol;
+	}
+	p->runs++;
+	if (ret > 0)
+		p->bytes += ret;
+	p->msecs += get_timer(net_stats_start);
+	p->retransmits += net_stats.retransmits - net_stats_retransmits;
 }
+#else
+static inline void net_stats_loop_begin(void) {}
+static inline void net_stats_loop_end(enum proto_t protocol, int ret) {}
+#endif
 
 static void net_cleanup_loop(void)
 {
@@ -330,6 +545,7 @@ int NetLoop(enum proto_t protocol)
 	NetDevExists = 0;
 	NetTryCount = 1;
 	debug_cond(DEBUG_INT_STATE, "--- NetLoop Entry\n");
+	net_stats_loop_begin();
 
 	bootstage_mark_name(BOOTSTAGE_ID_ETH_START, "eth_start");
 	net_init();
@@ -338,7 +554,7 @@ int NetLoop(enum proto_t protocol)
 		eth_set_current();
 		if (eth_init(bd) < 0) {
 			eth_halt();
-			return -1;
+			goto done;
 		}
 	} else
 		eth_init_state_only(bd);
@@ -361,7 +577,7 @@ restart:
 	case 1:
 		/* network not configured */
 		eth_halt();
-		return -1;
+		goto done;
 
 	case 2:
 		/* network device not configured */
@@ -370,6 +586,7 @@ restart:
 	case 0:
 		NetDevExists = 1;
 		NetBootFileXferSize = 0;
+		net_gunzip_begin();
 		switch (protocol) {
 		case TFTPGET:
 #ifdef CONFIG_CMD_TFTPPUT
@@ -414,6 +631,11 @@ restart:
 			NfsStart();
 			break;
 #endif
+#if defined(CONFIG_CMD_WGET)
+		case WGET:
+			wget_start();
+			break;
+#endif
 #if defined(CONFIG_CMD_CDP)
 		case CDP:
 			CDPStart();
@@ -536,6 +758,11 @@ restart:
 
 		case NETLOOP_SUCCESS:
 			net_cleanup_loop();
+			if (net_gunzip_finish()) {
+				eth_halt();
+				eth_set_last_protocol(BOOTP);
+				goto done;
+			}
 			if (NetBootFileXferSize > 0) {
 				printf("Bytes transferred = %ld (%lx hex)\n",
 					NetBootFileXferSize,
@@ -567,6 +794,7 @@ restart:
 	}
 
 done:
+	net_stats_loop_end(protocol, ret);
 #ifdef CONFIG_USB_KEYBOARD
 	net_busy_flag = 0;
 #endif
@@ -605,6 +833,12 @@ void NetStartAgain(void)
 	} else
 		retry_forever = 1;
 
+	/*
+	 * A cached address may be what went wrong, or the next device is
+	 * on another network: ARP again
+	 */
+	arp_cache_flush();
+
 	if ((!retry_forever) && (NetTryCount >= retrycnt)) {
 		eth_halt();
 		net_set_state(NETLOOP_FAIL);
@@ -696,10 +930,6 @@ NetSetTimeout(ulong iv, thand_f *f)
 int NetSendUDPPacket(uchar *ether, IPaddr_t dest, int dport, int sport,
 		int payload_len)
 {
-	uchar *pkt;
-	int eth_hdr_size;
-	int pkt_hdr_size;
-
 	/* make sure the NetTxPacket is initialized (NetInit() was called) */
 	assert(NetTxPacket != NULL);
 	if (NetTxPacket == NULL)
@@ -709,16 +939,24 @@ int NetSendUDPPacket(uchar *ether, IPaddr_t dest, int dport, int sport,
 	if (dest == 0)
 		dest = 0xFFFFFFFF;
 
+	net_set_udp_header(NetTxPacket + NetEthHdrSize(), dest, dport, sport,
+			   payload_len);
+
+	return net_send_ip_packet(ether, dest, IP_UDP_HDR_SIZE + payload_len);
+}
+
+int net_send_ip_packet(uchar *ether, IPaddr_t dest, int ip_len)
+{
+	int eth_hdr_size;
+
 	/* if broadcast, make the ether address a broadcast and don't do ARP */
 	if (dest == 0xFFFFFFFF)
 		ether = NetBcastAddr;
+	else if (memcmp(ether, NetEtherNullAddr, 6) == 0)
+		/* resolved by an earlier NetLoop(), maybe */
+		arp_cache_lookup(dest, ether);
 
-	pkt = (uchar *)NetTxPacket;
-
-	eth_hdr_size = NetSetEther(pkt, ether, PROT_IP);
-	pkt += eth_hdr_size;
-	net_set_udp_header(pkt, dest, dport, sport, payload_len);
-	pkt_hdr_size = eth_hdr_size + IP_UDP_HDR_SIZE;
+	eth_hdr_size = NetSetEther(NetTxPacket, ether, PROT_IP);
 
 	/* if MAC address was not discovered yet, do an ARP request */
 	if (memcmp(ether, NetEtherNullAddr, 6) == 0) {
@@ -729,7 +967,7 @@ int NetSendUDPPacket(uchar *ether, IPaddr_t dest, int dport, int sport,
 		NetArpWaitPacketMAC = ether;
 
 		/* size of the waiting packet */
-		NetArpWaitTxPacketSize = pkt_hdr_size + payload_len;
+		NetArpWaitTxPacketSize = eth_hdr_size + ip_len;
 
 		/* and do the ARP request */
 		NetArpWaitTry = 1;
@@ -737,22 +975,31 @@ int NetSendUDPPacket(uchar *ether, IPaddr_t dest, int dport, int sport,
 		ArpRequest();
 		return 1;	/* waiting */
 	} else {
-		debug_cond(DEBUG_DEV_PKT, "sending UDP to %pI4/%pM\n",
+		debug_cond(DEBUG_DEV_PKT, "sending IP to %pI4/%pM\n",
 			&dest, ether);
-		NetSendPacket(NetTxPacket, pkt_hdr_size + payload_len);
+		NetSendPacket(NetTxPacket, eth_hdr_size + ip_len);
 		return 0;	/* transmitted */
 	}
 }
 
 #ifdef CONFIG_IP_DEFRAG
 /*
- * This function collects fragments in a single packet, according
- * to the algorithm in RFC815. It returns NULL or the pointer to
- * a complete packet, in static storage
+ * This function collects fragments in one of a few reassembly slots,
+ * according to the algorithm in RFC815, so that fragments of datagrams
+ * arriving interleaved (e.g. pipelined NFS READ replies) all make it.
+ * It returns NULL or the pointer to a complete packet, in static storage
  */
 #ifndef CONFIG_NET_MAXDEFRAG
 #define CONFIG_NET_MAXDEFRAG 16384
 #endif
+/* Number of datagrams reassembled at the same time */
+#ifndef CONFIG_NET_DEFRAG_SLOTS
+#define CONFIG_NET_DEFRAG_SLOTS 4
+#endif
+/* Millisecs after which an incomplete datagram may be dropped */
+#ifndef CONFIG_NET_DEFRAG_TIMEOUT
+#define CONFIG_NET_DEFRAG_TIMEOUT 2000
+#endif
 /*
  * MAXDEFRAG, above, is chosen in the config file and  is real data
  * so we need to add the NFS overhead, which is more than TFTP.
@@ -763,7 +1010,8 @@ int NetSendUDPPacket(uchar *ether, IPaddr_t dest, int dport, int sport,
 static struct rpc_t rpc_specimen;
 #define IP_PKTSIZE (CONFIG_NET_MAXDEFRAG + sizeof(rpc_specimen.u.reply))
 
-#define IP_MAXUDP (IP_PKTSIZE - IP_HDR_SIZE)
+/* The hole descriptors below hold 16 bit offsets, as does ip_len */
+#define IP_MAXUDP (min(IP_PKTSIZE, (size_t)0xffff) - IP_HDR_SIZE)
 
 /*
  * this is the packet being assembled, either data or frag control.
@@ -777,37 +1025,96 @@ struct hole {
 	u16 unused;
 };
 
+/* One datagram being reassembled, identified by its source, id and proto */
+struct defrag_slot {
+	uchar pkt_buff[IP_PKTSIZE] __aligned(PKTALIGN);
+	u16 first_hole;
+	u16 total_len;		/* 0 == slot unused */
+	ulong start;		/* get_timer() of its first fragment */
+};
+
+static struct defrag_slot defrag_slots[CONFIG_NET_DEFRAG_SLOTS];
+
+/*
+ * Find the slot collecting the datagram of this fragment. If there is
+ * none, take an unused or timed out slot, or else recycle the oldest.
+ */
+static struct defrag_slot *defrag_get_slot(struct ip_udp_hdr *ip)
+{
+	struct defrag_slot *slot, *victim = NULL;
+	struct ip_udp_hdr *localip;
+	struct hole *payload;
+	ulong now = get_timer(0);
+	int i;
+
+	for (i = 0; i < CONFIG_NET_DEFRAG_SLOTS; i++) {
+		slot = &defrag_slots[i];
+		localip = (struct ip_udp_hdr *)slot->pkt_buff;
+
+		if (slot->total_len &&
+		    now - slot->start >
+		    CONFIG_NET_DEFRAG_TIMEOUT * CONFIG_SYS_HZ / 1000)
+			slot->total_len = 0;	/* give up on it */
+
+		if (!slot->total_len) {
+			if (!victim || victim->total_len)
+				victim = slot;
+			continue;
+		}
+
+		if (localip->ip_id == ip->ip_id && localip->ip_p == ip->ip_p &&
+		    NetReadIP(&localip->ip_src) == NetReadIP(&ip->ip_src))
+			return slot;
+
+		if (!victim || (victim->total_len &&
+				(long)(slot->start - victim->start) < 0))
+			victim = slot;
+	}
+
+	if (victim->total_len)
+		debug("defrag: dropping datagram id %d\n",
+		      ntohs(((struct ip_udp_hdr *)victim->pkt_buff)->ip_id));
+
+	/* new (or different) packet, reset structs */
+	localip = (struct ip_udp_hdr *)victim->pkt_buff;
+	payload = (struct hole *)(victim->pkt_buff + IP_HDR_SIZE);
+	victim->total_len = 0xffff;
+	victim->first_hole = 0;
+	victim->start = now;
+	payload[0].last_byte = ~0;
+	payload[0].next_hole = 0;
+	payload[0].prev_hole = 0;
+	/* any IP header will work, copy the first we received */
+	memcpy(localip, ip, IP_HDR_SIZE);
+
+	return victim;
+}
+
 static struct ip_udp_hdr *__NetDefragment(struct ip_udp_hdr *ip, int *lenp)
 {
-	static uchar pkt_buff[IP_PKTSIZE] __aligned(PKTALIGN);
-	static u16 first_hole, total_len;
+	struct defrag_slot *slot;
 	struct hole *payload, *thisfrag, *h, *newh;
-	struct ip_udp_hdr *localip = (struct ip_udp_hdr *)pkt_buff;
+	struct ip_udp_hdr *localip;
 	uchar *indata = (uchar *)ip;
 	int offset8, start, len, done = 0;
 	u16 ip_off = ntohs(ip->ip_off);
 
-	/* payload starts after IP header, this fragment is in there */
-	payload = (struct hole *)(pkt_buff + IP_HDR_SIZE);
 	offset8 =  (ip_off & IP_OFFS);
-	thisfrag = payload + offset8;
 	start = offset8 * 8;
 	len = ntohs(ip->ip_len) - IP_HDR_SIZE;
 
-	if (start + len > IP_MAXUDP) /* fragment extends too far */
+	if (start + len > IP_MAXUDP) { /* fragment extends too far */
+		NET_STATS_INC(rx_drops);
 		return NULL;
-
-	if (!total_len || localip->ip_id != ip->ip_id) {
-		/* new (or different) packet, reset structs */
-		total_len = 0xffff;
-		payload[0].last_byte = ~0;
-		payload[0].next_hole = 0;
-		payload[0].prev_hole = 0;
-		first_hole = 0;
-		/* any IP header will work, copy the first we received */
-		memcpy(localip, ip, IP_HDR_SIZE);
 	}
 
+	slot = defrag_get_slot(ip);
+	localip = (struct ip_udp_hdr *)slot->pkt_buff;
+
+	/* payload starts after IP header, this fragment is in there */
+	payload = (struct hole *)(slot->pkt_buff + IP_HDR_SIZE);
+	thisfrag = payload + offset8;
+
 	/*
 	 * What follows is the reassembly algorithm. We use the payload
 	 * array as a linked list of hole descriptors, as each hole starts
@@ -815,10 +1122,11 @@ static struct ip_udp_hdr *__NetDefragment(struct ip_udp_hdr *ip, int *lenp)
 	 * so it is represented as byte count, not as 8-byte blocks.
 	 */
 
-	h = payload + first_hole;
+	h = payload + slot->first_hole;
 	while (h->last_byte < start) {
 		if (!h->next_hole) {
 			/* no hole that far away */
+			NET_STATS_INC(rx_drops);
 			return NULL;
 		}
 		h = payload + h->next_hole;
@@ -827,12 +1135,13 @@ static struct ip_udp_hdr *__NetDefragment(struct ip_udp_hdr *ip, int *lenp)
 	/* last fragment may be 1..7 bytes, the "+7" forces acceptance */
 	if (offset8 + ((len + 7) / 8) <= h - payload) {
 		/* no overlap with holes (dup fragment?) */
+		NET_STATS_INC(rx_drops);
 		return NULL;
 	}
 
 	if (!(ip_off & IP_FLAGS_MFRAG)) {
 		/* no more fragmentss: truncate this (last) hole */
-		total_len = start + len;
+		slot->total_len = start + len;
 		h->last_byte = start + len;
 	}
 
@@ -849,7 +1158,7 @@ static struct ip_udp_hdr *__NetDefragment(struct ip_udp_hdr *ip, int *lenp)
 			done = 1;
 		} else if (!h->prev_hole) {
 			/* first hole */
-			first_hole = h->next_hole;
+			slot->first_hole = h->next_hole;
 			payload[h->next_hole].prev_hole = 0;
 		} else if (!h->next_hole) {
 			/* last hole */
@@ -874,7 +1183,7 @@ static struct ip_udp_hdr *__NetDefragment(struct ip_udp_hdr *ip, int *lenp)
 		if (h->prev_hole)
 			payload[h->prev_hole].next_hole = (h - payload);
 		else
-			first_hole = (h - payload);
+			slot->first_hole = (h - payload);
 
 	} else {
 		/* fragment sits in the middle: split the hole */
@@ -892,8 +1201,13 @@ static struct ip_udp_hdr *__NetDefragment(struct ip_udp_hdr *ip, int *lenp)
 	if (!done)
 		return NULL;
 
-	localip->ip_len = htons(total_len);
-	*lenp = total_len + IP_HDR_SIZE;
+	/*
+	 * Free the slot; the packet stays intact until the next fragment
+	 * comes in, which is after the caller is done with it.
+	 */
+	localip->ip_len = htons(slot->total_len);
+	*lenp = slot->total_len + IP_HDR_SIZE;
+	slot->total_len = 0;
 	return localip;
 }
 
@@ -912,6 +1226,7 @@ static inline struct ip_udp_hdr *NetDefragment(struct ip_udp_hdr *ip, int *lenp)
 	u16 ip_off = ntohs(ip->ip_off);
 	if (!(ip_off & (IP_OFFS | IP_FLAGS_MFRAG)))
 		return ip; /* not a fragment */
+	NET_STATS_INC(rx_drops);
 	return NULL;
 }
 #endif
@@ -948,8 +1263,7 @@ static void receive_icmp(struct ip_udp_hdr *ip, int len,
 	}
 }
 
-void
-NetReceive(uchar *inpkt, int len)
+static void net_receive(uchar *inpkt, int len, int csum)
 {
 	struct ethernet_hdr *et;
 	struct ip_udp_hdr *ip;
@@ -968,8 +1282,10 @@ NetReceive(uchar *inpkt, int len)
 	et = (struct ethernet_hdr *)inpkt;
 
 	/* too small packet? */
-	if (len < ETHER_HDR_SIZE)
+	if (len < ETHER_HDR_SIZE) {
+		NET_STATS_INC(rx_drops);
 		return;
+	}
 
 #ifdef CONFIG_API
 	if (push_packet) {
@@ -1014,16 +1330,20 @@ NetReceive(uchar *inpkt, int len)
 		debug_cond(DEBUG_NET_PKT, "VLAN packet received\n");
 
 		/* too small packet? */
-		if (len < VLAN_ETHER_HDR_SIZE)
+		if (len < VLAN_ETHER_HDR_SIZE) {
+			NET_STATS_INC(rx_drops);
 			return;
+		}
 
 		/* if no VLAN active */
 		if ((ntohs(NetOurVLAN) & VLAN_IDMASK) == VLAN_NONE
 #if defined(CONFIG_CMD_CDP)
 				&& iscdp == 0
 #endif
-				)
+				) {
+			NET_STATS_INC(rx_drops);
 			return;
+		}
 
 		cti = ntohs(vet->vet_tag);
 		vlanid = cti & VLAN_IDMASK;
@@ -1046,8 +1366,10 @@ NetReceive(uchar *inpkt, int len)
 		if (vlanid == VLAN_NONE)
 			vlanid = (mynvlanid & VLAN_IDMASK);
 		/* not matched? */
-		if (vlanid != (myvlanid & VLAN_IDMASK))
+		if (vlanid != (myvlanid & VLAN_IDMASK)) {
+			NET_STATS_INC(rx_drops);
 			return;
+		}
 	}
 
 	switch (eth_proto) {
@@ -1067,11 +1389,13 @@ NetReceive(uchar *inpkt, int len)
 		if (len < IP_UDP_HDR_SIZE) {
 			debug("len bad %d < %lu\n", len,
 				(ulong)IP_UDP_HDR_SIZE);
+			NET_STATS_INC(rx_drops);
 			return;
 		}
 		/* Check the packet length */
 		if (len < ntohs(ip->ip_len)) {
 			debug("len bad %d < %d\n", len, ntohs(ip->ip_len));
+			NET_STATS_INC(rx_drops);
 			return;
 		}
 		len = ntohs(ip->ip_len);
@@ -1079,14 +1403,20 @@ NetReceive(uchar *inpkt, int len)
 			len, ip->ip_hl_v & 0xff);
 
 		/* Can't deal with anything except IPv4 */
-		if ((ip->ip_hl_v & 0xf0) != 0x40)
+		if ((ip->ip_hl_v & 0xf0) != 0x40) {
+			NET_STATS_INC(rx_drops);
 			return;
+		}
 		/* Can't deal with IP options (headers != 20 bytes) */
-		if ((ip->ip_hl_v & 0x0f) > 0x05)
+		if ((ip->ip_hl_v & 0x0f) > 0x05) {
+			NET_STATS_INC(rx_drops);
 			return;
+		}
 		/* Check the Checksum of the header */
-		if (!NetCksumOk((uchar *)ip, IP_HDR_SIZE / 2)) {
+		if (!(csum & ETH_CSUM_RX_IP) &&
+		    !NetCksumOk((uchar *)ip, IP_HDR_SIZE / 2)) {
 			debug("checksum bad\n");
+			NET_STATS_INC(rx_drops);
 			return;
 		}
 		/* If it is not for us, ignore it */
@@ -1095,10 +1425,16 @@ NetReceive(uchar *inpkt, int len)
 #ifdef CONFIG_MCAST_TFTP
 			if (Mcast_addr != dst_ip)
 #endif
+			{
+				NET_STATS_INC(rx_drops);
 				return;
+			}
 		}
 		/* Read source IP address for later use */
 		src_ip = NetReadIP(&ip->ip_src);
+		/* The device saw one fragment, not the whole datagram */
+		if (ip->ip_off & htons(IP_OFFS | IP_FLAGS_MFRAG))
+			csum &= ~ETH_CSUM_RX_L4;
 		/*
 		 * The function returns the unchanged packet if it's not
 		 * a fragment, and either the complete packet or NULL if
@@ -1131,7 +1467,14 @@ NetReceive(uchar *inpkt, int len)
 		if (ip->ip_p == IPPROTO_ICMP) {
 			receive_icmp(ip, len, src_ip, et);
 			return;
+#ifdef CONFIG_PROT_TCP
+		} else if (ip->ip_p == IPPROTO_TCP) {
+			tcp_receive((struct ip_tcp_hdr *)ip, len,
+				    csum & ETH_CSUM_RX_L4);
+			return;
+#endif
 		} else if (ip->ip_p != IPPROTO_UDP) {	/* Only UDP packets */
+			NET_STATS_INC(rx_drops);
 			return;
 		}
 
@@ -1140,7 +1483,7 @@ NetReceive(uchar *inpkt, int len)
 			&dst_ip, &src_ip, len);
 
 #ifdef CONFIG_UDP_CHECKSUM
-		if (ip->udp_xsum != 0) {
+		if (ip->udp_xsum != 0 && !(csum & ETH_CSUM_RX_L4)) {
 			ulong   xsum;
 			ushort *sumptr;
 			ushort  sumlen;
@@ -1176,6 +1519,7 @@ NetReceive(uchar *inpkt, int len)
 			if ((xsum != 0x00000000) && (xsum != 0x0000ffff)) {
 				printf(" UDP wrong checksum %08lx %08x\n",
 					xsum, ntohs(ip->udp_xsum));
+				NET_STATS_INC(rx_drops);
 				return;
 			}
 		}
@@ -1198,9 +1542,32 @@ NetReceive(uchar *inpkt, int len)
 				ntohs(ip->udp_src),
 				ntohs(ip->udp_len) - UDP_HDR_SIZE);
 		break;
+
+	default:
+		NET_STATS_INC(rx_drops);
+		break;
 	}
 }
 
+void net_receive_csum(uchar *inpkt, int len, int csum)
+{
+#ifdef CONFIG_CMD_NET_BENCH
+	ulong start = timer_get_us();
+
+	net_stats.rx_frames++;
+	net_receive(inpkt, len, csum);
+	net_stats.rx_us += timer_get_us() - start;
+#else
+	net_receive(inpkt, len, csum);
+#endif
+}
+
+void
+NetReceive(uchar *inpkt, int len)
+{
+	net_receive_csum(inpkt, len, 0);
+}
+
 
 /**********************************************************************/
 
@@ -1234,6 +1601,9 @@ static int net_check_prereq(enum proto_t protocol)
 #endif
 #if defined(CONFIG_CMD_NFS)
 	case NFS:
+#endif
+#if defined(CONFIG_CMD_WGET)
+	case WGET:
 #endif
 	case TFTPGET:
 	case TFTPPUT:
@@ -1409,7 +1779,8 @@ void net_set_udp_header(uchar *pkt, IPaddr_t dest, int dport, int sport,
 	net_set_ip_header(pkt, dest, NetOurIP);
 	ip->ip_len   = htons(IP_UDP_HDR_SIZE + len);
 	ip->ip_p     = IPPROTO_UDP;
-	ip->ip_sum   = ~NetCksum((uchar *)ip, IP_HDR_SIZE >> 1);
+	if (!eth_csum_tx())
+		ip->ip_sum = ~NetCksum((uchar *)ip, IP_HDR_SIZE >> 1);
 
 	ip->udp_src  = htons(sport);
 	ip->udp_dst  = htons(dport);
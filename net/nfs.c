@@ -42,12 +42,24 @@
 
 static int fs_mounted;
 static unsigned long rpc_id;
-static int nfs_offset = -1;
-static int nfs_len;
+static int nfs_offset = -1;	/* next offset to ask for */
+static int nfs_read_end;	/* file size once known, else -1 */
 static ulong nfs_timeout = NFS_TIMEOUT;
-
-static char dirfh[NFS_FHSIZE];	/* file handle of directory */
-static char filefh[NFS_FHSIZE]; /* file handle of kernel image */
+static int nfs_version;		/* 3, or 2 if the server lacks NFSv3 */
+
+static char dirfh[NFS3_FHSIZE];	/* file handle of directory */
+static unsigned int dirfh_len;
+static char filefh[NFS3_FHSIZE]; /* file handle of kernel image */
+static unsigned int filefh_len;
+
+/* READ requests in flight, matched to their replies by XID */
+static struct {
+	unsigned long id;	/* XID, 0 if the slot is free */
+	int offset;
+	ulong sent;
+} nfs_reads[NFS_READ_WINDOW];
+/* READs in flight at most, one if the data has to come in order */
+static int nfs_read_window;
 
 static enum net_loop_state nfs_download_state;
 static IPaddr_t NfsServerIP;
@@ -93,7 +105,8 @@ store_block(uchar *src, unsigned offset, unsigned len)
 	} else
 #endif /* CONFIG_SYS_DIRECT_FLASH_NFS */
 	{
-		(void)memcpy((void *)(load_addr + offset), src, len);
+		if (net_store(offset, src, len))
+			return -1;
 	}
 
 	if (NetBootFileXferSize < (offset+len))
@@ -171,10 +184,42 @@ static long *rpc_add_credentials(long *p)
 	return p;
 }
 
+/* Add a file handle: fixed size in NFSv2, counted in NFSv3 */
+static uint32_t *rpc_add_fh(uint32_t *p, const char *fh, unsigned int len)
+{
+	if (nfs_version == 3) {
+		*p++ = htonl(len);
+		if (len & 3)
+			*(p + len / 4) = 0;
+		memcpy(p, fh, len);
+		p += (len + 3) / 4;
+	} else {
+		memcpy(p, fh, NFS_FHSIZE);
+		p += NFS_FHSIZE / 4;
+	}
+
+	return p;
+}
+
+/* Take a file handle out of a MNT or LOOKUP reply, 0 if it is invalid */
+static unsigned int rpc_get_fh(char *fh, uint32_t *data)
+{
+	unsigned int len = NFS_FHSIZE;
+
+	if (nfs_version == 3) {
+		len = ntohl(*data++);
+		if (!len || len > NFS3_FHSIZE)
+			return 0;
+	}
+	memcpy(fh, data, len);
+
+	return len;
+}
+
 /**************************************************************************
 RPC_LOOKUP - Lookup RPC Port numbers
 **************************************************************************/
-static void
+static unsigned long
 rpc_req(int rpc_prog, int rpc_proc, uint32_t *data, int datalen)
 {
 	struct rpc_t pkt;
@@ -182,13 +227,21 @@ rpc_req(int rpc_prog, int rpc_proc, uint32_t *data, int datalen)
 	uint32_t *p;
 	int pktlen;
 	int sport;
+	int vers;
+
+	if (rpc_prog == PROG_PORTMAP)
+		vers = 2;		/* portmapper is version 2 */
+	else if (rpc_prog == PROG_MOUNT)
+		vers = nfs_version == 3 ? 3 : 2;
+	else
+		vers = nfs_version;
 
 	id = ++rpc_id;
 	pkt.u.call.id = htonl(id);
 	pkt.u.call.type = htonl(MSG_CALL);
 	pkt.u.call.rpcvers = htonl(2);	/* use RPC version 2 */
 	pkt.u.call.prog = htonl(rpc_prog);
-	pkt.u.call.vers = htonl(2);	/* portmapper is version 2 */
+	pkt.u.call.vers = htonl(vers);
 	pkt.u.call.proc = htonl(rpc_proc);
 	p = (uint32_t *)&(pkt.u.call.data);
 
@@ -209,6 +262,8 @@ rpc_req(int rpc_prog, int rpc_proc, uint32_t *data, int datalen)
 
 	NetSendUDPPacket(NetServerEther, NfsServerIP, sport, NfsOurPort,
 		pktlen);
+
+	return id;
 }
 
 /**************************************************************************
@@ -295,8 +350,7 @@ nfs_readlink_req(void)
 	p = &(data[0]);
 	p = (uint32_t *)rpc_add_credentials((long *)p);
 
-	memcpy(p, filefh, NFS_FHSIZE);
-	p += (NFS_FHSIZE / 4);
+	p = rpc_add_fh(p, filefh, filefh_len);
 
 	len = (uint32_t *)p - (uint32_t *)&(data[0]);
 
@@ -319,8 +373,7 @@ nfs_lookup_req(char *fname)
 	p = &(data[0]);
 	p = (uint32_t *)rpc_add_credentials((long *)p);
 
-	memcpy(p, dirfh, NFS_FHSIZE);
-	p += (NFS_FHSIZE / 4);
+	p = rpc_add_fh(p, dirfh, dirfh_len);
 	*p++ = htonl(fnamelen);
 	if (fnamelen & 3)
 		*(p + fnamelen / 4) = 0;
@@ -329,13 +382,14 @@ nfs_lookup_req(char *fname)
 
 	len = (uint32_t *)p - (uint32_t *)&(data[0]);
 
-	rpc_req(PROG_NFS, NFS_LOOKUP, data, len);
+	rpc_req(PROG_NFS, nfs_version == 3 ? NFS3PROC_LOOKUP : NFS_LOOKUP,
+		data, len);
 }
 
 /**************************************************************************
 NFS_READ - Read File on NFS Server
 **************************************************************************/
-static void
+static unsigned long
 nfs_read_req(int offset, int readlen)
 {
 	uint32_t data[1024];
@@ -345,15 +399,72 @@ nfs_read_req(int offset, int readlen)
 	p = &(data[0]);
 	p = (uint32_t *)rpc_add_credentials((long *)p);
 
-	memcpy(p, filefh, NFS_FHSIZE);
-	p += (NFS_FHSIZE / 4);
+	p = rpc_add_fh(p, filefh, filefh_len);
+	if (nfs_version == 3)
+		*p++ = 0;		/* upper half of the 64 bit offset */
 	*p++ = htonl(offset);
 	*p++ = htonl(readlen);
-	*p++ = 0;
+	if (nfs_version == 2)
+		*p++ = 0;		/* totalcount, unused */
 
 	len = (uint32_t *)p - (uint32_t *)&(data[0]);
 
-	rpc_req(PROG_NFS, NFS_READ, data, len);
+	return rpc_req(PROG_NFS, NFS_READ, data, len);
+}
+
+/* (Re)send the READs in flight that have been waiting for at least age ms */
+static void nfs_read_resend(ulong age)
+{
+	int i;
+
+	for (i = 0; i < NFS_READ_WINDOW; i++) {
+		if (!nfs_reads[i].id || get_timer(nfs_reads[i].sent) < age)
+			continue;
+		nfs_reads[i].id = nfs_read_req(nfs_reads[i].offset,
+					       NFS_READ_SIZE);
+		nfs_reads[i].sent = get_timer(0);
+		NET_STATS_INC(retransmits);
+	}
+}
+
+/* Use the free slots to ask for the following parts of the file */
+static void nfs_read_fill(void)
+{
+	int i;
+
+	for (i = 0; i < nfs_read_window; i++) {
+		if (nfs_reads[i].id)
+			continue;
+		if (nfs_read_end >= 0 && nfs_offset >= nfs_read_end)
+			break;
+		nfs_reads[i].offset = nfs_offset;
+		nfs_reads[i].id = nfs_read_req(nfs_offset, NFS_READ_SIZE);
+		nfs_reads[i].sent = get_timer(0);
+		nfs_offset += NFS_READ_SIZE;
+	}
+}
+
+static void nfs_read_start(void)
+{
+	memset(nfs_reads, 0, sizeof(nfs_reads));
+	nfs_offset = 0;
+	nfs_read_end = -1;
+	nfs_read_window = net_gunzip_wanted() ? 1 : NFS_READ_WINDOW;
+}
+
+/* All of the file is in once its size is known and nothing is missing */
+static int nfs_read_done(void)
+{
+	int i;
+
+	if (nfs_read_end < 0)
+		return 0;
+
+	for (i = 0; i < NFS_READ_WINDOW; i++)
+		if (nfs_reads[i].id)
+			return 0;
+
+	return 1;
 }
 
 /**************************************************************************
@@ -367,10 +478,10 @@ NfsSend(void)
 
 	switch (NfsState) {
 	case STATE_PRCLOOKUP_PROG_MOUNT_REQ:
-		rpc_lookup_req(PROG_MOUNT, 1);
+		rpc_lookup_req(PROG_MOUNT, nfs_version == 3 ? 3 : 1);
 		break;
 	case STATE_PRCLOOKUP_PROG_NFS_REQ:
-		rpc_lookup_req(PROG_NFS, 2);
+		rpc_lookup_req(PROG_NFS, nfs_version);
 		break;
 	case STATE_MOUNT_REQ:
 		nfs_mount_req(nfs_path);
@@ -382,7 +493,8 @@ NfsSend(void)
 		nfs_lookup_req(nfs_filename);
 		break;
 	case STATE_READ_REQ:
-		nfs_read_req(nfs_offset, nfs_len);
+		nfs_read_resend(0);
+		nfs_read_fill();
 		break;
 	case STATE_READLINK_REQ:
 		nfs_readlink_req();
@@ -445,8 +557,10 @@ nfs_mount_reply(uchar *pkt, unsigned len)
 	    rpc_pkt.u.reply.data[0])
 		return -1;
 
+	dirfh_len = rpc_get_fh(dirfh, rpc_pkt.u.reply.data + 1);
+	if (!dirfh_len)
+		return -1;
 	fs_mounted = 1;
-	memcpy(dirfh, rpc_pkt.u.reply.data + 1, NFS_FHSIZE);
 
 	return 0;
 }
@@ -496,7 +610,9 @@ nfs_lookup_reply(uchar *pkt, unsigned len)
 	    rpc_pkt.u.reply.data[0])
 		return -1;
 
-	memcpy(filefh, rpc_pkt.u.reply.data + 1, NFS_FHSIZE);
+	filefh_len = rpc_get_fh(filefh, rpc_pkt.u.reply.data + 1);
+	if (!filefh_len)
+		return -1;
 
 	return 0;
 }
@@ -505,6 +621,7 @@ static int
 nfs_readlink_reply(uchar *pkt, unsigned len)
 {
 	struct rpc_t rpc_pkt;
+	uint32_t *p;
 	int rlen;
 
 	debug("%s\n", __func__);
@@ -522,17 +639,19 @@ nfs_readlink_reply(uchar *pkt, unsigned len)
 	    rpc_pkt.u.reply.data[0])
 		return -1;
 
-	rlen = ntohl(rpc_pkt.u.reply.data[1]); /* new path length */
+	p = &rpc_pkt.u.reply.data[1];
+	if (nfs_version == 3 && ntohl(*p++))
+		p += NFS3_FATTR_WORDS;	/* symlink attributes */
+	rlen = ntohl(*p++); /* new path length */
 
-	if (*((char *)&(rpc_pkt.u.reply.data[2])) != '/') {
+	if (*((char *)p) != '/') {
 		int pathlen;
 		strcat(nfs_path, "/");
 		pathlen = strlen(nfs_path);
-		memcpy(nfs_path + pathlen, (uchar *)&(rpc_pkt.u.reply.data[2]),
-			rlen);
+		memcpy(nfs_path + pathlen, (uchar *)p, rlen);
 		nfs_path[pathlen + rlen] = 0;
 	} else {
-		memcpy(nfs_path, (uchar *)&(rpc_pkt.u.reply.data[2]), rlen);
+		memcpy(nfs_path, (uchar *)p, rlen);
 		nfs_path[rlen] = 0;
 	}
 	return 0;
@@ -542,16 +661,23 @@ static int
 nfs_read_reply(uchar *pkt, unsigned len)
 {
 	struct rpc_t rpc_pkt;
-	int rlen;
+	uint32_t *p;
+	int rlen, offset, eof, i;
 
 	debug("%s\n", __func__);
 
-	memcpy((uchar *)&rpc_pkt, pkt, sizeof(rpc_pkt.u.reply));
+	memcpy((uchar *)&rpc_pkt, pkt,
+	       min(len, (unsigned)sizeof(rpc_pkt.u.reply)));
 
-	if (ntohl(rpc_pkt.u.reply.id) > rpc_id)
-		return -NFS_RPC_ERR;
-	else if (ntohl(rpc_pkt.u.reply.id) < rpc_id)
+	/* Replies come in any order, find the READ this one answers */
+	for (i = 0; i < NFS_READ_WINDOW; i++)
+		if (nfs_reads[i].id &&
+		    nfs_reads[i].id == ntohl(rpc_pkt.u.reply.id))
+			break;
+	if (i == NFS_READ_WINDOW)
 		return -NFS_RPC_DROP;
+	nfs_reads[i].id = 0;
+	offset = nfs_reads[i].offset;
 
 	if (rpc_pkt.u.reply.rstatus  ||
 	    rpc_pkt.u.reply.verifier ||
@@ -564,17 +690,43 @@ nfs_read_reply(uchar *pkt, unsigned len)
 		return -ntohl(rpc_pkt.u.reply.data[0]);
 	}
 
-	if ((nfs_offset != 0) && !((nfs_offset) %
+	if ((offset != 0) && !((offset) %
 			(NFS_READ_SIZE / 2 * 10 * HASHES_PER_LINE)))
 		puts("\n\t ");
-	if (!(nfs_offset % ((NFS_READ_SIZE / 2) * 10)))
+	if (!(offset % ((NFS_READ_SIZE / 2) * 10)))
 		putc('#');
 
-	rlen = ntohl(rpc_pkt.u.reply.data[18]);
-	if (store_block((uchar *)pkt + sizeof(rpc_pkt.u.reply),
-			nfs_offset, rlen))
+	if (nfs_version == 3) {
+		p = &rpc_pkt.u.reply.data[1];
+		if (ntohl(*p++))
+			p += NFS3_FATTR_WORDS;	/* file attributes */
+		rlen = ntohl(*p++);
+		eof = ntohl(*p++);
+		p++;			/* length of the data, same as rlen */
+	} else {
+		p = &rpc_pkt.u.reply.data[18];
+		rlen = ntohl(*p++);
+		eof = 0;
+	}
+
+	if ((uchar *)p - (uchar *)&rpc_pkt + rlen > len ||
+	    rlen > NFS_READ_SIZE)
+		return -9999;
+	if (store_block(pkt + ((uchar *)p - (uchar *)&rpc_pkt), offset, rlen))
 		return -9999;
 
+	/*
+	 * A short read is the end of the file, and so is an empty one in
+	 * NFSv2. READs beyond it that are still in flight can be dropped.
+	 */
+	if (eof || rlen < NFS_READ_SIZE) {
+		if (nfs_read_end < 0 || offset + rlen < nfs_read_end)
+			nfs_read_end = offset + rlen;
+		for (i = 0; i < NFS_READ_WINDOW; i++)
+			if (nfs_reads[i].offset >= nfs_read_end)
+				nfs_reads[i].id = 0;
+	}
+
 	return rlen;
 }
 
@@ -592,6 +744,9 @@ NfsTimeout(void)
 		puts("T ");
 		NetSetTimeout(nfs_timeout + NFS_TIMEOUT * NfsTimeoutCount,
 			      NfsTimeout);
+		/* READs sent again are counted one by one */
+		if (NfsState != STATE_READ_REQ)
+			NET_STATS_INC(retransmits);
 		NfsSend();
 	}
 }
@@ -611,14 +766,26 @@ NfsHandler(uchar *pkt, unsigned dest, IPaddr_t sip, unsigned src, unsigned len)
 	case STATE_PRCLOOKUP_PROG_MOUNT_REQ:
 		if (rpc_lookup_reply(PROG_MOUNT, pkt, len) == -NFS_RPC_DROP)
 			break;
-		NfsState = STATE_PRCLOOKUP_PROG_NFS_REQ;
+		/* The portmapper answers port 0 for versions it lacks */
+		if (!NfsSrvMountPort && nfs_version == 3) {
+			debug("No MOUNT v3, trying NFSv2\n");
+			nfs_version = 2;
+		} else {
+			NfsState = STATE_PRCLOOKUP_PROG_NFS_REQ;
+		}
 		NfsSend();
 		break;
 
 	case STATE_PRCLOOKUP_PROG_NFS_REQ:
 		if (rpc_lookup_reply(PROG_NFS, pkt, len) == -NFS_RPC_DROP)
 			break;
-		NfsState = STATE_MOUNT_REQ;
+		if (!NfsSrvNfsPort && nfs_version == 3) {
+			debug("No NFSv3, trying NFSv2\n");
+			nfs_version = 2;
+			NfsState = STATE_PRCLOOKUP_PROG_MOUNT_REQ;
+		} else {
+			NfsState = STATE_MOUNT_REQ;
+		}
 		NfsSend();
 		break;
 
@@ -660,8 +827,7 @@ NfsHandler(uchar *pkt, unsigned dest, IPaddr_t sip, unsigned src, unsigned len)
 			NfsSend();
 		} else {
 			NfsState = STATE_READ_REQ;
-			nfs_offset = 0;
-			nfs_len = NFS_READ_SIZE;
+			nfs_read_start();
 			NfsSend();
 		}
 		break;
@@ -686,16 +852,19 @@ NfsHandler(uchar *pkt, unsigned dest, IPaddr_t sip, unsigned src, unsigned len)
 
 	case STATE_READ_REQ:
 		rlen = nfs_read_reply(pkt, len);
+		if (rlen == -NFS_RPC_DROP)
+			break;
 		NetSetTimeout(nfs_timeout, NfsTimeout);
-		if (rlen > 0) {
-			nfs_offset += rlen;
-			NfsSend();
+		if (rlen >= 0 && !nfs_read_done()) {
+			/* Retry what got lost while the others came in */
+			nfs_read_resend(nfs_timeout);
+			nfs_read_fill();
 		} else if ((rlen == -NFSERR_ISDIR) || (rlen == -NFSERR_INVAL)) {
 			/* symbolic link */
 			NfsState = STATE_READLINK_REQ;
 			NfsSend();
 		} else {
-			if (!rlen)
+			if (rlen >= 0)
 				nfs_download_state = NETLOOP_SUCCESS;
 			NfsState = STATE_UMOUNT_REQ;
 			NfsSend();
@@ -775,6 +944,7 @@ NfsStart(void)
 
 	NfsTimeoutCount = 0;
 	NfsState = STATE_PRCLOOKUP_PROG_MOUNT_REQ;
+	nfs_version = 3;
 
 	/*NfsOurPort = 4096 + (get_ticks() % 3072);*/
 	/*FIX ME !!!*/
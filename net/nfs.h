@@ -25,7 +25,11 @@
 #define NFS_READLINK    5
 #define NFS_READ        6
 
+#define NFS3PROC_LOOKUP 3
+
 #define NFS_FHSIZE      32
+#define NFS3_FHSIZE     64
+#define NFS3_FATTR_WORDS 21	/* fattr3 in a post_op_attr */
 
 #define NFSERR_PERM     1
 #define NFSERR_NOENT    2
@@ -34,16 +38,33 @@
 #define NFSERR_INVAL    22
 
 /* Block size used for NFS read accesses.  A RPC reply packet (including  all
- * headers) must fit within a single Ethernet frame to avoid fragmentation.
- * However, if CONFIG_IP_DEFRAG is set, the config file may want to use a
- * bigger value. In any case, most NFS servers are optimized for a power of 2.
+ * headers) must fit within a single Ethernet frame to avoid fragmentation,
+ * unless CONFIG_IP_DEFRAG is set. Then the default is 8 KiB, the largest
+ * NFSv2 allows, which NFSv3 servers take as well and which fits the default
+ * CONFIG_NET_MAXDEFRAG. In any case, most NFS servers are optimized for a
+ * power of 2.
  */
 #ifdef CONFIG_NFS_READ_SIZE
 #define NFS_READ_SIZE CONFIG_NFS_READ_SIZE
+#elif defined(CONFIG_IP_DEFRAG)
+#define NFS_READ_SIZE 8192
 #else
 #define NFS_READ_SIZE 1024 /* biggest power of two that fits Ether frame */
 #endif
 
+/* Number of READ requests kept in flight at the same time.  The replies
+ * may come back in any order.  When they need IP fragments, the window
+ * cannot usefully be larger than what the IP reassembly can hold.
+ */
+#ifdef CONFIG_NFS_READ_WINDOW
+#define NFS_READ_WINDOW CONFIG_NFS_READ_WINDOW
+#elif defined(CONFIG_IP_DEFRAG) && defined(CONFIG_NET_DEFRAG_SLOTS) && \
+	CONFIG_NET_DEFRAG_SLOTS < 4
+#define NFS_READ_WINDOW CONFIG_NET_DEFRAG_SLOTS
+#else
+#define NFS_READ_WINDOW 4
+#endif
+
 #define NFS_MAXLINKDEPTH 16
 
 struct rpc_t {
@@ -65,7 +86,7 @@ struct rpc_t {
 			uint32_t verifier;
 			uint32_t v2;
 			uint32_t astatus;
-			uint32_t data[19];
+			uint32_t data[26];	/* up to NFSv3 READ data */
 		} reply;
 	} u;
 };
@@ -0,0 +1,407 @@
+/*
+ * Minimal TCP client
+ *
+ * One actively opened connection at a time. Received data is handed to
+ * the user in order as it comes in, and the user copies it away at once,
+ * so nothing here limits the receive window. With window scaling the
+ * sender can keep far more than 64 KiB in flight. Out of order segments
+ * are dropped and answered with a duplicate ACK (there is no SACK),
+ * which makes the sender retransmit from the hole.
+ *
+ * The sending side is just enough for a request: a single segment may
+ * be waiting for its ACK at any time.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <net.h>
+#include <asm/unaligned.h>
+#include "tcp.h"
+
+/* Millisecs without progress before we retransmit or repeat our ACK */
+#define TCP_TIMEOUT		1000UL
+#ifndef	CONFIG_NET_RETRY_COUNT
+# define TCP_RETRY_COUNT	10
+#else
+# define TCP_RETRY_COUNT	(CONFIG_NET_RETRY_COUNT * 2)
+#endif
+
+/* Largest segment we accept, what fits in an Ethernet frame */
+#define TCP_MSS			1460
+/* What we send if the peer does not tell us its MSS (RFC 1122) */
+#define TCP_DEFAULT_MSS		536
+
+#ifdef CONFIG_TCP_RCV_WND
+#define TCP_RCV_WND		CONFIG_TCP_RCV_WND
+#else
+#define TCP_RCV_WND		(128 << 10)
+#endif
+
+#define TCP_OPT_END		0
+#define TCP_OPT_NOP		1
+#define TCP_OPT_MSS		2
+#define TCP_OPT_WSCALE		3
+
+/* Sequence number comparison, modulo 2^32 */
+#define tcp_before(a, b)	((s32)((a) - (b)) < 0)
+
+enum tcp_state {
+	TCP_CLOSED,
+	TCP_SYN_SENT,
+	TCP_ESTABLISHED,
+	TCP_FIN_WAIT,		/* we sent our FIN */
+	TCP_CLOSE_WAIT,		/* the peer sent its FIN, we did not yet */
+	TCP_LAST_ACK,		/* the peer sent its FIN, then we did */
+};
+
+static enum tcp_state tcp_state;
+static tcp_handler_f *tcp_handler;
+static IPaddr_t tcp_remote_ip;
+static int tcp_remote_port;
+static int tcp_local_port;
+static uchar tcp_ether[6];
+static int tcp_timeout_count;
+static int tcp_peer_fin;	/* 1 once the FIN of the peer is in */
+
+static u32 tcp_snd_una;		/* oldest unacknowledged sequence number */
+static u32 tcp_snd_nxt;		/* next sequence number to send */
+static u32 tcp_rcv_nxt;		/* next sequence number expected */
+static u32 tcp_rcv_acked;	/* tcp_rcv_nxt in the last segment sent */
+static int tcp_rcv_wscale;	/* shift of the window we advertise */
+static unsigned tcp_snd_mss;	/* largest segment the peer accepts */
+
+/* The segment that may be waiting for its ACK, kept for retransmission */
+static uchar tcp_tx_flags;
+static uchar tcp_tx_data[TCP_MSS];
+static unsigned tcp_tx_len;
+
+/* Internet checksum over the TCP pseudo header and len bytes of segment */
+static ushort tcp_checksum(struct ip_tcp_hdr *ip, unsigned len)
+{
+	ushort *p = (ushort *)&ip->ip_src;
+	ulong xsum = 0;
+	ushort tail = 0;
+	unsigned i;
+
+	/* Source and destination address, protocol and TCP length */
+	for (i = 0; i < 4; i++)
+		xsum += p[i];
+	xsum += htons(IPPROTO_TCP);
+	xsum += htons(len);
+
+	p = &ip->tcp_src;
+	for (i = 0; i < len / 2; i++)
+		xsum += p[i];
+	if (len & 1) {
+		memcpy(&tail, &p[i], 1);
+		xsum += tail;
+	}
+
+	while (xsum >> 16)
+		xsum = (xsum & 0xffff) + (xsum >> 16);
+
+	return ~xsum & 0xffff;
+}
+
+static void tcp_send_segment(uchar flags, const void *data, unsigned len,
+			     u32 seq)
+{
+	struct ip_tcp_hdr *ip;
+	unsigned hlen = TCP_HDR_SIZE;
+	ulong wnd = TCP_RCV_WND >> tcp_rcv_wscale;
+	uchar *opt;
+
+	ip = (struct ip_tcp_hdr *)(NetTxPacket + NetEthHdrSize());
+	opt = (uchar *)(ip + 1);
+
+	if (flags & TCP_SYN) {
+		/* Our MSS, and the scale TCP_RCV_WND needs */
+		*opt++ = TCP_OPT_MSS;
+		*opt++ = 4;
+		*opt++ = TCP_MSS >> 8;
+		*opt++ = TCP_MSS & 0xff;
+		*opt++ = TCP_OPT_NOP;
+		*opt++ = TCP_OPT_WSCALE;
+		*opt++ = 3;
+		*opt++ = tcp_rcv_wscale;
+		hlen += 8;
+		/* The window in a SYN is never scaled */
+		wnd = TCP_RCV_WND;
+	}
+	memcpy(opt, data, len);
+
+	net_set_ip_header((uchar *)ip, tcp_remote_ip, NetOurIP);
+	ip->ip_len   = htons(IP_HDR_SIZE + hlen + len);
+	ip->ip_p     = IPPROTO_TCP;
+
+	ip->tcp_src  = htons(tcp_local_port);
+	ip->tcp_dst  = htons(tcp_remote_port);
+	put_unaligned_be32(seq, &ip->tcp_seq);
+	put_unaligned_be32(flags & TCP_ACK ? tcp_rcv_nxt : 0, &ip->tcp_ack);
+	ip->tcp_hlen = (hlen / 4) << 4;
+	ip->tcp_flags = flags;
+	ip->tcp_win  = htons(min(wnd, 0xffffUL));
+	ip->tcp_xsum = 0;
+	ip->tcp_urp  = 0;
+	if (!eth_csum_tx()) {
+		ip->ip_sum   = ~NetCksum((uchar *)ip, IP_HDR_SIZE >> 1);
+		ip->tcp_xsum = tcp_checksum(ip, hlen + len);
+	}
+
+	tcp_rcv_acked = tcp_rcv_nxt;
+	net_send_ip_packet(tcp_ether, tcp_remote_ip, IP_HDR_SIZE + hlen + len);
+}
+
+/* (Re)send what is not acknowledged yet, or else just an ACK */
+static void tcp_output(void)
+{
+	if (tcp_snd_una != tcp_snd_nxt)
+		tcp_send_segment(tcp_tx_flags, tcp_tx_data, tcp_tx_len,
+				 tcp_snd_una);
+	else
+		tcp_send_segment(TCP_ACK, NULL, 0, tcp_snd_nxt);
+}
+
+static void tcp_fail(void)
+{
+	tcp_state = TCP_CLOSED;
+	NetSetTimeout(0, NULL);
+	tcp_handler(TCP_EV_ERROR, NULL, 0);
+}
+
+static void tcp_timeout(void)
+{
+	if (++tcp_timeout_count > TCP_RETRY_COUNT) {
+		puts("\nTCP: retry count exceeded\n");
+		tcp_fail();
+	} else {
+		puts("T ");
+		NetSetTimeout(TCP_TIMEOUT, tcp_timeout);
+		NET_STATS_INC(retransmits);
+		tcp_output();
+	}
+}
+
+/* Pick up the MSS and window scale options of the SYN of the peer */
+static void tcp_parse_options(uchar *opt, int len)
+{
+	int wscale = -1;
+	unsigned mss;
+
+	while (len > 0 && *opt != TCP_OPT_END) {
+		if (*opt == TCP_OPT_NOP) {
+			opt++;
+			len--;
+			continue;
+		}
+		if (len < 2 || opt[1] < 2 || opt[1] > len)
+			break;
+
+		switch (opt[0]) {
+		case TCP_OPT_MSS:
+			mss = (opt[2] << 8) | opt[3];
+			if (opt[1] == 4 && mss >= 64)
+				tcp_snd_mss = min(mss, (unsigned)TCP_MSS);
+			break;
+		case TCP_OPT_WSCALE:
+			if (opt[1] == 3)
+				wscale = opt[2];
+			break;
+		}
+
+		len -= opt[1];
+		opt += opt[1];
+	}
+
+	/* Windows are only scaled if both sides asked for it (RFC 7323) */
+	if (wscale < 0)
+		tcp_rcv_wscale = 0;
+}
+
+void tcp_init(void)
+{
+	tcp_state = TCP_CLOSED;
+}
+
+void tcp_start(IPaddr_t dest, int dport, tcp_handler_f *handler)
+{
+	tcp_handler = handler;
+	tcp_remote_ip = dest;
+	tcp_remote_port = dport;
+	/* Use a pseudo-random port */
+	tcp_local_port = 1024 + (get_timer(0) % 3072);
+	memset(tcp_ether, 0, 6);
+	tcp_timeout_count = 0;
+	tcp_peer_fin = 0;
+
+	tcp_snd_mss = TCP_DEFAULT_MSS;
+	for (tcp_rcv_wscale = 0; (TCP_RCV_WND >> tcp_rcv_wscale) > 0xffff;
+	     tcp_rcv_wscale++)
+		;
+
+	tcp_rcv_nxt = 0;
+	tcp_snd_una = (u32)get_ticks();
+	tcp_snd_nxt = tcp_snd_una + 1;
+	tcp_tx_flags = TCP_SYN;
+	tcp_tx_len = 0;
+	tcp_state = TCP_SYN_SENT;
+
+	NetSetTimeout(TCP_TIMEOUT, tcp_timeout);
+	tcp_output();
+}
+
+int tcp_send(const void *data, unsigned len)
+{
+	if (tcp_state != TCP_ESTABLISHED && tcp_state != TCP_CLOSE_WAIT)
+		return -1;
+	if (tcp_snd_una != tcp_snd_nxt || len > tcp_snd_mss)
+		return -1;
+
+	memcpy(tcp_tx_data, data, len);
+	tcp_tx_len = len;
+	tcp_tx_flags = TCP_ACK | TCP_PSH;
+	tcp_snd_nxt += len;
+	tcp_output();
+
+	return 0;
+}
+
+void tcp_close(void)
+{
+	if (tcp_state == TCP_ESTABLISHED)
+		tcp_state = TCP_FIN_WAIT;
+	else if (tcp_state == TCP_CLOSE_WAIT)
+		tcp_state = TCP_LAST_ACK;
+	else
+		return;
+
+	/* The FIN goes out with any data still waiting for its ACK */
+	if (tcp_snd_una == tcp_snd_nxt) {
+		tcp_tx_flags = TCP_ACK;
+		tcp_tx_len = 0;
+	}
+	tcp_tx_flags |= TCP_FIN;
+	tcp_snd_nxt++;
+	tcp_output();
+}
+
+void tcp_receive(struct ip_tcp_hdr *ip, unsigned len, int csum_ok)
+{
+	unsigned hlen, plen;
+	u32 seq, ack;
+	uchar flags;
+	uchar *data;
+
+	if (tcp_state == TCP_CLOSED || len < IP_TCP_HDR_SIZE)
+		goto drop;
+	if (ntohs(ip->tcp_dst) != tcp_local_port ||
+	    ntohs(ip->tcp_src) != tcp_remote_port ||
+	    NetReadIP(&ip->ip_src) != tcp_remote_ip)
+		goto drop;
+
+	len -= IP_HDR_SIZE;
+	hlen = (ip->tcp_hlen >> 4) * 4;
+	if (hlen < TCP_HDR_SIZE || hlen > len)
+		goto drop;
+	if (!csum_ok && tcp_checksum(ip, len)) {
+		debug("TCP: bad checksum\n");
+		goto drop;
+	}
+
+	seq = get_unaligned_be32(&ip->tcp_seq);
+	ack = get_unaligned_be32(&ip->tcp_ack);
+	flags = ip->tcp_flags;
+	data = (uchar *)&ip->tcp_src + hlen;
+	plen = len - hlen;
+
+	if (flags & TCP_RST) {
+		/* Only believe a reset that fits the connection */
+		if (tcp_state == TCP_SYN_SENT ?
+		    (flags & TCP_ACK) && ack == tcp_snd_nxt :
+		    seq == tcp_rcv_nxt) {
+			puts("\nTCP: connection reset\n");
+			tcp_fail();
+		}
+		return;
+	}
+
+	if (tcp_state == TCP_SYN_SENT) {
+		if ((flags & (TCP_SYN | TCP_ACK)) != (TCP_SYN | TCP_ACK) ||
+		    ack != tcp_snd_nxt)
+			return;
+
+		tcp_parse_options((uchar *)(ip + 1), hlen - TCP_HDR_SIZE);
+		tcp_rcv_nxt = seq + 1;
+		tcp_snd_una = ack;
+		tcp_state = TCP_ESTABLISHED;
+		tcp_timeout_count = 0;
+		NetSetTimeout(TCP_TIMEOUT, tcp_timeout);
+
+		/* The handler may well send its request with our ACK */
+		tcp_handler(TCP_EV_CONNECTED, NULL, 0);
+		if (tcp_state != TCP_CLOSED && tcp_rcv_acked != tcp_rcv_nxt)
+			tcp_send_segment(TCP_ACK, NULL, 0, tcp_snd_nxt);
+		return;
+	}
+
+	if ((flags & TCP_ACK) && tcp_before(tcp_snd_una, ack) &&
+	    !tcp_before(tcp_snd_nxt, ack)) {
+		tcp_snd_una = ack;
+		tcp_timeout_count = 0;
+		NetSetTimeout(TCP_TIMEOUT, tcp_timeout);
+	}
+
+	/* Skip what we already have of a retransmitted segment */
+	if (tcp_before(seq, tcp_rcv_nxt) && tcp_rcv_nxt - seq <= plen) {
+		data += tcp_rcv_nxt - seq;
+		plen -= tcp_rcv_nxt - seq;
+		seq = tcp_rcv_nxt;
+	}
+
+	if (seq != tcp_rcv_nxt) {
+		/*
+		 * Beyond a hole, or old: tell the sender what we are still
+		 * waiting for. Old bare ACKs need no answer.
+		 */
+		if (plen || (flags & (TCP_SYN | TCP_FIN)))
+			tcp_send_segment(TCP_ACK, NULL, 0, tcp_snd_nxt);
+		return;
+	}
+
+	if (plen || (flags & TCP_FIN)) {
+		tcp_timeout_count = 0;
+		NetSetTimeout(TCP_TIMEOUT, tcp_timeout);
+	}
+
+	if (plen && !tcp_peer_fin) {
+		tcp_rcv_nxt += plen;
+		tcp_handler(TCP_EV_DATA, data, plen);
+	}
+
+	if ((flags & TCP_FIN) && !tcp_peer_fin && tcp_state != TCP_CLOSED) {
+		tcp_rcv_nxt++;
+		tcp_peer_fin = 1;
+		if (tcp_state == TCP_ESTABLISHED)
+			tcp_state = TCP_CLOSE_WAIT;
+		tcp_handler(TCP_EV_FIN, NULL, 0);
+	}
+
+	if (tcp_state == TCP_CLOSED)
+		return;
+
+	if (tcp_rcv_acked != tcp_rcv_nxt)
+		tcp_send_segment(TCP_ACK, NULL, 0, tcp_snd_nxt);
+
+	/* Both FINs are in and ours is acknowledged */
+	if ((tcp_state == TCP_FIN_WAIT || tcp_state == TCP_LAST_ACK) &&
+	    tcp_peer_fin && tcp_snd_una == tcp_snd_nxt) {
+		tcp_state = TCP_CLOSED;
+		NetSetTimeout(0, NULL);
+		tcp_handler(TCP_EV_CLOSED, NULL, 0);
+	}
+	return;
+
+drop:
+	NET_STATS_INC(rx_drops);
+}
@@ -0,0 +1,80 @@
+/*
+ * Minimal TCP client, enough to fetch a file from a web server
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef __TCP_H__
+#define __TCP_H__
+
+/*
+ *	Internet Protocol (IP) + TCP header, without options.
+ *	The packet is only 16 bit aligned, so the 32 bit fields have to be
+ *	accessed with get_unaligned_be32() / put_unaligned_be32().
+ */
+struct ip_tcp_hdr {
+	uchar		ip_hl_v;	/* header length and version	*/
+	uchar		ip_tos;		/* type of service		*/
+	ushort		ip_len;		/* total length			*/
+	ushort		ip_id;		/* identification		*/
+	ushort		ip_off;		/* fragment offset field	*/
+	uchar		ip_ttl;		/* time to live			*/
+	uchar		ip_p;		/* protocol			*/
+	ushort		ip_sum;		/* checksum			*/
+	IPaddr_t	ip_src;		/* Source IP address		*/
+	IPaddr_t	ip_dst;		/* Destination IP address	*/
+	ushort		tcp_src;	/* TCP source port		*/
+	ushort		tcp_dst;	/* TCP destination port		*/
+	u32		tcp_seq;	/* Sequence number		*/
+	u32		tcp_ack;	/* Acknowledgment number	*/
+	uchar		tcp_hlen;	/* Header length in words << 4	*/
+	uchar		tcp_flags;	/* TCP_FIN, TCP_SYN, ...	*/
+	ushort		tcp_win;	/* Receive window		*/
+	ushort		tcp_xsum;	/* Checksum			*/
+	ushort		tcp_urp;	/* Urgent pointer		*/
+};
+
+#define IP_TCP_HDR_SIZE		(sizeof(struct ip_tcp_hdr))
+#define TCP_HDR_SIZE		(IP_TCP_HDR_SIZE - IP_HDR_SIZE)
+
+#define TCP_FIN		0x01
+#define TCP_SYN		0x02
+#define TCP_RST		0x04
+#define TCP_PSH		0x08
+#define TCP_ACK		0x10
+
+/* What the connection tells its user */
+enum tcp_event {
+	TCP_EV_CONNECTED,	/* handshake done, tcp_send() may be used */
+	TCP_EV_DATA,		/* in order data from the peer */
+	TCP_EV_FIN,		/* the peer will not send any more data */
+	TCP_EV_CLOSED,		/* both sides are done */
+	TCP_EV_ERROR,		/* reset by the peer, or timed out */
+};
+
+typedef void tcp_handler_f(enum tcp_event event, uchar *data, unsigned len);
+
+/* Forget any connection; segments for it are ignored from now on */
+void tcp_init(void);
+
+/* Open a connection; the handler gets TCP_EV_CONNECTED or TCP_EV_ERROR */
+void tcp_start(IPaddr_t dest, int dport, tcp_handler_f *handler);
+
+/*
+ * Queue len bytes for sending. Only one segment can be outstanding, so
+ * this fails while earlier data has not been acknowledged yet.
+ *
+ * @return 0 if OK, -1 on error
+ */
+int tcp_send(const void *data, unsigned len);
+
+/* We are done sending; the handler gets TCP_EV_CLOSED once both are */
+void tcp_close(void);
+
+/*
+ * Processes a received IP packet carrying TCP, len is the IP length.
+ * csum_ok is set if the device has already checked the TCP checksum.
+ */
+void tcp_receive(struct ip_tcp_hdr *ip, unsigned len, int csum_ok);
+
+#endif /* __TCP_H__ */
@@ -9,37 +9,18 @@
 #include <common.h>
 #include <command.h>
 #include <net.h>
+#include <asm/io.h>
 #include "tftp.h"
 #include "bootp.h"
 #ifdef CONFIG_SYS_DIRECT_FLASH_TFTP
 #include <flash.h>
 #endif
 
-/* Well known TFTP port # */
-#define WELL_KNOWN_PORT	69
 /* Millisecs to timeout for lost pkt */
 #define TIMEOUT		5000UL
-#ifndef	CONFIG_NET_RETRY_COUNT
-/* # of timeouts before giving up */
-# define TIMEOUT_COUNT	10
-#else
-# define TIMEOUT_COUNT  (CONFIG_NET_RETRY_COUNT * 2)
-#endif
-/* Number of "loading" hashes per line (for checking the image size) */
-#define HASHES_PER_LINE	65
-
-/*
- *	TFTP operations.
- */
-#define TFTP_RRQ	1
-#define TFTP_WRQ	2
-#define TFTP_DATA	3
-#define TFTP_ACK	4
-#define TFTP_ERROR	5
-#define TFTP_OACK	6
 
 static ulong TftpTimeoutMSecs = TIMEOUT;
-static int TftpTimeoutCountMax = TIMEOUT_COUNT;
+static int TftpTimeoutCountMax = TFTP_TIMEOUT_COUNT;
 static ulong time_start;   /* Record time we started tftp */
 
 /*
@@ -52,7 +33,7 @@ static ulong time_start;   /* Record time we started tftp */
  * non-standard timeout behavior when initiating a TFTP transfer.
  */
 ulong TftpRRQTimeoutMSecs = TIMEOUT;
-int TftpRRQTimeoutCountMax = TIMEOUT_COUNT;
+int TftpRRQTimeoutCountMax = TFTP_TIMEOUT_COUNT;
 
 enum {
 	TFTP_ERR_UNDEFINED           = 0,
@@ -100,8 +81,6 @@ static int	TftpFinalBlock;	/* 1 if we have sent the last block */
 #define STATE_RECV_WRQ	6
 #define STATE_SEND_WRQ	7
 
-/* default TFTP block size */
-#define TFTP_BLOCK_SIZE		512
 /* sequence number is 16 bit */
 #define TFTP_SEQUENCE_SIZE	((ulong)(1<<16))
 
@@ -130,6 +109,21 @@ static char tftp_filename[MAX_LEN];
 static unsigned short TftpBlkSize = TFTP_BLOCK_SIZE;
 static unsigned short TftpBlkSizeOption = TFTP_MTU_BLOCKSIZE;
 
+/*
+ * RFC 7440 windowsize: number of DATA blocks the server sends before it
+ * waits for an ACK. 1 is plain lock-step TFTP and is not negotiated.
+ */
+#ifdef CONFIG_TFTP_WINDOWSIZE
+#define TFTP_WINDOWSIZE CONFIG_TFTP_WINDOWSIZE
+#else
+#define TFTP_WINDOWSIZE 1
+#endif
+
+static unsigned short TftpWindowSize = 1;
+static unsigned short TftpWindowSizeOption = TFTP_WINDOWSIZE;
+static unsigned short TftpWindowCount;	/* blocks since our last ACK */
+static int TftpWindowGap;		/* 1 once a lost block was ACKed */
+
 #ifdef CONFIG_MCAST_TFTP
 #include <malloc.h>
 #define MTFTP_BITMAPSIZE	0x1000
@@ -184,7 +178,10 @@ store_block(int block, uchar *src, unsigned len)
 	} else
 #endif /* CONFIG_SYS_DIRECT_FLASH_TFTP */
 	{
-		(void)memcpy((void *)(load_addr + offset), src, len);
+		if (net_store(offset, src, len)) {
+			net_set_state(NETLOOP_FAIL);
+			return;
+		}
 	}
 #ifdef CONFIG_MCAST_TFTP
 	if (Multicast)
@@ -222,7 +219,7 @@ static int load_block(unsigned block, uchar *dst, unsigned len)
 	ulong tosend = len;
 
 	tosend = min(NetBootFileXferSize - offset, tosend);
-	(void)memcpy(dst, (void *)(save_addr + offset), tosend);
+	(void)memcpy(dst, map_sysmem(save_addr + offset, tosend), tosend);
 	debug("%s: block=%d, offset=%ld, len=%d, tosend=%ld\n", __func__,
 		block, offset, len, tosend);
 	return tosend;
@@ -249,7 +246,7 @@ static void show_block_marker(void)
 	{
 		if (((TftpBlock - 1) % 10) == 0)
 			putc('#');
-		else if ((TftpBlock % (10 * HASHES_PER_LINE)) == 0)
+		else if ((TftpBlock % (10 * TFTP_HASHES_PER_LINE)) == 0)
 			puts("\n\t ");
 	}
 }
@@ -291,6 +288,18 @@ static void update_block_number(void)
 }
 
 /* The TFTP get or put is complete */
+void tftp_done(ulong start)
+{
+	start = get_timer(start);
+	if (start > 0) {
+		puts("\n\t ");	/* Line up with "Loading: " */
+		print_size(NetBootFileXferSize /
+			start * 1000, "/s");
+	}
+	puts("\ndone\n");
+	net_set_state(NETLOOP_SUCCESS);
+}
+
 static void tftp_complete(void)
 {
 #ifdef CONFIG_TFTP_TSIZE
@@ -300,14 +309,7 @@ static void tftp_complete(void)
 		TftpNumchars++;
 	}
 #endif
-	time_start = get_timer(time_start);
-	if (time_start > 0) {
-		puts("\n\t ");	/* Line up with "Loading: " */
-		print_size(NetBootFileXferSize /
-			time_start * 1000, "/s");
-	}
-	puts("\ndone\n");
-	net_set_state(NETLOOP_SUCCESS);
+	tftp_done(time_start);
 }
 
 static void
@@ -359,6 +361,9 @@ TftpSend(void)
 		/* try for more effic. blk size */
 		pkt += sprintf((char *)pkt, "blksize%c%d%c",
 				0, TftpBlkSizeOption, 0);
+		if (TftpWindowSizeOption > 1 && !TftpWriting)
+			pkt += sprintf((char *)pkt, "windowsize%c%d%c",
+					0, TftpWindowSizeOption, 0);
 #ifdef CONFIG_MCAST_TFTP
 		/* Check all preconditions before even trying the option */
 		if (!ProhibitMcast) {
@@ -385,6 +390,8 @@ TftpSend(void)
 
 	case STATE_RECV_WRQ:
 	case STATE_DATA:
+		/* The server starts a new window after every ACK */
+		TftpWindowCount = 0;
 		xp = pkt;
 		s = (ushort *)pkt;
 		s[0] = htons(TFTP_ACK);
@@ -528,6 +535,16 @@ TftpHandler(uchar *pkt, unsigned dest, IPaddr_t sip, unsigned src,
 				debug("Blocksize ack: %s, %d\n",
 					(char *)pkt+i+8, TftpBlkSize);
 			}
+			if (strcmp((char *)pkt+i, "windowsize") == 0) {
+				TftpWindowSize = (unsigned short)
+					simple_strtoul((char *)pkt+i+11, NULL,
+						       10);
+				if (TftpWindowSize < 1 ||
+				    TftpWindowSize > TftpWindowSizeOption)
+					TftpWindowSize = 1;
+				debug("Windowsize ack: %s, %d\n",
+					(char *)pkt+i+11, TftpWindowSize);
+			}
 #ifdef CONFIG_TFTP_TSIZE
 			if (strcmp((char *)pkt+i, "tsize") == 0) {
 				TftpTsize = simple_strtoul((char *)pkt+i+6,
@@ -539,6 +556,9 @@ TftpHandler(uchar *pkt, unsigned dest, IPaddr_t sip, unsigned src,
 		}
 #ifdef CONFIG_MCAST_TFTP
 		parse_multicast_oack((char *)pkt, len-1);
+		/* Passive clients never ACK, so windows make no sense here */
+		if (Multicast)
+			TftpWindowSize = 1;
 		if ((Multicast) && (!MasterClient))
 			TftpState = STATE_DATA;	/* passive.. */
 		else
@@ -558,6 +578,25 @@ TftpHandler(uchar *pkt, unsigned dest, IPaddr_t sip, unsigned src,
 		len -= 2;
 		TftpBlock = ntohs(*(__be16 *)pkt);
 
+		/*
+		 * With several blocks in flight, anything but the block
+		 * after the last one stored means some were lost or arrived
+		 * out of order. ACK the last good block once, so the server
+		 * resends the window from there, and drop the rest of the
+		 * broken window. The timeout covers a lost ACK.
+		 */
+		if (TftpWindowSize > 1 && TftpState == STATE_DATA &&
+		    TftpBlock != (unsigned short)(TftpLastBlock + 1)) {
+			TftpBlock = TftpLastBlock;
+			if (!TftpWindowGap) {
+				TftpWindowGap = 1;
+				NET_STATS_INC(retransmits);
+				TftpSend();
+			}
+			break;
+		}
+		TftpWindowGap = 0;
+
 		update_block_number();
 
 		if (TftpState == STATE_SEND_RRQ)
@@ -593,7 +632,7 @@ TftpHandler(uchar *pkt, unsigned dest, IPaddr_t sip, unsigned src,
 		}
 
 		TftpLastBlock = TftpBlock;
-		TftpTimeoutCountMax = TIMEOUT_COUNT;
+		TftpTimeoutCountMax = TFTP_TIMEOUT_COUNT;
 		NetSetTimeout(TftpTimeoutMSecs, TftpTimeout);
 
 		store_block(TftpBlock - 1, pkt + 2, len);
@@ -627,7 +666,9 @@ TftpHandler(uchar *pkt, unsigned dest, IPaddr_t sip, unsigned src,
 			}
 		}
 #endif
-		TftpSend();
+		/* Only the last block of a window, or of the file, is ACKed */
+		if (++TftpWindowCount >= TftpWindowSize || len < TftpBlkSize)
+			TftpSend();
 
 #ifdef CONFIG_MCAST_TFTP
 		if (Multicast) {
@@ -679,8 +720,11 @@ TftpTimeout(void)
 	} else {
 		puts("T ");
 		NetSetTimeout(TftpTimeoutMSecs, TftpTimeout);
-		if (TftpState != STATE_RECV_WRQ)
+		TftpWindowGap = 0;
+		if (TftpState != STATE_RECV_WRQ) {
+			NET_STATS_INC(retransmits);
 			TftpSend();
+		}
 	}
 }
 
@@ -701,6 +745,12 @@ void TftpStart(enum proto_t protocol)
 	if (ep != NULL)
 		TftpTimeoutMSecs = simple_strtol(ep, NULL, 10);
 
+	ep = getenv("tftpwindowsize");
+	if (ep != NULL)
+		TftpWindowSizeOption = simple_strtol(ep, NULL, 10);
+	if (TftpWindowSizeOption < 1)
+		TftpWindowSizeOption = 1;
+
 	if (TftpTimeoutMSecs < 1000) {
 		printf("TFTP timeout (%ld ms) too low, "
 			"set minimum = 1000 ms\n",
@@ -708,8 +758,8 @@ void TftpStart(enum proto_t protocol)
 		TftpTimeoutMSecs = 1000;
 	}
 
-	debug("TFTP blocksize = %i, timeout = %ld ms\n",
-		TftpBlkSizeOption, TftpTimeoutMSecs);
+	debug("TFTP blocksize = %i, windowsize = %i, timeout = %ld ms\n",
+		TftpBlkSizeOption, TftpWindowSizeOption, TftpTimeoutMSecs);
 
 	TftpRemoteIP = NetServerIP;
 	if (BootFile[0] == '\0') {
@@ -737,6 +787,14 @@ void TftpStart(enum proto_t protocol)
 		}
 	}
 
+#ifdef CONFIG_TFTP_RANGES
+	/* Ranges come in out of order, which netgunzip can not take */
+	if (protocol == TFTPGET && !net_gunzip_wanted() &&
+	    !tftp_ranges_start(TftpRemoteIP, tftp_filename, TftpBlkSizeOption,
+			       TftpTimeoutMSecs))
+		return;
+#endif
+
 	printf("Using %s device\n", eth_get_name());
 	printf("TFTP %s server %pI4; our IP address is %pI4",
 #ifdef CONFIG_CMD_TFTPPUT
@@ -790,7 +848,7 @@ void TftpStart(enum proto_t protocol)
 #ifdef CONFIG_CMD_TFTPPUT
 	net_set_icmp_handler(icmp_handler);
 #endif
-	TftpRemotePort = WELL_KNOWN_PORT;
+	TftpRemotePort = TFTP_WELL_KNOWN_PORT;
 	TftpTimeoutCount = 0;
 	/* Use a pseudo-random port unless a specific port is set */
 	TftpOurPort = 1024 + (get_timer(0) % 3072);
@@ -807,8 +865,10 @@ void TftpStart(enum proto_t protocol)
 
 	/* zero out server ether in case the server ip has changed */
 	memset(NetServerEther, 0, 6);
-	/* Revert TftpBlkSize to dflt */
+	/* Revert TftpBlkSize and TftpWindowSize to dflt */
 	TftpBlkSize = TFTP_BLOCK_SIZE;
+	TftpWindowSize = 1;
+	TftpWindowGap = 0;
 #ifdef CONFIG_MCAST_TFTP
 	mcast_cleanup();
 #endif
@@ -832,15 +892,16 @@ TftpStartServer(void)
 
 	puts("Loading: *\b");
 
-	TftpTimeoutCountMax = TIMEOUT_COUNT;
+	TftpTimeoutCountMax = TFTP_TIMEOUT_COUNT;
 	TftpTimeoutCount = 0;
 	TftpTimeoutMSecs = TIMEOUT;
 	NetSetTimeout(TftpTimeoutMSecs, TftpTimeout);
 
-	/* Revert TftpBlkSize to dflt */
+	/* Revert TftpBlkSize and TftpWindowSize to dflt */
 	TftpBlkSize = TFTP_BLOCK_SIZE;
+	TftpWindowSize = 1;
 	TftpBlock = 0;
-	TftpOurPort = WELL_KNOWN_PORT;
+	TftpOurPort = TFTP_WELL_KNOWN_PORT;
 
 #ifdef CONFIG_TFTP_TSIZE
 	TftpTsize = 0;
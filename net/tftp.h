@@ -10,6 +10,29 @@
 #ifndef __TFTP_H__
 #define __TFTP_H__
 
+/*
+ *	TFTP operations.
+ */
+#define TFTP_RRQ	1
+#define TFTP_WRQ	2
+#define TFTP_DATA	3
+#define TFTP_ACK	4
+#define TFTP_ERROR	5
+#define TFTP_OACK	6
+
+/* Well known TFTP port # */
+#define TFTP_WELL_KNOWN_PORT	69
+/* default TFTP block size */
+#define TFTP_BLOCK_SIZE		512
+#ifndef	CONFIG_NET_RETRY_COUNT
+/* # of timeouts before giving up */
+# define TFTP_TIMEOUT_COUNT	10
+#else
+# define TFTP_TIMEOUT_COUNT	(CONFIG_NET_RETRY_COUNT * 2)
+#endif
+/* Number of "loading" hashes per line (for checking the image size) */
+#define TFTP_HASHES_PER_LINE	65
+
 /**********************************************************************/
 /*
  *	Global functions and variables.
@@ -17,11 +40,25 @@
 
 /* tftp.c */
 void TftpStart(enum proto_t protocol);	/* Begin TFTP get/put */
+/* Print the rate since get_timer() was start and end the transfer */
+void tftp_done(ulong start);
 
 #ifdef CONFIG_CMD_TFTPSRV
 extern void TftpStartServer(void);	/* Wait for incoming TFTP put */
 #endif
 
+#ifdef CONFIG_TFTP_RANGES
+/*
+ * Fetch filename in byte ranges, in parallel, from the servers listed in
+ * 'tftpservers' (or several times from server). blksize and timeout_ms
+ * are the settings of the plain TFTP client.
+ *
+ * @return 0 if started, -1 if not set up for more than one range
+ */
+int tftp_ranges_start(IPaddr_t server, const char *filename, int blksize,
+		      ulong timeout_ms);
+#endif
+
 extern ulong TftpRRQTimeoutMSecs;
 extern int TftpRRQTimeoutCountMax;
 
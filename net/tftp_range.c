@@ -0,0 +1,484 @@
+/*
+ * Fetch one file over several TFTP transfers at once
+ *
+ * The file is split into byte ranges, each read by its own transfer from
+ * one of the servers in 'tftpservers', or several times from the same
+ * server. The first transfer learns the file size (tsize); the others
+ * ask the server to start at their range with the "offset" option, which
+ * is not part of any RFC. A server that does not acknowledge it has its
+ * range handed to the transfer before it.
+ *
+ * Transfers are started one after the other as the previous one gets its
+ * OACK, and no transfer is ACKed before all are started. That way there
+ * is never more than one ARP request, and one packet waiting for it, in
+ * flight. A transfer held for longer than the timeout, or whose server
+ * sends its OACK again, is ACKed right away so the server does not give
+ * up on it.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <net.h>
+#include "tftp.h"
+
+#ifndef CONFIG_TFTP_OFFSET_OPTION
+#error "CONFIG_TFTP_RANGES needs CONFIG_TFTP_OFFSET_OPTION"
+#endif
+
+#define TFTP_RANGES_MAX		8
+/* How often the transfers are checked for lost packets */
+#define TFTP_RANGES_TICK	100UL
+/*
+ * Blocks come in out of order, so progress goes by bytes, not block
+ * numbers as in tftp.c: one '#' per HASH_BYTES stored.
+ */
+#define HASH_BYTES		(64 << 10)
+
+enum {
+	RANGE_UNUSED,
+	RANGE_SEND_RRQ,		/* RRQ sent, waiting for the OACK */
+	RANGE_HELD,		/* got the OACK, not ACKed yet */
+	RANGE_DATA,
+	RANGE_DONE,
+};
+
+struct tftp_range {
+	int state;
+	IPaddr_t server;
+	uchar ether[6];
+	int our_port;
+	int remote_port;
+	ulong start;		/* first byte of the range */
+	ulong end;		/* byte after the range, ~0 if unknown */
+	ulong base;		/* file offset of block 1 */
+	int blksize;
+	ulong block;		/* last block received, not wrapped */
+	ulong last;		/* get_timer() at the last progress */
+	int timeouts;
+	int plain;		/* read from the start, without "offset" */
+};
+
+static struct tftp_range tftp_ranges[TFTP_RANGES_MAX];
+static int tftp_nranges;
+static int tftp_nservers;
+static int tftp_starting;	/* transfer whose RRQ is outstanding */
+static const char *tftp_range_file;
+static int tftp_range_blksize;
+static ulong tftp_range_timeout;
+static ulong tftp_range_bytes;
+static int tftp_range_hashes;
+static ulong tftp_range_time_start;
+
+static void range_send_rrq(struct tftp_range *r)
+{
+	uchar *pkt, *xp;
+
+	xp = pkt = NetTxPacket + NetEthHdrSize() + IP_UDP_HDR_SIZE;
+	*(__be16 *)pkt = htons(TFTP_RRQ);
+	pkt += 2;
+	pkt += sprintf((char *)pkt, "%s%coctet%c", tftp_range_file, 0, 0);
+	pkt += sprintf((char *)pkt, "timeout%c%lu%c", 0,
+		       tftp_range_timeout / 1000, 0);
+	pkt += sprintf((char *)pkt, "blksize%c%d%c", 0, tftp_range_blksize,
+		       0);
+	if (r == tftp_ranges)
+		pkt += sprintf((char *)pkt, "tsize%c0%c", 0, 0);
+	else if (!r->plain)
+		pkt += sprintf((char *)pkt, "offset%c%lu%c", 0, r->start, 0);
+
+	r->state = RANGE_SEND_RRQ;
+	r->last = get_timer(0);
+	NetSendUDPPacket(r->ether, r->server, TFTP_WELL_KNOWN_PORT,
+			 r->our_port, pkt - xp);
+}
+
+static void range_send_ack(struct tftp_range *r)
+{
+	__be16 *s = (__be16 *)(NetTxPacket + NetEthHdrSize() +
+			       IP_UDP_HDR_SIZE);
+
+	s[0] = htons(TFTP_ACK);
+	s[1] = htons(r->block);
+	NetSendUDPPacket(r->ether, r->server, r->remote_port, r->our_port, 4);
+}
+
+/* Tell the server we are done with a transfer before its end */
+static void range_send_error(struct tftp_range *r, const char *msg)
+{
+	uchar *pkt, *xp;
+
+	xp = pkt = NetTxPacket + NetEthHdrSize() + IP_UDP_HDR_SIZE;
+	*(__be16 *)pkt = htons(TFTP_ERROR);
+	*(__be16 *)(pkt + 2) = htons(0);
+	pkt += 4;
+	pkt += sprintf((char *)pkt, "%s", msg) + 1;
+	NetSendUDPPacket(r->ether, r->server, r->remote_port, r->our_port,
+			 pkt - xp);
+}
+
+static void range_complete(void)
+{
+	NetSetTimeout(0, NULL);
+	tftp_done(tftp_range_time_start);
+}
+
+static void range_fail(const char *msg)
+{
+	int i;
+
+	printf("\nTFTP error: %s\n", msg);
+	/* Let the other servers stop sending */
+	for (i = 0; i < tftp_nranges; i++)
+		if (tftp_ranges[i].state == RANGE_DATA ||
+		    tftp_ranges[i].state == RANGE_HELD)
+			range_send_error(&tftp_ranges[i], "Aborted");
+	NetSetTimeout(0, NULL);
+	net_set_state(NETLOOP_FAIL);
+}
+
+/* ACK the OACK of a held transfer, which lets its data flow */
+static void range_release(struct tftp_range *r)
+{
+	r->state = RANGE_DATA;
+	r->last = get_timer(0);
+	range_send_ack(r);
+}
+
+/* Start the next transfer, or ACK them all once every one is in */
+static void range_start_next(void)
+{
+	struct tftp_range *r;
+	int i;
+
+	while (++tftp_starting < tftp_nranges) {
+		r = &tftp_ranges[tftp_starting];
+		if (r->state != RANGE_UNUSED)
+			continue;
+		/* Transfers to the same server need no new ARP */
+		for (i = 0; i < tftp_starting; i++)
+			if (tftp_ranges[i].server == r->server)
+				memcpy(r->ether, tftp_ranges[i].ether, 6);
+		range_send_rrq(r);
+		return;
+	}
+
+	for (i = 0; i < tftp_nranges; i++)
+		if (tftp_ranges[i].state == RANGE_HELD)
+			range_release(&tftp_ranges[i]);
+}
+
+/* Split the file into block aligned ranges, one per transfer */
+static void range_split(ulong size)
+{
+	ulong chunk;
+	int i;
+
+	chunk = DIV_ROUND_UP(size, tftp_nranges);
+	chunk = roundup(chunk, tftp_ranges[0].blksize);
+
+	for (i = 0; i < tftp_nranges; i++) {
+		tftp_ranges[i].start = min(i * chunk, size);
+		tftp_ranges[i].end = min((i + 1) * chunk, size);
+	}
+	/* Nothing left for the last few of a small file */
+	while (tftp_nranges > 1 &&
+	       tftp_ranges[tftp_nranges - 1].start == size)
+		tftp_ranges[--tftp_nranges].state = RANGE_UNUSED;
+
+	debug("TFTP: %lu bytes in %d ranges of %lu\n", size, tftp_nranges,
+	      chunk);
+}
+
+/*
+ * The server of r ignores "offset": give its range to the one before. If
+ * that one is already done, read the file again from the first server,
+ * without an offset, and keep only the bytes of the range.
+ */
+static void range_drop(struct tftp_range *r)
+{
+	struct tftp_range *prev = r - 1;
+
+	printf("\nTFTP server %pI4 does not support offsets\n", &r->server);
+	range_send_error(r, "offset not supported");
+
+	while (prev->state == RANGE_UNUSED)
+		prev--;
+	if (prev->state != RANGE_DONE) {
+		prev->end = r->end;
+		r->state = RANGE_UNUSED;
+		return;
+	}
+
+	r->plain = 1;
+	r->server = tftp_ranges[0].server;
+	memcpy(r->ether, tftp_ranges[0].ether, 6);
+	r->block = 0;
+	r->timeouts = 0;
+	range_send_rrq(r);
+}
+
+static void range_oack(struct tftp_range *r, uchar *pkt, unsigned len)
+{
+	ulong tsize = ~0UL;
+	int offset = 0;
+	int i;
+
+	r->blksize = TFTP_BLOCK_SIZE;
+	for (i = 0; i + 6 < len; i++) {
+		if (strcmp((char *)pkt + i, "blksize") == 0)
+			r->blksize = simple_strtoul((char *)pkt + i + 8,
+						    NULL, 10);
+		if (strcmp((char *)pkt + i, "tsize") == 0)
+			tsize = simple_strtoul((char *)pkt + i + 6, NULL, 10);
+		if (strcmp((char *)pkt + i, "offset") == 0 &&
+		    simple_strtoul((char *)pkt + i + 7, NULL, 10) == r->start)
+			offset = 1;
+	}
+
+	if (r == tftp_ranges) {
+		if (tsize == ~0UL)
+			/* No size, no ranges: just this one transfer */
+			tftp_nranges = 1;
+		else
+			range_split(tsize);
+	} else if (!offset && !r->plain) {
+		range_drop(r);
+		range_start_next();
+		return;
+	}
+
+	r->base = r->plain ? 0 : r->start;
+	r->state = RANGE_HELD;
+	r->last = get_timer(0);
+	range_start_next();
+}
+
+static int range_store(struct tftp_range *r, uchar *pkt, unsigned len)
+{
+	ulong pos = r->base + (r->block - 1) * r->blksize;
+	ulong end = min(pos + len, r->end);
+
+	/* A plain read also brings the blocks before the range */
+	if (pos < r->start) {
+		pkt += min(r->start - pos, (ulong)len);
+		pos = r->start;
+	}
+	if (end > pos) {
+		if (net_store(pos, pkt, end - pos))
+			return -1;
+		tftp_range_bytes += end - pos;
+	}
+	if (end > NetBootFileXferSize)
+		NetBootFileXferSize = end;
+
+	while (tftp_range_hashes < tftp_range_bytes / HASH_BYTES) {
+		putc('#');
+		if (++tftp_range_hashes % TFTP_HASHES_PER_LINE == 0)
+			puts("\n\t ");
+	}
+
+	return 0;
+}
+
+static void range_data(struct tftp_range *r, uchar *pkt, unsigned len)
+{
+	ulong pos;
+	int i;
+
+	if (len < 2)
+		return;
+
+	if (r->state == RANGE_SEND_RRQ) {
+		/* Server without options: no size, no offset */
+		if (r != tftp_ranges && !r->plain) {
+			range_drop(r);
+			range_start_next();
+			return;
+		}
+		if (r == tftp_ranges)
+			tftp_nranges = 1;
+		r->base = 0;
+		r->blksize = TFTP_BLOCK_SIZE;
+		r->state = RANGE_DATA;
+	}
+
+	/* Only the block after the last one counts, others are resent */
+	if (r->state != RANGE_DATA ||
+	    ntohs(*(__be16 *)pkt) != ((r->block + 1) & 0xffff)) {
+		if (r->state == RANGE_DATA)
+			range_send_ack(r);
+		return;
+	}
+
+	r->block++;
+	r->last = get_timer(0);
+	r->timeouts = 0;
+	if (range_store(r, pkt + 2, len - 2)) {
+		range_fail("could not store the file");
+		return;
+	}
+
+	pos = r->base + r->block * r->blksize;
+	if (len - 2 < r->blksize) {
+		/* End of file */
+		range_send_ack(r);
+		r->state = RANGE_DONE;
+	} else if (pos >= r->end) {
+		range_send_error(r, "Range done");
+		r->state = RANGE_DONE;
+	} else {
+		range_send_ack(r);
+	}
+
+	for (i = 0; i < tftp_nranges; i++)
+		if (tftp_ranges[i].state != RANGE_DONE &&
+		    tftp_ranges[i].state != RANGE_UNUSED)
+			return;
+	range_complete();
+}
+
+static void range_handler(uchar *pkt, unsigned dest, IPaddr_t sip,
+			  unsigned src, unsigned len)
+{
+	struct tftp_range *r = NULL;
+	int i;
+
+	for (i = 0; i < tftp_nranges; i++)
+		if (tftp_ranges[i].our_port == dest &&
+		    tftp_ranges[i].state != RANGE_UNUSED)
+			r = &tftp_ranges[i];
+	if (!r || sip != r->server || len < 2)
+		return;
+
+	if (r->state == RANGE_SEND_RRQ)
+		r->remote_port = src;
+	else if (src != r->remote_port)
+		return;
+
+	switch (ntohs(*(__be16 *)pkt)) {
+	case TFTP_OACK:
+		if (r->state == RANGE_SEND_RRQ)
+			range_oack(r, pkt + 2, len - 2);
+		else if (r->state == RANGE_HELD)
+			/* The server is about to give up on us */
+			range_release(r);
+		break;
+	case TFTP_DATA:
+		range_data(r, pkt + 2, len - 2);
+		break;
+	case TFTP_ERROR:
+		if (len > 4)
+			pkt[len - 1] = 0;
+		range_fail(len > 4 ? (char *)pkt + 4 : "unknown");
+		break;
+	}
+}
+
+static void range_timeout(void)
+{
+	struct tftp_range *r;
+	ulong now = get_timer(0);
+	int i;
+
+	NetSetTimeout(TFTP_RANGES_TICK, range_timeout);
+
+	for (i = 0; i < tftp_nranges; i++) {
+		r = &tftp_ranges[i];
+		if (r->state == RANGE_UNUSED || r->state == RANGE_DONE ||
+		    now - r->last < tftp_range_timeout)
+			continue;
+
+		/*
+		 * A transfer held for as long as the timeout must not wait
+		 * for the others any more, or its server gives up on it.
+		 */
+		if (r->state == RANGE_HELD) {
+			range_release(r);
+			continue;
+		}
+
+		if (++r->timeouts > TFTP_TIMEOUT_COUNT) {
+			range_fail("retry count exceeded");
+			return;
+		}
+		puts("T ");
+		r->last = now;
+		NET_STATS_INC(retransmits);
+		if (r->state == RANGE_SEND_RRQ)
+			range_send_rrq(r);
+		else
+			range_send_ack(r);
+	}
+}
+
+/* Parse 'tftpservers', a list of IP addresses, into the transfers */
+static int range_setup(IPaddr_t server)
+{
+	char *s = getenv("tftpservers");
+	IPaddr_t servers[TFTP_RANGES_MAX];
+	int i;
+
+	tftp_nservers = 0;
+	while (s && *s && tftp_nservers < TFTP_RANGES_MAX) {
+		while (*s == ' ' || *s == ',')
+			s++;
+		if (!*s)
+			break;
+		servers[tftp_nservers++] = string_to_ip(s);
+		while (*s && *s != ' ' && *s != ',')
+			s++;
+	}
+	if (!tftp_nservers)
+		servers[tftp_nservers++] = server;
+
+	tftp_nranges = getenv_ulong("tftpranges", 10, tftp_nservers);
+	tftp_nranges = min(tftp_nranges, TFTP_RANGES_MAX);
+	if (tftp_nranges < 2)
+		return -1;
+
+	memset(tftp_ranges, 0, sizeof(tftp_ranges));
+	for (i = 0; i < tftp_nranges; i++) {
+		tftp_ranges[i].server = servers[i % tftp_nservers];
+		tftp_ranges[i].our_port = 1024 + (get_timer(0) + i) % 3072;
+		tftp_ranges[i].end = ~0UL;
+	}
+
+	return 0;
+}
+
+int tftp_ranges_start(IPaddr_t server, const char *filename, int blksize,
+		      ulong timeout_ms)
+{
+	int i;
+
+	if (range_setup(server))
+		return -1;
+
+	tftp_range_file = filename;
+	tftp_range_blksize = blksize;
+	tftp_range_timeout = timeout_ms;
+
+	printf("Using %s device\n", eth_get_name());
+	printf("TFTP from %d server(s) in %d ranges; our IP address is %pI4\n",
+	       min(tftp_nservers, tftp_nranges), tftp_nranges, &NetOurIP);
+	for (i = 0; i < tftp_nranges; i++)
+		debug("range %d: %pI4 port %d\n", i, &tftp_ranges[i].server,
+		      tftp_ranges[i].our_port);
+	printf("Filename '%s'.\n", filename);
+	printf("Load address: 0x%lx\n", load_addr);
+	puts("Loading: *\b");
+
+	NetBootFileXferSize = 0;
+	tftp_range_bytes = 0;
+	tftp_range_hashes = 0;
+	tftp_range_time_start = get_timer(0);
+
+	net_set_udp_handler(range_handler);
+	NetSetTimeout(TFTP_RANGES_TICK, range_timeout);
+
+	tftp_starting = 0;
+	range_send_rrq(&tftp_ranges[0]);
+
+	return 0;
+}
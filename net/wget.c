@@ -0,0 +1,296 @@
+/*
+ * Fetch a file over HTTP/1.1, on top of the minimal TCP client
+ *
+ * Only GET with "Connection: close" is done. The body may be delimited by
+ * Content-Length, by chunked transfer encoding, or by the server closing
+ * the connection. Anything but "200 OK" is an error; redirects are not
+ * followed.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <net.h>
+#include "tcp.h"
+#include "wget.h"
+
+#define WGET_DEFAULT_PORT	80
+/* One '#' per this many bytes received */
+#define WGET_HASH_BYTES		(64 << 10)
+#define HASHES_PER_LINE		50
+
+enum wget_state {
+	WGET_HEADER,		/* status line and header fields */
+	WGET_BODY,		/* plain body, up to Content-Length or FIN */
+	WGET_CHUNK_SIZE,	/* chunk size line, or CRLF ending a chunk */
+	WGET_CHUNK_DATA,
+	WGET_TRAILER,		/* trailer fields after the last chunk */
+	WGET_DONE,
+};
+
+static enum wget_state wget_state;
+static char wget_path[128];
+static IPaddr_t wget_server_ip;
+static int wget_port;
+
+static char wget_line[256];	/* the line being collected, truncated */
+static unsigned wget_line_len;
+static int wget_status_seen;	/* got the status line */
+static int wget_chunked;
+static int wget_have_length;	/* got a Content-Length field */
+static ulong wget_length;
+static ulong wget_chunk_left;
+
+static ulong wget_time_start;
+static int wget_hashes;
+
+static void wget_fail(const char *msg)
+{
+	printf("\nwget: %s\n", msg);
+	/* Just forget the connection, the server will time it out */
+	tcp_init();
+	net_set_state(NETLOOP_FAIL);
+}
+
+static void wget_complete(void)
+{
+	wget_time_start = get_timer(wget_time_start);
+	if (wget_time_start > 0) {
+		puts("\n\t ");	/* Line up with "Loading: " */
+		print_size(NetBootFileXferSize /
+			wget_time_start * 1000, "/s");
+	}
+	puts("\ndone\n");
+	net_set_state(NETLOOP_SUCCESS);
+}
+
+/* Everything is in, let the server know we are done as well */
+static void wget_body_done(void)
+{
+	wget_state = WGET_DONE;
+	tcp_close();
+}
+
+static void wget_store(uchar *data, unsigned len)
+{
+	ulong offset = NetBootFileXferSize;
+
+	if (net_store(offset, data, len)) {
+		wget_fail("cannot store data");
+		return;
+	}
+	NetBootFileXferSize += len;
+
+	while (wget_hashes < NetBootFileXferSize / WGET_HASH_BYTES) {
+		putc('#');
+		if (++wget_hashes % HASHES_PER_LINE == 0)
+			puts("\n\t ");
+	}
+}
+
+static void wget_header_line(char *line)
+{
+	char *p;
+
+	if (!wget_status_seen) {
+		/* "HTTP/1.1 200 OK" */
+		wget_status_seen = 1;
+		p = strchr(line, ' ');
+		if (strncmp(line, "HTTP/", 5) || !p ||
+		    simple_strtoul(p + 1, NULL, 10) != 200) {
+			printf("\nwget: server says '%s'\n", line);
+			wget_fail("download failed");
+		}
+		return;
+	}
+
+	if (!*line) {
+		/* End of the header */
+		if (wget_chunked) {
+			wget_state = WGET_CHUNK_SIZE;
+		} else if (wget_have_length && !wget_length) {
+			wget_body_done();
+		} else {
+			wget_state = WGET_BODY;
+			if (wget_have_length)
+				debug("wget: Content-Length %lu\n",
+				      wget_length);
+		}
+		return;
+	}
+
+	p = strchr(line, ':');
+	if (!p)
+		return;
+	for (p++; *p == ' ' || *p == '\t'; p++)
+		;
+
+	if (!strncasecmp(line, "Content-Length:", 15)) {
+		wget_length = simple_strtoul(p, NULL, 10);
+		wget_have_length = 1;
+	} else if (!strncasecmp(line, "Transfer-Encoding:", 18)) {
+		/* chunked is always the last coding applied */
+		wget_chunked = !strncasecmp(p, "chunked", 7);
+	}
+}
+
+static void wget_line_done(void)
+{
+	char *line = wget_line;
+
+	/* Drop the CR of the CRLF */
+	if (wget_line_len && line[wget_line_len - 1] == '\r')
+		wget_line_len--;
+	line[wget_line_len] = '\0';
+	wget_line_len = 0;
+
+	switch (wget_state) {
+	case WGET_HEADER:
+		wget_header_line(line);
+		break;
+	case WGET_CHUNK_SIZE:
+		/* The empty line is the CRLF after the data of a chunk */
+		if (!*line)
+			break;
+		wget_chunk_left = simple_strtoul(line, NULL, 16);
+		if (wget_chunk_left)
+			wget_state = WGET_CHUNK_DATA;
+		else
+			wget_state = WGET_TRAILER;
+		break;
+	case WGET_TRAILER:
+		if (!*line)
+			wget_body_done();
+		break;
+	default:
+		break;
+	}
+}
+
+/* Feed received bytes through the header / body state machine */
+static void wget_input(uchar *data, unsigned len)
+{
+	unsigned n;
+
+	while (len && wget_state != WGET_DONE &&
+	       net_state == NETLOOP_CONTINUE) {
+		switch (wget_state) {
+		case WGET_BODY:
+			n = len;
+			if (wget_have_length)
+				n = min(n, (unsigned)(wget_length -
+						      NetBootFileXferSize));
+			wget_store(data, n);
+			if (wget_have_length &&
+			    NetBootFileXferSize >= wget_length)
+				wget_body_done();
+			break;
+
+		case WGET_CHUNK_DATA:
+			n = min(len, (unsigned)wget_chunk_left);
+			wget_store(data, n);
+			wget_chunk_left -= n;
+			if (!wget_chunk_left)
+				wget_state = WGET_CHUNK_SIZE;
+			break;
+
+		default:
+			/* Line based states: collect up to the LF */
+			for (n = 0; n < len && data[n] != '\n'; n++)
+				if (wget_line_len < sizeof(wget_line) - 1)
+					wget_line[wget_line_len++] = data[n];
+			if (n < len) {
+				n++;
+				wget_line_done();
+			}
+			break;
+		}
+
+		data += n;
+		len -= n;
+	}
+}
+
+static void wget_handler(enum tcp_event event, uchar *data, unsigned len)
+{
+	char req[sizeof(wget_path) + 96];
+	int n;
+
+	switch (event) {
+	case TCP_EV_CONNECTED:
+		n = sprintf(req, "GET %s HTTP/1.1\r\nHost: %pI4",
+			    wget_path, &wget_server_ip);
+		if (wget_port != WGET_DEFAULT_PORT)
+			n += sprintf(req + n, ":%d", wget_port);
+		n += sprintf(req + n, "\r\nUser-Agent: U-Boot\r\n"
+			     "Connection: close\r\n\r\n");
+		if (tcp_send(req, n))
+			wget_fail("request too long");
+		break;
+
+	case TCP_EV_DATA:
+		wget_input(data, len);
+		break;
+
+	case TCP_EV_FIN:
+		/* Without a length, the end of the connection ends the body */
+		if (wget_state == WGET_BODY && !wget_have_length)
+			wget_state = WGET_DONE;
+		if (wget_state != WGET_DONE)
+			wget_fail("connection closed early");
+		else
+			tcp_close();
+		break;
+
+	case TCP_EV_CLOSED:
+		wget_complete();
+		break;
+
+	case TCP_EV_ERROR:
+		/* A reset after the whole body is in does not matter */
+		if (wget_state == WGET_DONE)
+			wget_complete();
+		else
+			wget_fail("download failed");
+		break;
+	}
+}
+
+void wget_start(void)
+{
+	char *p;
+
+	wget_server_ip = NetServerIP;
+	p = strchr(BootFile, ':');
+	if (p) {
+		wget_server_ip = string_to_ip(BootFile);
+		p++;
+	} else {
+		p = BootFile;
+	}
+	wget_path[0] = '/';
+	strncpy(wget_path + (*p != '/'), p, sizeof(wget_path) - 2);
+	wget_path[sizeof(wget_path) - 1] = 0;
+
+	wget_port = getenv_ulong("httpport", 10, WGET_DEFAULT_PORT);
+
+	printf("Using %s device\n", eth_get_name());
+	printf("HTTP from server %pI4:%d; our IP address is %pI4\n",
+	       &wget_server_ip, wget_port, &NetOurIP);
+	printf("Filename '%s'.\n", wget_path);
+	printf("Load address: 0x%lx\n", load_addr);
+	puts("Loading: *\b");
+
+	wget_state = WGET_HEADER;
+	wget_line_len = 0;
+	wget_status_seen = 0;
+	wget_chunked = 0;
+	wget_have_length = 0;
+	wget_length = 0;
+	wget_hashes = 0;
+	wget_time_start = get_timer(0);
+	NetBootFileXferSize = 0;
+
+	net_set_udp_handler(NULL);
+	tcp_start(wget_server_ip, wget_port, wget_handler);
+}
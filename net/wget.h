@@ -0,0 +1,12 @@
+/*
+ * Fetch a file over HTTP/1.1
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef __WGET_H__
+#define __WGET_H__
+
+void wget_start(void);	/* Begin the download */
+
+#endif /* __WGET_H__ */
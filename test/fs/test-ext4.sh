@@ -0,0 +1,79 @@
+#!/bin/sh
+#
+# ext4 tests for sandbox, on an image made with mkfs.ext4
+#
+# Needs mkfs.ext4, e2fsck and debugfs from e2fsprogs. Give the sandbox
+# build directory with O=, as for the vboot test.
+#
+# SPDX-License-Identifier:	GPL-2.0+
+
+if [ -z ${O} ]; then
+	O=.
+fi
+O=$(readlink -f ${O})
+uboot="${O}/u-boot"
+tmp=$(mktemp -d)
+img=${tmp}/ext4.img
+
+cleanup() {
+	rm -rf ${tmp}
+}
+
+fail() {
+	echo
+	echo "Test failed: $1, output follows:"
+	cat ${tmp}/out
+	cleanup
+	exit 1
+}
+
+setup() {
+	mkdir -p ${tmp}/root/ix
+	for i in $(seq 100); do
+		echo ${i} >${tmp}/root/ix/file-with-a-longer-name-${i}
+	done
+	mkfs.ext4 -q -b 1024 -d ${tmp}/root ${img} 4M >/dev/null || exit 1
+	# Have e2fsck give the directory a hash tree
+	e2fsck -fyD ${img} >/dev/null 2>&1
+	debugfs -R "htree /ix" ${img} 2>/dev/null | grep -q "Root node" ||
+		{ echo "Could not make an indexed directory"; cleanup; exit 1; }
+}
+
+# Run U-Boot with the image bound to host 0, then the commands in $1
+run_uboot() {
+	${uboot} -c "sb bind 0 ${img}; $1" >${tmp}/out 2>&1
+}
+
+test_htree() {
+	echo -n "indexed directory: "
+	run_uboot "ext4load host 0 3000000 /ix/file-with-a-longer-name-50;
+printenv filesize"
+	grep -q "^filesize=3$" ${tmp}/out || fail "htree lookup"
+
+	# Files written into the directory must be found, once each. The
+	# new entries go in the last block, wherever their hashes point.
+	cmds="mw.b 1000000 55 20;"
+	for i in 1 2 3 4 5 6 7 8; do
+		cmds="${cmds} ext4write host 0 1000000 /ix/new${i} 20;"
+		cmds="${cmds} ext4write host 0 1000000 /ix/new${i} 20;"
+	done
+	for i in 1 2 3 4 5 6 7 8; do
+		cmds="${cmds} ext4load host 0 2000000 /ix/new${i};"
+		cmds="${cmds} cmp.b 1000000 2000000 20;"
+	done
+	run_uboot "${cmds}
+ext4load host 0 3000000 /ix/file-with-a-longer-name-50;
+printenv filesize; ext4ls host 0 /ix"
+	[ $(grep -c "Total of 32 byte(s) were the same" ${tmp}/out) -eq 8 ] ||
+		fail "files written"
+	grep -q "^filesize=3$" ${tmp}/out || fail "lookup after write"
+	[ $(grep -c " new[1-8]$" ${tmp}/out) -eq 8 ] || fail "duplicate entry"
+	echo "OK"
+}
+
+echo "ext4 test using sandbox"
+echo
+setup
+test_htree
+cleanup
+echo "Test passed"
@@ -0,0 +1,136 @@
+#!/bin/sh
+#
+# Network tests for sandbox, against servers on a host tap device
+#
+# Needs to run as root to create the tap device and the TFTP server, and
+# python3 for the servers. Give the sandbox build directory with O=, as
+# for the vboot test.
+#
+# SPDX-License-Identifier:	GPL-2.0+
+
+tap=utap0
+host_ip=192.168.78.1
+board_ip=192.168.78.2
+http_port=8080
+
+if [ -z ${O} ]; then
+	O=.
+fi
+O=$(readlink -f ${O})
+uboot="${O}/u-boot"
+tmp=$(mktemp -d)
+dir=$(dirname $(readlink -f $0))
+pids=
+tftpd_pid=
+
+cleanup() {
+	[ -n "${pids}" ] && kill ${pids} 2>/dev/null
+	ip tuntap del dev ${tap} mode tap 2>/dev/null
+	rm -rf ${tmp}
+}
+
+fail() {
+	echo
+	echo "Test failed: $1, output follows:"
+	cat ${tmp}/out
+	cleanup
+	exit 1
+}
+
+setup() {
+	ip tuntap add dev ${tap} mode tap || exit 1
+	ip addr add ${host_ip}/24 dev ${tap}
+	ip link set ${tap} up
+
+	head -c 3000000 /dev/urandom >${tmp}/file.bin
+	crc=$(python3 -c 'import sys, zlib
+print("%08x" % zlib.crc32(open(sys.argv[1], "rb").read()))' ${tmp}/file.bin)
+
+	(cd ${tmp} && exec python3 -m http.server ${http_port} \
+		--bind ${host_ip}) >/dev/null 2>&1 &
+	pids="${pids} $!"
+	sleep 1
+}
+
+# (Re)start the TFTP server with the options in $1
+start_tftpd() {
+	[ -n "${tftpd_pid}" ] && kill ${tftpd_pid} && sleep 1
+	(cd ${tmp} && exec python3 ${dir}/tftpd.py ${host_ip} $1) \
+		>/dev/null 2>&1 &
+	tftpd_pid=$!
+	pids="${pids} $!"
+	sleep 1
+}
+
+# Run U-Boot with the network set up, then the commands in $1
+run_uboot() {
+	${uboot} --tap=${tap} -c "setenv ipaddr ${board_ip};
+setenv serverip ${host_ip};
+setenv httpport ${http_port};
+$1" >${tmp}/out 2>&1
+}
+
+test_wget() {
+	echo -n "wget: "
+	run_uboot "wget 1000000 file.bin; crc32 1000000 \${filesize}"
+	grep -q "==> ${crc}" ${tmp}/out || fail "wget data"
+
+	# Sandbox has 128 MiB; this is inside U-Boot's malloc area
+	run_uboot "wget 7e00000 file.bin || echo refused"
+	grep -q "would overwrite U-Boot" ${tmp}/out || fail "wget bounds"
+	grep -q "^refused" ${tmp}/out || fail "wget result"
+	echo "OK"
+}
+
+test_tftp() {
+	echo -n "tftp: "
+	# The first ranged request is dropped, to hold the others back
+	start_tftpd --drop-offset=1
+	run_uboot "tftpboot 1000000 file.bin; crc32 1000000 \${filesize}"
+	grep -q "==> ${crc}" ${tmp}/out || fail "tftp data"
+
+	# Four ranges from one server; one of them has to be asked twice
+	run_uboot "setenv tftpranges 4; setenv tftptimeout 1000;
+tftpboot 1000000 file.bin; crc32 1000000 \${filesize}"
+	grep -q "in 4 ranges" ${tmp}/out || fail "tftp ranges not used"
+	grep -q "==> ${crc}" ${tmp}/out || fail "tftp ranges data"
+
+	# No offsets, and the range before the first one asked for them is
+	# done by the time the server answers: it has to be read again
+	start_tftpd "--drop-offset=3 --ignore-offset"
+	run_uboot "setenv tftpranges 4; setenv tftptimeout 1000;
+tftpboot 1000000 file.bin; crc32 1000000 \${filesize}"
+	grep -q "does not support offsets" ${tmp}/out ||
+		fail "tftp ranges without offset"
+	grep -q "==> ${crc}" ${tmp}/out || fail "tftp ranges requeue data"
+
+	# The load must not run into U-Boot half way through a range
+	run_uboot "setenv tftpranges 4; tftpboot 6f00000 file.bin ||
+echo refused"
+	grep -q "would overwrite U-Boot" ${tmp}/out || fail "tftp bounds"
+	grep -q "^refused" ${tmp}/out || fail "tftp ranges result"
+	echo "OK"
+}
+
+test_bench() {
+	echo -n "net bench: "
+	run_uboot "net bench tftpboot 1000000 file.bin"
+	grep -q "^TFTP .* 1 run(s), 3000000 bytes" ${tmp}/out ||
+		fail "bench bytes"
+	grep -q "^rx: [1-9][0-9]* frames" ${tmp}/out || fail "bench rx"
+
+	# A run that fails before it starts is still counted
+	run_uboot "setenv ipaddr; net bench tftpboot 1000000 file.bin"
+	grep -q "^TFTP .* 1 run(s), 0 bytes" ${tmp}/out ||
+		fail "bench early exit"
+	echo "OK"
+}
+
+echo "Network test using sandbox"
+echo
+setup
+test_wget
+test_tftp
+test_bench
+cleanup
+echo "Test passed"
@@ -0,0 +1,113 @@
+#!/usr/bin/env python3
+#
+# Minimal TFTP server for the sandbox network tests
+#
+# Serves files from the current directory with the blksize, tsize,
+# timeout, windowsize and offset options. With --drop-offset=N, the first
+# N read requests carrying an offset are ignored, so the client has to
+# send them again while its other transfers wait. With --ignore-offset,
+# the offset option is treated as unknown and files are sent from the
+# start.
+#
+# SPDX-License-Identifier:	GPL-2.0+
+
+import socket
+import struct
+import sys
+import threading
+
+OP_RRQ, OP_DATA, OP_ACK, OP_ERROR, OP_OACK = 1, 3, 4, 5, 6
+
+def serve(host, req, addr, ignore_offset):
+    parts = req[2:].split(b'\0')
+    name = parts[0].decode()
+    opts = {}
+    for i in range(2, len(parts) - 1, 2):
+        if parts[i]:
+            opts[parts[i].decode().lower()] = parts[i + 1].decode()
+
+    s = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    s.bind((host, 0))
+    s.settimeout(1.0)
+    try:
+        data = open(name, 'rb').read()
+    except IOError:
+        s.sendto(struct.pack('!HH', OP_ERROR, 1) + b'not found\0', addr)
+        return
+
+    blksize, window, oack = 512, 1, {}
+    if 'blksize' in opts:
+        blksize = min(int(opts['blksize']), 1468)
+        oack['blksize'] = str(blksize)
+    if 'tsize' in opts:
+        oack['tsize'] = str(len(data))
+    if 'timeout' in opts:
+        oack['timeout'] = opts['timeout']
+    if 'windowsize' in opts:
+        window = int(opts['windowsize'])
+        oack['windowsize'] = opts['windowsize']
+    if 'offset' in opts and not ignore_offset:
+        data = data[int(opts['offset']):]
+        oack['offset'] = opts['offset']
+    blocks = len(data) // blksize + 1
+
+    def recv_ack():
+        try:
+            pkt, _ = s.recvfrom(2000)
+        except socket.timeout:
+            return None
+        op, block = struct.unpack('!HH', pkt[:4])
+        if op == OP_ERROR:
+            raise EOFError
+        return block if op == OP_ACK else None
+
+    try:
+        if oack:
+            pkt = struct.pack('!H', OP_OACK) + b''.join(
+                k.encode() + b'\0' + v.encode() + b'\0'
+                for k, v in oack.items())
+            for tries in range(5):
+                s.sendto(pkt, addr)
+                if recv_ack() == 0:
+                    break
+            else:
+                return
+
+        acked = 0
+        while acked < blocks:
+            for n in range(acked + 1, min(acked + window, blocks) + 1):
+                s.sendto(struct.pack('!HH', OP_DATA, n & 0xffff) +
+                         data[(n - 1) * blksize:n * blksize], addr)
+            block = recv_ack()
+            if block is None:
+                continue
+            # Block numbers are 16 bits; take the nearest match
+            full = (acked & ~0xffff) | block
+            if full < acked - 0x8000:
+                full += 0x10000
+            acked = max(acked, full)
+    except EOFError:
+        pass
+
+def main():
+    host = sys.argv[1]
+    drop_offset = 0
+    ignore_offset = False
+    for arg in sys.argv[2:]:
+        if arg.startswith('--drop-offset='):
+            drop_offset = int(arg.split('=')[1])
+        elif arg == '--ignore-offset':
+            ignore_offset = True
+    ss = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    ss.bind((host, 69))
+    while True:
+        req, addr = ss.recvfrom(2000)
+        if struct.unpack('!H', req[:2])[0] != OP_RRQ:
+            continue
+        if drop_offset and b'\0offset\0' in req.lower():
+            drop_offset -= 1
+            continue
+        threading.Thread(target=serve, args=(host, req, addr, ignore_offset),
+                         daemon=True).start()
+
+main()
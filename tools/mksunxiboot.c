@@ -28,7 +28,10 @@ struct boot_file_head {
 	 * would need to implement the proper fields here instead of
 	 * padding.
 	 */
-	uint8_t pad[12];		/* align to 32 bytes */
+	uint8_t pad[12];
+	uint32_t reserved[2];
+	uint8_t boot_media;	/* filled in by the boot ROM */
+	uint8_t pad2[23];	/* align to 64 bytes */
 };
 
 #define BOOT0_MAGIC                     "eGON.BT0"
@@ -93,6 +96,7 @@ int main(int argc, char *argv[])
 		return EXIT_FAILURE;
 	}
 
+	memset(&img.header, 0, sizeof(img.header));
 	memset(img.pad, 0, BLOCK_SIZE);
 
 	/* get input file size */